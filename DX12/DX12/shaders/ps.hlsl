@@ -15,7 +15,8 @@ struct BindlessIndex
 {
     uint index;
 };
-ConstantBuffer<BindlessIndex> bindless_index : register(b7, space0);        // Root arg constant with index to Bindless Element arr
+ConstantBuffer<BindlessIndex> bindless_index : register(b7, space0);        // Root arg constant with the material id
+StructuredBuffer<BindlessElement> materials : register(t0, space8);         // Material table (one BindlessElement per material id)
 
 SamplerState samp : register(s0, space0);
 
@@ -33,10 +34,9 @@ float3 get_normal(float3 tangent, float3 bitangent, float3 input_normal, float3
 
 float4 main(VSOut input) : SV_TARGET0
 {       
-    ConstantBuffer<BindlessElement> access_el = ResourceDescriptorHeap[bindless_index.index];
+    BindlessElement access_el = materials[bindless_index.index];
    
-    // textures are grouped
-    const static uint num_tex = 4;
+    // texture indices are shared between materials
     float4 diffuse = bindless_texs[access_el.diffuse_idx].Sample(samp, input.uv);
     float3 col = 0.f.xxx;
     
@@ -125,7 +125,10 @@ float3 get_normal(float3 tangent, float3 bitangent, float3 input_normal, float3
     tbn = transpose(tbn);
     
     // Normal map is in [0, 1] space so we need to transform it to [-1, 1] space
-    float3 mapped_space_nor = normalize(tan_space_nor * 2.f - 1.f);
+    // Z is rebuilt from XY, cooked normal maps are BC5 (two channels, blue samples as 0)
+    float3 mapped_space_nor;
+    mapped_space_nor.xy = tan_space_nor.xy * 2.f - 1.f;
+    mapped_space_nor.z = sqrt(saturate(1.f - dot(mapped_space_nor.xy, mapped_space_nor.xy)));
      
     // Orient the tangent space correctly in world space
     float3 map_nor_world = normalize(mul(tbn, mapped_space_nor));
@@ -7,6 +7,10 @@
 	Represents a generic buffer allocation:
 		This can be re-used for any type of allocators which has the purpose of distributing buffer memory
 
+	Allocations constructed from a raw resource pointer do not hold a reference to the resource.
+	This is used by suballocators whose underlying resource outlives every allocation handed out (e.g DXBufferMemPool),
+	so that handing out and returning suballocations does not cause any refcount traffic.
+	Allocations constructed from a ComPtr share ownership of the resource (e.g committed allocations).
 */
 class DXBufferAllocation
 {
@@ -19,7 +23,9 @@ public:
 		uint32_t element_size,
 		D3D12_GPU_VIRTUAL_ADDRESS gpu_adr,
 		bool is_submanaged,
-		uint8_t* mapped_memory) :
+		uint8_t* mapped_memory,
+		uint32_t owner_id = 0,
+		uint32_t owner_block = 0) :
 		m_base_buffer(base_buffer),
 		m_offset_from_base(offset_from_base),
 		m_total_size(total_size),
@@ -27,7 +33,9 @@ public:
 		m_element_count(m_total_size / m_element_size),
 		m_gpu_address(gpu_adr),
 		m_is_submanaged(is_submanaged),
-		m_mapped_memory(mapped_memory)
+		m_mapped_memory(mapped_memory),
+		m_owner_id(owner_id),
+		m_owner_block(owner_block)
 	{}
 
 	DXBufferAllocation(
@@ -37,28 +45,37 @@ public:
 		uint32_t element_size,
 		D3D12_GPU_VIRTUAL_ADDRESS gpu_adr,
 		bool is_submanaged,
-		uint8_t* mapped_memory) :
-		m_base_buffer(base_buffer),
+		uint8_t* mapped_memory,
+		uint32_t owner_id = 0,
+		uint32_t owner_block = 0) :
+		m_owned_buffer(base_buffer),
+		m_base_buffer(base_buffer.Get()),
 		m_offset_from_base(offset_from_base),
 		m_total_size(total_size),
 		m_element_size(element_size),
 		m_element_count(m_total_size / m_element_size),
 		m_gpu_address(gpu_adr),
 		m_is_submanaged(is_submanaged),
-		m_mapped_memory(mapped_memory)
+		m_mapped_memory(mapped_memory),
+		m_owner_id(owner_id),
+		m_owner_block(owner_block)
 	{}
 
-	ID3D12Resource* base_buffer() const { return m_base_buffer.Get(); }
+	ID3D12Resource* base_buffer() const { return m_base_buffer; }
 	uint32_t offset_from_base() const { return m_offset_from_base; }
 	uint32_t size() const { return m_total_size; }
 	uint32_t element_size() const { return m_element_size; }
 	uint32_t element_count() const { return m_element_count; }
 	D3D12_GPU_VIRTUAL_ADDRESS gpu_adr() const { return m_gpu_address; }
 
+	// Allocator specific identifiers of the suballocator which handed out this allocation (e.g pool index) and the block within it
+	uint32_t owner_id() const { return m_owner_id; }
+	uint32_t owner_block() const { return m_owner_block; }
+
 	bool mappable() const { return m_mapped_memory != nullptr; }
 	uint8_t* mapped_memory() const { assert(mappable()); return m_mapped_memory; }
 
-	unsigned long reset() { return m_base_buffer.Reset(); }
+	unsigned long reset() { m_base_buffer = nullptr; return m_owned_buffer.Reset(); }
 
 	// Identiies whether this allocation belongs to an internal manager handling the resource or not.
 	// This identiies whether we are allowed to transition the state of the underlying resource or not, which is the responsibility of 
@@ -67,7 +84,8 @@ public:
 
 private:
 	// For copying
-	cptr<ID3D12Resource> m_base_buffer;	
+	cptr<ID3D12Resource> m_owned_buffer;				// Only set if this allocation shares ownership of the resource
+	ID3D12Resource* m_base_buffer = nullptr;
 	uint32_t m_offset_from_base = 0;
 	uint32_t m_total_size = 0;			
 	uint32_t m_element_size = 0;
@@ -77,4 +95,6 @@ private:
 	D3D12_GPU_VIRTUAL_ADDRESS m_gpu_address{};			// GPU address to bind as immediate root argument
 
 	bool m_is_submanaged = false;
+	uint32_t m_owner_id = 0;
+	uint32_t m_owner_block = 0;
 };
@@ -1,18 +1,23 @@
 #include "pch.h"
 #include "DXBufferGenericAllocator.h"
 
-DXBufferGenericAllocator::DXBufferGenericAllocator(cptr<ID3D12Device> dev, D3D12_HEAP_TYPE heap_type) :
+DXBufferGenericAllocator::DXBufferGenericAllocator(cptr<ID3D12Device> dev, D3D12_HEAP_TYPE heap_type, uint64_t heap_size) :
 	m_dev(dev),
-	m_heap_type(heap_type)
+	m_heap_type(heap_type),
+	m_heap_size(heap_size)
 {
+	assert(heap_size % D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT == 0);
 }
 
 DXBufferAllocation DXBufferGenericAllocator::allocate(uint32_t element_count, uint32_t element_size, D3D12_RESOURCE_STATES state, D3D12_RESOURCE_FLAGS flags)
 {
 	const auto total_size = element_count * element_size;
 
-	D3D12_HEAP_PROPERTIES hp{};
-	hp.Type = m_heap_type; 
+	// upload heap resources are required to start in generic read
+	if (m_heap_type == D3D12_HEAP_TYPE_UPLOAD)
+		state = D3D12_RESOURCE_STATE_GENERIC_READ;
+	else if (m_heap_type == D3D12_HEAP_TYPE_READBACK)
+		state = D3D12_RESOURCE_STATE_COPY_DEST;
 
 	D3D12_RESOURCE_DESC d{};
 	d.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
@@ -24,14 +29,63 @@ DXBufferAllocation DXBufferGenericAllocator::allocate(uint32_t element_count, ui
 	d.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
 	d.Flags = flags;
 
+	const auto info = m_dev->GetResourceAllocationInfo(0, 1, &d);
+
 	cptr<ID3D12Resource> buf;
-	m_dev->CreateCommittedResource(
-		&hp,
-		D3D12_HEAP_FLAG_NONE,
-		&d,
-		state,
-		nullptr,
-		IID_PPV_ARGS(buf.GetAddressOf()));
+	uint32_t owner_id = s_committed_owner;
+	uint32_t owner_block = TLSFAllocator::INVALID_BLOCK;
+
+	if (info.SizeInBytes <= m_heap_size)
+	{
+		// first heap with space, otherwise grab a new heap
+		TLSFAllocator::Allocation placement{};
+		for (uint32_t i = 0; i < m_heaps.size() && !placement.valid(); ++i)
+		{
+			placement = m_heaps[i].ator->allocate(info.SizeInBytes, info.Alignment);
+			owner_id = i;
+		}
+		if (!placement.valid())
+		{
+			owner_id = create_heap();
+			placement = m_heaps[owner_id].ator->allocate(info.SizeInBytes, info.Alignment);
+		}
+		assert(placement.valid());
+		owner_block = placement.block;
+
+		auto hr = m_dev->CreatePlacedResource(
+			m_heaps[owner_id].heap.Get(),
+			placement.offset,
+			&d,
+			state,
+			nullptr,
+			IID_PPV_ARGS(buf.GetAddressOf()));
+		if (FAILED(hr))
+		{
+			m_stats.on_failure();
+			assert(false);
+		}
+	}
+	else
+	{
+		// too large for our heaps
+		D3D12_HEAP_PROPERTIES hp{};
+		hp.Type = m_heap_type;
+
+		auto hr = m_dev->CreateCommittedResource(
+			&hp,
+			D3D12_HEAP_FLAG_NONE,
+			&d,
+			state,
+			nullptr,
+			IID_PPV_ARGS(buf.GetAddressOf()));
+		if (FAILED(hr))
+		{
+			m_stats.on_failure();
+			assert(false);
+		}
+		++m_num_committed;
+		m_committed_bytes += info.SizeInBytes;
+	}
 
 	uint8_t* mapped_start = nullptr;
 	// Persistently map if upload/readback buffer
@@ -49,30 +103,76 @@ DXBufferAllocation DXBufferGenericAllocator::allocate(uint32_t element_count, ui
 		element_size,
 		buf->GetGPUVirtualAddress(),
 		false,
-		mapped_start
+		mapped_start,
+		owner_id,
+		owner_block
 	);
 
-	// track
-	//m_allocs.insert({ alloc.gpu_adr(), alloc });
-	m_existing_allocs.insert(alloc.gpu_adr());
-
+	m_stats.on_allocate(info.SizeInBytes);
 	return alloc;
 }
 
 void DXBufferGenericAllocator::deallocate(DXBufferAllocation&& alloc)
 {
-//	auto it = m_allocs.find(alloc.gpu_adr());
-//	if (it == m_allocs.cend())
-//		assert(false);
+	uint64_t size = 0;
+	if (alloc.owner_id() == s_committed_owner)
+	{
+		assert(m_num_committed > 0);
+		const auto desc = alloc.base_buffer()->GetDesc();
+		size = m_dev->GetResourceAllocationInfo(0, 1, &desc).SizeInBytes;
+		--m_num_committed;
+		m_committed_bytes -= size;
+	}
+	else
+	{
+		assert(alloc.owner_id() < m_heaps.size());
+		size = m_heaps[alloc.owner_id()].ator->get_block_size(alloc.owner_block());
+		m_heaps[alloc.owner_id()].ator->deallocate(alloc.owner_block());
+	}
+	m_stats.on_deallocate(size);
+
+	// release our reference to the placed resource (heap memory is re-used from here on)
+	alloc.reset();
+}
+
+TLSFAllocator::Report DXBufferGenericAllocator::get_report() const
+{
+	TLSFAllocator::Report total{};
+	for (const auto& heap : m_heaps)
+	{
+		const auto report = heap.ator->get_report();
+		total.capacity += report.capacity;
+		total.used += report.used;
+		total.free += report.free;
+		total.largest_free = report.largest_free > total.largest_free ? report.largest_free : total.largest_free;
+		total.allocations += report.allocations;
+		total.free_blocks += report.free_blocks;
+	}
+	return total;
+}
 
-	auto it = m_existing_allocs.find(alloc.gpu_adr());
-	if (it == m_existing_allocs.cend())
-		assert(false);
+AllocatorStats DXBufferGenericAllocator::get_stats() const
+{
+	AllocatorStats stats = m_stats;
+	stats.capacity_bytes = m_heaps.size() * m_heap_size + m_committed_bytes;
+	stats.largest_free_bytes = get_report().largest_free;
+	return stats;
+}
 
-	//auto refs_left = alloc.reset();
-	//for (int i = 0; i < refs_left; ++i)
-	//	alloc.reset();
+uint32_t DXBufferGenericAllocator::create_heap()
+{
+	D3D12_HEAP_DESC hd{};
+	hd.SizeInBytes = m_heap_size;
+	hd.Properties.Type = m_heap_type;
+	hd.Alignment = D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT;
+	hd.Flags = D3D12_HEAP_FLAG_ALLOW_ONLY_BUFFERS;
+
+	Heap heap{};
+	auto hr = m_dev->CreateHeap(&hd, IID_PPV_ARGS(heap.heap.GetAddressOf()));
+	if (FAILED(hr))
+		assert(false);
+	heap.ator = std::make_unique<TLSFAllocator>(m_heap_size, D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT);
 
-	// erase from internal tracker
-	m_allocs.erase(alloc.gpu_adr());
+	m_heaps.push_back(std::move(heap));
+	return (uint32_t)m_heaps.size() - 1;
 }
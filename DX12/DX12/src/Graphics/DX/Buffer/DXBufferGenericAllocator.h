@@ -1,33 +1,56 @@
 #pragma once
 #include "DXBufferAllocation.h"
-#include <set>
+#include "Utilities/TLSFAllocator.h"
+#include "Profiler/AllocatorStats.h"
+#include <vector>
 
 /*
 
-	Represents generic committed resource allocator.
-	We only support committed allocations for now
+	Represents generic buffer resource allocator.
+	Buffers are created as placed resources in large heaps, suballocated with a TLSF allocator (O(1) allocate/free).
+	New heaps are created when the existing ones are full and requests larger than a heap fall back to committed resources.
+
+	Note that placed buffers still require 64KB placement alignment, the gain is avoiding an implicit heap (kernel call) per resource.
+
+	The heap index and the TLSF block are stored on the allocation (owner_id, owner_block) to free it without any lookup.
 
 */
 
 class DXBufferGenericAllocator
 {
 public:
-	DXBufferGenericAllocator(cptr<ID3D12Device> dev, D3D12_HEAP_TYPE type);		// utilize committed
+	DXBufferGenericAllocator(cptr<ID3D12Device> dev, D3D12_HEAP_TYPE type, uint64_t heap_size = 64 * 1024 * 1024);
 
 	DXBufferAllocation allocate(uint32_t element_count, uint32_t element_size, D3D12_RESOURCE_STATES state = D3D12_RESOURCE_STATE_COMMON, D3D12_RESOURCE_FLAGS flags = D3D12_RESOURCE_FLAG_NONE);
 	void deallocate(DXBufferAllocation&& alloc);
 
+	// Aggregated over all heaps (committed fallbacks are not included)
+	TLSFAllocator::Report get_report() const;
+
+	// Includes committed fallbacks, elements are allocations
+	AllocatorStats get_stats() const;
+
 private:
-	cptr<ID3D12Device> m_dev;
-	D3D12_HEAP_TYPE m_heap_type;
+	struct Heap
+	{
+		cptr<ID3D12Heap> heap;
+		std::unique_ptr<TLSFAllocator> ator;
+	};
 
-	// keps track internally to make d3d12 resource destruction explicit
-	std::set<uint64_t> m_existing_allocs;
-	std::unordered_map<uint64_t, DXBufferAllocation> m_allocs;
+	static constexpr uint32_t s_committed_owner = ~0u;
 
+private:
+	uint32_t create_heap();
+
+private:
+	cptr<ID3D12Device> m_dev;
+	D3D12_HEAP_TYPE m_heap_type;
+	uint64_t m_heap_size = 0;
 
-	
-	
+	std::vector<Heap> m_heaps;
+	uint32_t m_num_committed = 0;
+	uint64_t m_committed_bytes = 0;
 
+	AllocatorStats m_stats;
 };
 
@@ -2,8 +2,9 @@
 #include "DXBufferMemPool.h"
 #include "d3dx12.h"
 
-DXBufferMemPool::DXBufferMemPool(ID3D12Device* dev, uint16_t element_size, uint32_t num_elements, D3D12_HEAP_TYPE heap_type) :
-	m_element_size(element_size)
+DXBufferMemPool::DXBufferMemPool(ID3D12Device* dev, uint16_t element_size, uint32_t num_elements, D3D12_HEAP_TYPE heap_type, uint32_t pool_id) :
+	m_element_size(element_size),
+	m_pool_id(pool_id)
 {
 	const auto handle_size = dev->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
 
@@ -36,7 +37,7 @@ DXBufferMemPool::DXBufferMemPool(ID3D12Device* dev, uint16_t element_size, uint3
 	if (FAILED(hr))
 		assert(false);
 	m_base_gpu_adr = m_buffer->GetGPUVirtualAddress();
-	m_end_gpu_adr = m_buffer->GetGPUVirtualAddress() + num_elements * element_size;
+	m_end_gpu_adr = m_buffer->GetGPUVirtualAddress() + (uint64_t)num_elements * element_size;
 
 	// Persistently map if upload/readback buffer
 	if (heap_type == D3D12_HEAP_TYPE_UPLOAD || heap_type == D3D12_HEAP_TYPE_READBACK)
@@ -46,42 +47,37 @@ DXBufferMemPool::DXBufferMemPool(ID3D12Device* dev, uint16_t element_size, uint3
 	}
 
 
-	//m_free_allocations.reserve(num_elements);	// important to ensure that memory is in place (no reallocations and invalidating of pointer!)
-	// Initialize sub-allocations
-	for (uint32_t alloc_id = 0; alloc_id < num_elements; ++alloc_id)
-	{
-		auto allocation = DXBufferAllocation(
-			m_buffer.Get(),
-			alloc_id * element_size,
-			element_size,
-			element_size,
-			m_base_gpu_adr + (uint64_t)alloc_id * element_size,
-			true,
-			m_base_cpu_adr ? m_base_cpu_adr + (uint64_t)alloc_id * element_size : nullptr
-		);
-
-		m_free_allocations.push(std::move(allocation));
-	}
+	// Initialize free list (in ascending order)
+	m_free_list = IndexFreeList(num_elements);
 }
 
 DXBufferAllocation DXBufferMemPool::allocate()
 {
-	if (m_free_allocations.empty())
+	const uint32_t alloc_id = m_free_list.allocate();
+	if (alloc_id == IndexFreeList::INVALID_INDEX)
 		return {};
 
-	auto new_allocation = std::move(m_free_allocations.front());
-	m_free_allocations.pop();
-
-	return new_allocation;
+	const uint64_t offset = (uint64_t)alloc_id * m_element_size;
+	return DXBufferAllocation(
+		m_buffer.Get(),
+		(uint32_t)offset,
+		m_element_size,
+		m_element_size,
+		m_base_gpu_adr + offset,
+		true,
+		m_base_cpu_adr ? m_base_cpu_adr + offset : nullptr,
+		m_pool_id
+	);
 }
 
 void DXBufferMemPool::deallocate(DXBufferAllocation&& alloc)
 {
-
 	// given allocation must be part of this pool
 	assert(m_base_gpu_adr <= alloc.gpu_adr() && alloc.gpu_adr() < m_end_gpu_adr);
+	assert((alloc.gpu_adr() - m_base_gpu_adr) % m_element_size == 0);
 
-	m_free_allocations.push(alloc);
+	const uint32_t alloc_id = (uint32_t)((alloc.gpu_adr() - m_base_gpu_adr) / m_element_size);
+	m_free_list.deallocate(alloc_id);
 }
 
 void DXBufferMemPool::set_state(D3D12_RESOURCE_STATES new_state, ID3D12GraphicsCommandList* cmdl)
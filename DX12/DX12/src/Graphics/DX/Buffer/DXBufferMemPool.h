@@ -1,10 +1,10 @@
 #pragma once
 #include <d3d12.h>
-#include <queue>
-#include <set>
+#include <vector>
 #include <optional>
 
 #include "DXBufferAllocation.h"
+#include "Utilities/IndexFreeList.h"
 
 /*
 	A memory pool using suballocation with a fixed-sized element pool allocation strategy (element size supplied on construction time)
@@ -27,13 +27,16 @@
 					- These would be stored on default heap (they persist, until the materials are unloaded)
 			- others...
 
+	Free elements are tracked with an intrusive index free list (IndexFreeList): each free slot stores the index of the next free slot (4 bytes per element).
+	Allocations are built on demand from the base addresses and the element index, and hold no reference to the underlying resource.
+
 */
 
 class DXBufferMemPool
 {
 public:
 	DXBufferMemPool() = delete;
-	DXBufferMemPool(ID3D12Device* dev, uint16_t element_size, uint32_t num_elements, D3D12_HEAP_TYPE heap_type);
+	DXBufferMemPool(ID3D12Device* dev, uint16_t element_size, uint32_t num_elements, D3D12_HEAP_TYPE heap_type, uint32_t pool_id = 0);
 	~DXBufferMemPool() = default;
 
 	// API for retrieving and returning suballocations
@@ -44,6 +47,9 @@ public:
 	void set_state(D3D12_RESOURCE_STATES new_state, ID3D12GraphicsCommandList* cmdl);
 
 	uint16_t get_allocation_size() const;
+	uint32_t get_pool_id() const { return m_pool_id; }
+	uint32_t get_num_elements() const { return m_free_list.num_elements(); }
+	uint32_t get_num_free() const { return m_free_list.num_free(); }
 
 private:
 	cptr<ID3D12Resource> m_buffer;
@@ -53,9 +59,9 @@ private:
 	D3D12_GPU_VIRTUAL_ADDRESS m_base_gpu_adr{};
 	D3D12_GPU_VIRTUAL_ADDRESS m_end_gpu_adr{};				// Used to verify deallocation
 
-	std::queue<DXBufferAllocation> m_free_allocations;
+	IndexFreeList m_free_list;
 
 	uint16_t m_element_size = 0;
-
+	uint32_t m_pool_id = 0;								// Stamped on every allocation so that the owner can find this pool without a lookup
 
 };
\ No newline at end of file
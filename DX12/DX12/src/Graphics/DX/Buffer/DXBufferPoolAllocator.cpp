@@ -1,61 +1,198 @@
 #include "pch.h"
 #include "DXBufferPoolAllocator.h"
+#include <algorithm>
+#include <limits>
 
-DXBufferPoolAllocator::DXBufferPoolAllocator(Microsoft::WRL::ComPtr<ID3D12Device> dev, std::initializer_list<DXBufferPoolAllocator::PoolInfo> pool_infos_list, D3D12_HEAP_TYPE heap_type) :
-	m_dev(dev)
+DXBufferPoolAllocator::DXBufferPoolAllocator(Microsoft::WRL::ComPtr<ID3D12Device> dev, std::initializer_list<DXBufferPoolAllocator::PoolInfo> pool_infos_list, D3D12_HEAP_TYPE heap_type, const Settings& settings) :
+	m_dev(dev),
+	m_heap_type(heap_type),
+	m_settings(settings)
 {
 	std::vector<PoolInfo> pool_infos{ pool_infos_list.begin(), pool_infos_list.end() };
+	std::sort(pool_infos.begin(), pool_infos.end(), [](const PoolInfo& a, const PoolInfo& b) { return a.element_size < b.element_size; });
 
-	for (auto& pool_info : pool_infos)
+	// setup size classes (one per distinct element size)
+	for (const auto& pool_info : pool_infos)
+	{
+		assert(pool_info.element_size > 0 && pool_info.element_size <= (std::numeric_limits<uint16_t>::max)());
+		assert(pool_info.num_elements > 0);
+
+		if (m_size_classes.empty() || m_size_classes.back().element_size != pool_info.element_size)
+		{
+			SizeClass size_class{};
+			size_class.element_size = (uint16_t)pool_info.element_size;
+			size_class.elements_per_page = pool_info.num_elements;
+			m_size_classes.push_back(size_class);
+		}
+
+		const uint32_t class_id = (uint32_t)m_size_classes.size() - 1;
 		for (uint32_t i = 0; i < pool_info.num_pools; ++i)
-			init_pool(dev.Get(), pool_info.element_size, pool_info.num_elements, heap_type);
+			m_size_classes[class_id].available_pages.push_back(init_pool(class_id, true));
+	}
+	assert(!m_size_classes.empty());
+
+	// setup size routing table: each granule maps to the first size class which can hold any size within that granule
+	const uint32_t max_granule = (m_size_classes.back().element_size + s_granularity - 1) / s_granularity;
+	m_granule_to_class.resize(max_granule + 1);
+	uint32_t class_id = 0;
+	for (uint32_t granule = 1; granule <= max_granule; ++granule)
+	{
+		while (m_size_classes[class_id].element_size <= (granule - 1) * s_granularity)
+			++class_id;
+		m_granule_to_class[granule] = class_id;
+	}
 }
 
 DXBufferAllocation DXBufferPoolAllocator::allocate(uint64_t requested_size)
 {
-	DXBufferAllocation alloc{};
-	DXBufferMemPool* pool_used = nullptr;
-	for (auto& pool : m_pools)
+	const uint64_t granule = (requested_size + s_granularity - 1) / s_granularity;
+	if (granule >= m_granule_to_class.size())
 	{
-		if (pool->get_allocation_size() < requested_size)
-			continue;
+		m_stats.on_failure();
+		assert(false);		// no size class is big enough for this request
+		return {};
+	}
+
+	// only steps further if several size classes share the granule
+	uint32_t class_id = m_granule_to_class[granule];
+	while (class_id < m_size_classes.size() && m_size_classes[class_id].element_size < requested_size)
+		++class_id;
 
-		alloc = std::move(pool->allocate());
+	// fall back to bigger size classes only if we are not allowed to grow
+	DXBufferAllocation alloc{};
+	for (; class_id < m_size_classes.size(); ++class_id)
+	{
+		alloc = allocate_from_class(class_id);
 		if (alloc.size() != 0)
-		{
-			pool_used = pool.get();
 			break;
-		}
 	}
 
 	// couldn't find any suitable memory after going through all pools.. crash
 	if (alloc.size() == 0)
+	{
+		m_stats.on_failure();
 		assert(false);
-	
-	m_active_alloc_to_pool.insert({ alloc.gpu_adr() , pool_used });
+		return alloc;
+	}
+
+	m_stats.on_allocate(alloc.size());
 	return alloc;
 }
 
 void DXBufferPoolAllocator::deallocate(DXBufferAllocation&& alloc)
 {
-	auto it = m_active_alloc_to_pool.find(alloc.gpu_adr());
-	if (it == m_active_alloc_to_pool.cend())
-		assert(false);
+	// owning pool is encoded in the allocation
+	const uint32_t pool_id = alloc.owner_id();
+	assert(pool_id < m_pools.size() && m_pools[pool_id] != nullptr);
 
-	auto& [_, pool] = *it;
+	auto& pool = m_pools[pool_id];
+	auto& page_info = m_page_infos[pool_id];
+
+	const bool was_full = pool->get_num_free() == 0;
+	m_stats.on_deallocate(alloc.size());
 	pool->deallocate(std::move(alloc));
 
-	m_active_alloc_to_pool.erase(it);
+	if (was_full)
+		m_size_classes[page_info.size_class].available_pages.push_back(pool_id);
+
+	if (pool->get_num_free() == pool->get_num_elements())
+		page_info.idle_since = m_frame_count;
+}
+
+void DXBufferPoolAllocator::frame_begin()
+{
+	++m_frame_count;
+
+	if (m_settings.release_idle_after_frames == 0)
+		return;
+
+	for (uint32_t pool_id = 0; pool_id < m_pools.size(); ++pool_id)
+	{
+		const auto& pool = m_pools[pool_id];
+		const auto& page_info = m_page_infos[pool_id];
+		if (!pool || page_info.is_initial)
+			continue;
+
+		if (pool->get_num_free() == pool->get_num_elements() &&
+			m_frame_count - page_info.idle_since >= m_settings.release_idle_after_frames)
+			release_pool(pool_id);
+	}
+}
+
+AllocatorStats DXBufferPoolAllocator::get_stats() const
+{
+	AllocatorStats stats = m_stats;
+	stats.largest_free_bytes = 0;
+	for (const auto& pool : m_pools)
+		if (pool)
+			stats.largest_free_bytes = (std::max)(stats.largest_free_bytes, (uint64_t)pool->get_num_free() * pool->get_allocation_size());
+	return stats;
 }
 
 void DXBufferPoolAllocator::set_state(D3D12_RESOURCE_STATES new_state, ID3D12GraphicsCommandList* cmdl)
 {
 	for (auto& pool : m_pools)
-		pool->set_state(new_state, cmdl);
+		if (pool)
+			pool->set_state(new_state, cmdl);
+}
+
+uint32_t DXBufferPoolAllocator::init_pool(uint32_t size_class, bool is_initial)
+{
+	uint32_t pool_id = 0;
+	if (!m_free_pool_slots.empty())
+	{
+		pool_id = m_free_pool_slots.back();
+		m_free_pool_slots.pop_back();
+	}
+	else
+	{
+		pool_id = (uint32_t)m_pools.size();
+		m_pools.emplace_back();
+		m_page_infos.emplace_back();
+	}
+
+	const auto& sc = m_size_classes[size_class];
+	m_pools[pool_id] = std::make_unique<DXBufferMemPool>(m_dev.Get(), sc.element_size, sc.elements_per_page, m_heap_type, pool_id);
+
+	m_stats.capacity_bytes += (uint64_t)sc.element_size * sc.elements_per_page;
+
+	auto& page_info = m_page_infos[pool_id];
+	page_info.size_class = size_class;
+	page_info.is_initial = is_initial;
+	page_info.idle_since = m_frame_count;
+
+	return pool_id;
+}
+
+void DXBufferPoolAllocator::release_pool(uint32_t pool_id)
+{
+	// a completely free page is always in the available list
+	auto& available = m_size_classes[m_page_infos[pool_id].size_class].available_pages;
+	auto it = std::find(available.begin(), available.end(), pool_id);
+	assert(it != available.end());
+	available.erase(it);
+
+	m_stats.capacity_bytes -= (uint64_t)m_pools[pool_id]->get_num_elements() * m_pools[pool_id]->get_allocation_size();
+	m_pools[pool_id].reset();
+	m_free_pool_slots.push_back(pool_id);
 }
 
-void DXBufferPoolAllocator::init_pool(ID3D12Device* dev, uint16_t element_size, uint32_t num_elements, D3D12_HEAP_TYPE heap_type)
+DXBufferAllocation DXBufferPoolAllocator::allocate_from_class(uint32_t size_class)
 {
-	auto pool = std::make_unique<DXBufferMemPool>(dev, element_size, num_elements, heap_type);
-	m_pools.push_back(std::move(pool));
+	auto& sc = m_size_classes[size_class];
+	if (sc.available_pages.empty())
+	{
+		if (!m_settings.allow_growth)
+			return {};
+		sc.available_pages.push_back(init_pool(size_class, false));
+	}
+
+	const uint32_t pool_id = sc.available_pages.back();
+	auto alloc = m_pools[pool_id]->allocate();
+
+	// page is exhausted, stop routing to it
+	if (m_pools[pool_id]->get_num_free() == 0)
+		sc.available_pages.pop_back();
+
+	return alloc;
 }
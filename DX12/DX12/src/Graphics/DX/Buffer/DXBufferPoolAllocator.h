@@ -1,47 +1,96 @@
 #pragma once
 #include "DXBufferMemPool.h"
-#include <unordered_map>
+#include "Profiler/AllocatorStats.h"
 
 /*
 	Pool allocator with fixed size elements.
+
+	Pools (pages) are grouped into size classes, one per distinct element size.
+	A request is routed to its size class in O(1) through a lookup table indexed by the request size in 256 byte granules,
+	and each size class keeps a list of its pages which still have free elements.
+
+	When a size class runs out of memory, a new page is appended (if growth is allowed).
+	Pages which were appended on demand are released again once they have been completely free for a configurable number of frames.
+	The initial pages (PoolInfo) are never released.
+
+	Each page is given its slot index in m_pools on creation, which it stamps on every allocation it hands out (DXBufferAllocation::owner_id).
+	Deallocation resolves the owning page directly through that index. Slots of released pages are re-used.
 */
 class DXBufferPoolAllocator
 {
 public:
 	struct PoolInfo
 	{
-		uint32_t num_pools = 0;
+		uint32_t num_pools = 0;				// Initial pages
 		uint32_t element_size = 0;
-		uint32_t num_elements = 0;
+		uint32_t num_elements = 0;			// Elements per page
 
 		PoolInfo(uint32_t num_pools_, uint32_t element_size_, uint32_t num_elements_) : num_pools(num_pools_), element_size(element_size_), num_elements(num_elements_) {}
 	};
 
+	struct Settings
+	{
+		bool allow_growth = true;						// Append new pages when a size class is exhausted
+		uint32_t release_idle_after_frames = 0;			// Release grown pages which have been completely free for this many frames (0: never release)
+														// Should be at least the number of frames in flight
+	};
+
 
 public:
 	DXBufferAllocation allocate(uint64_t requested_size);
 	void deallocate(DXBufferAllocation&& alloc);
 
+	// Releases idle pages. Called once per frame
+	void frame_begin();
+
 
-	DXBufferPoolAllocator(Microsoft::WRL::ComPtr<ID3D12Device> dev, std::initializer_list<DXBufferPoolAllocator::PoolInfo> pool_infos_list, D3D12_HEAP_TYPE heap_type);
+	DXBufferPoolAllocator(Microsoft::WRL::ComPtr<ID3D12Device> dev, std::initializer_list<DXBufferPoolAllocator::PoolInfo> pool_infos_list, D3D12_HEAP_TYPE heap_type, const Settings& settings = Settings());
 	~DXBufferPoolAllocator() = default;
 
 
 	// Sets state of the underlying buffer
 	void set_state(D3D12_RESOURCE_STATES new_state, ID3D12GraphicsCommandList* cmdl);
 
+	// Largest free block is the most free memory within a single page
+	AllocatorStats get_stats() const;
+
+private:
+	struct SizeClass
+	{
+		uint16_t element_size = 0;
+		uint32_t elements_per_page = 0;
+		std::vector<uint32_t> available_pages;		// Pages with at least one free element
+	};
+
+	struct PageInfo
+	{
+		uint32_t size_class = 0;
+		bool is_initial = false;
+		uint64_t idle_since = 0;					// Frame on which the page last became completely free
+	};
+
+	static constexpr uint32_t s_granularity = 256;
+
 private:
-	void init_pool(ID3D12Device* dev, uint16_t element_size, uint32_t num_elements, D3D12_HEAP_TYPE heap_type);
+	uint32_t init_pool(uint32_t size_class, bool is_initial);
+	void release_pool(uint32_t pool_id);
+	DXBufferAllocation allocate_from_class(uint32_t size_class);
+
 
-	
 private:
 	cptr<ID3D12Device> m_dev;
-	std::vector<std::unique_ptr<DXBufferMemPool>> m_pools;
-
-	std::unordered_map<uint64_t, DXBufferMemPool*> m_active_alloc_to_pool;
+	D3D12_HEAP_TYPE m_heap_type = D3D12_HEAP_TYPE_DEFAULT;
+	Settings m_settings;
 
+	std::vector<std::unique_ptr<DXBufferMemPool>> m_pools;		// Released pages leave an empty slot
+	std::vector<PageInfo> m_page_infos;
+	std::vector<uint32_t> m_free_pool_slots;
 
+	std::vector<SizeClass> m_size_classes;						// Sorted by element size
+	std::vector<uint32_t> m_granule_to_class;					// [(size + 255) / 256] --> smallest size class which fits
 
+	uint64_t m_frame_count = 0;
 
+	AllocatorStats m_stats;
 };
 
@@ -0,0 +1,122 @@
+#include "pch.h"
+#include "DXBufferRingAllocator.h"
+#include <limits>
+#include <algorithm>
+
+DXBufferRingAllocator::DXBufferRingAllocator(ID3D12Device* dev, uint64_t capacity, uint32_t max_fif, uint32_t alignment) :
+	m_capacity(capacity),
+	m_alignment(alignment)
+{
+	assert(alignment > 0 && (alignment & (alignment - 1)) == 0);
+	assert(capacity % alignment == 0);
+	assert(capacity <= (std::numeric_limits<uint32_t>::max)());		// offsets are stored as 32-bit on the allocation
+	assert(max_fif > 0);
+
+	m_frame_markers.resize(max_fif);
+	m_stats.capacity_bytes = capacity;
+
+	// Create buffer
+	D3D12_HEAP_PROPERTIES hp{};
+	hp.Type = D3D12_HEAP_TYPE_UPLOAD;
+
+	D3D12_RESOURCE_DESC rd{};
+	rd.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
+	rd.Alignment = D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT;
+	rd.Width = capacity;
+	rd.Height = rd.DepthOrArraySize = rd.MipLevels = 1;
+	rd.Format = DXGI_FORMAT_UNKNOWN;
+	rd.SampleDesc = { 1, 0 };
+	rd.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;		// Requirement for bufers
+	rd.Flags = D3D12_RESOURCE_FLAG_NONE;
+
+	auto hr = dev->CreateCommittedResource(
+		&hp,
+		D3D12_HEAP_FLAG_NONE,
+		&rd,
+		D3D12_RESOURCE_STATE_GENERIC_READ,		// required start state for upload buffer
+		nullptr,
+		IID_PPV_ARGS(m_buffer.GetAddressOf()));
+	if (FAILED(hr))
+		assert(false);
+	m_base_gpu_adr = m_buffer->GetGPUVirtualAddress();
+
+	// Persistently map
+	D3D12_RANGE no_read{};
+	hr = m_buffer->Map(0, &no_read, (void**)&m_base_cpu_adr);
+	if (FAILED(hr))
+		assert(false);
+}
+
+void DXBufferRingAllocator::frame_begin(uint32_t frame_idx)
+{
+	assert(frame_idx < m_frame_markers.size());
+
+	// everything allocated before the last time this frame began is no longer in use
+	auto& marker = m_frame_markers[frame_idx];
+	m_tail = marker.head;
+	m_tail_allocations = marker.num_allocations;
+	marker.head = m_head;
+	marker.num_allocations = m_stats.total_allocations;
+
+	m_stats.set_in_use(m_head - m_tail, m_stats.total_allocations - m_tail_allocations);
+}
+
+DXBufferAllocation DXBufferRingAllocator::allocate(uint64_t requested_size, uint32_t element_size)
+{
+	auto alloc = try_allocate(requested_size, element_size);
+	assert(alloc.base_buffer() != nullptr);
+	return alloc;
+}
+
+DXBufferAllocation DXBufferRingAllocator::try_allocate(uint64_t requested_size, uint32_t element_size)
+{
+	assert(requested_size > 0);
+	const uint64_t size = (requested_size + m_alignment - 1) & ~((uint64_t)m_alignment - 1);
+
+	// skip the remainder of the buffer if the allocation would straddle the end
+	uint64_t start = m_head;
+	const uint64_t phys_start = start % m_capacity;
+	if (phys_start + size > m_capacity)
+		start += m_capacity - phys_start;
+
+	// out of memory: the frames in flight use up the whole ring
+	if (start + size - m_tail > m_capacity)
+	{
+		m_stats.on_failure();
+		return {};
+	}
+
+	m_head = start + size;
+	++m_stats.total_allocations;
+	m_stats.set_in_use(m_head - m_tail, m_stats.total_allocations - m_tail_allocations);
+
+	const uint64_t offset = start % m_capacity;
+	return DXBufferAllocation(
+		m_buffer.Get(),
+		(uint32_t)offset,
+		(uint32_t)size,
+		element_size != 0 ? element_size : (uint32_t)size,
+		m_base_gpu_adr + offset,
+		true,
+		m_base_cpu_adr + offset
+	);
+}
+
+AllocatorStats DXBufferRingAllocator::get_stats() const
+{
+	AllocatorStats stats = m_stats;
+
+	// free space is contiguous unless it straddles the end of the buffer
+	const uint64_t used = m_head - m_tail;
+	if (used == 0)
+		stats.largest_free_bytes = m_capacity;
+	else if (used == m_capacity)
+		stats.largest_free_bytes = 0;
+	else
+	{
+		const uint64_t head = m_head % m_capacity;
+		const uint64_t tail = m_tail % m_capacity;
+		stats.largest_free_bytes = head > tail ? (std::max)(m_capacity - head, tail) : tail - head;
+	}
+	return stats;
+}
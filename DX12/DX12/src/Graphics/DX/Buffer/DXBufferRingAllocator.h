@@ -0,0 +1,56 @@
+#pragma once
+#include "DXBufferAllocation.h"
+#include "Profiler/AllocatorStats.h"
+#include <vector>
+
+/*
+	A linear ring allocator over a single persistently mapped upload buffer, meant for transient resources.
+
+	Allocations are bump-pointer suballocations aligned to the requested alignment (256 for constant buffers).
+	Offsets are tracked as ever-increasing virtual offsets, the physical offset being (virtual % capacity).
+	If an allocation does not fit before the end of the buffer, the remainder is skipped and it wraps to the beginning.
+
+	A marker of the head is stored per frame in flight on frame_begin.
+	When the same frame index comes around again (the application has waited for it), everything before the old marker is retired in O(1).
+	This is conservative by one frame, since transient data for a frame may be allocated before its frame_begin (e.g by the upload context).
+*/
+class DXBufferRingAllocator
+{
+public:
+	DXBufferRingAllocator(ID3D12Device* dev, uint64_t capacity, uint32_t max_fif, uint32_t alignment = D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT);
+	~DXBufferRingAllocator() = default;
+
+	void frame_begin(uint32_t frame_idx);
+
+	// Element size defaults to the aligned requested size
+	DXBufferAllocation allocate(uint64_t requested_size, uint32_t element_size = 0);
+
+	// Same as allocate, but returns an empty allocation (null base buffer) instead of asserting when the ring is full
+	DXBufferAllocation try_allocate(uint64_t requested_size, uint32_t element_size = 0);
+
+	uint64_t get_capacity() const { return m_capacity; }
+	uint64_t get_used() const { return m_head - m_tail; }
+
+	// Bytes in use include padding skipped on wrap-around, elements are allocations not yet retired
+	AllocatorStats get_stats() const;
+
+private:
+	cptr<ID3D12Resource> m_buffer;
+	uint8_t* m_base_cpu_adr = nullptr;
+	D3D12_GPU_VIRTUAL_ADDRESS m_base_gpu_adr{};
+
+	uint64_t m_capacity = 0;
+	uint32_t m_alignment = 0;
+
+	uint64_t m_head = 0;							// Virtual offset of the next allocation
+	uint64_t m_tail = 0;							// Virtual offset of the oldest allocation still in use
+	struct FrameMarker
+	{
+		uint64_t head = 0;
+		uint64_t num_allocations = 0;
+	};
+	std::vector<FrameMarker> m_frame_markers;		// Head at the beginning of each frame in flight
+	uint64_t m_tail_allocations = 0;				// Allocation count at the tail
+
+	AllocatorStats m_stats;
+};
@@ -1,133 +1,92 @@
 #include "pch.h"
 #include "DXBindlessManager.h"
 #include "GUI/GUIContext.h"
+#include <algorithm>
 
 DXBindlessManager::DXBindlessManager(
-	Microsoft::WRL::ComPtr<ID3D12Device> dev, 
-	DXDescriptorAllocation&& bindless_part, 
-	DXBufferManager* buf_mgr, 
-	DXTextureManager* tex_mgr) :
+	Microsoft::WRL::ComPtr<ID3D12Device> dev,
+	DXViewCache* view_cache,
+	DXBufferManager* buf_mgr,
+	DXUploadContext* up_ctx,
+	DXTextureManager* tex_mgr,
+	DXRetirementService* retirement,
+	uint32_t max_materials) :
 	m_dev(dev),
 	m_buf_mgr(buf_mgr),
-	m_tex_mgr(tex_mgr)
+	m_up_ctx(up_ctx),
+	m_tex_mgr(tex_mgr),
+	m_view_cache(view_cache),
+	m_max_materials(max_materials),
+	m_retirement(retirement)
 {
-	// Submanage the bindless part into a range specifically for CBVs (mat access) and the storage for the actual views
-	{
-		// use the stolen memory for easier internal allocation
-		// we allocate a separate chunk for CBVs and a separate chunk for the views
-		auto num_descs = bindless_part.num_descriptors();
-		auto temp = DXDescriptorPool(dev, std::move(bindless_part), D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
-
-		assert(num_descs % 2 == 0);
-
-		m_max_elements = num_descs / 2;
-		auto views = temp.allocate(m_max_elements);				// Places views first
-		auto access_cbvs = temp.allocate(m_max_elements);		// Access CBVs after
-
-		m_views_start = views.gpu_handle();
-		m_access_start = access_cbvs.gpu_handle();
-		m_access_offset_from_base = access_cbvs.offset_from_base();
-		
-		// for this implementation, we will be placing the access part right after the views
-		m_offset_to_access_part = D3D12_DESCRIPTOR_RANGE_OFFSET_APPEND;	
-
-		m_view_desc_ator = std::make_unique<DXDescriptorPool>(dev, std::move(views), D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
-		m_access_desc_ator = std::make_unique<DXDescriptorPool>(dev, std::move(access_cbvs), D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
-	}
+	// Material table, elements are written in place when a material is created
+	DXBufferDesc bdesc{};
+	bdesc.element_count = max_materials;
+	bdesc.element_size = sizeof(BindlessElement);
+	bdesc.flag = BufferFlag::eNonConstant;
+	bdesc.usage_cpu = UsageIntentCPU::eUpdateSometimes;
+	bdesc.usage_gpu = UsageIntentGPU::eReadMultipleTimesPerFrame;
+	m_material_table = m_buf_mgr->create_buffer(bdesc);
 }
 
 void DXBindlessManager::frame_begin(uint32_t frame_idx)
 {
 	m_curr_frame_idx = frame_idx;
-	
-	while (!m_deletion_queue.empty())
-	{
-		auto el = m_deletion_queue.front();
-		if (el.first == frame_idx)
-		{
-			auto& del_func = el.second;
-			del_func();
-			m_deletion_queue.pop();
-		}
-		else
-			break;
-	}
+
+	m_retired.release_completed(m_retirement->completed_fence_value(), [this](const RetiredBindless& record) { release(record); });
 }
 
 BindlessHandle DXBindlessManager::create_bindless(const DXBindlessDesc& desc)
 {
-	/*
-		Checks duplicates based on Diffuse only! (limitation for now to keep it simple)
-		We can make custom hash for unordered map to capture groups of resources to existing Bindless elements
-	*/
-	auto it = m_loaded_bindless.find(desc.diffuse_tex);
+	// Materials with the exact same textures share one element
+	const auto key = to_key(desc);
+	auto it = m_loaded_bindless.find(key);
 	if (it != m_loaded_bindless.cend())
 	{
 		return BindlessHandle(it->second);
 	}
 
-	assert(m_curr_max_indices < m_max_elements);
-
-	// Grab index to use in the descriptor heap in both parts respectively
-	uint32_t idx_to_use = 0;
-	if (!m_used_indices.empty())
+	// Grab a slot in the material table
+	uint32_t material_id = 0;
+	if (!m_free_materials.empty())
 	{
-		idx_to_use = (uint32_t)m_used_indices.front();
-		m_used_indices.pop();
+		material_id = m_free_materials.front();
+		m_free_materials.pop();
 	}
 	else
 	{
-		idx_to_use = m_curr_max_indices;
-		m_curr_max_indices += 4;
+		assert(m_curr_max_materials < m_max_materials);
+		material_id = m_curr_max_materials++;
 	}
-	
+
 	// Grab handle
 	auto [handle, res] = m_handles.get_next_free_handle();
 
-	// Fill buffer init data
-	res->element_data.diffuse_idx = idx_to_use;
-	res->element_data.normal_idx = idx_to_use + 1;
-	res->element_data.specular_idx = idx_to_use + 2;
-	res->element_data.opacity_idx = idx_to_use + 3;
+	// Views are shared between materials (and anything else going through the cache)
+	res->element_data.diffuse_idx = acquire_view(desc.diffuse_tex);
+	res->element_data.normal_idx = acquire_view(desc.normal_tex);
+	res->element_data.specular_idx = acquire_view(desc.specular_tex);
+	res->element_data.opacity_idx = acquire_view(desc.opacity_tex);
 
 	// mat constants
 	res->element_data.specular = -1;				// no specular
 
-	// Create buffer
-	DXBufferDesc bdesc{};
-	bdesc.data = &res->element_data;
-	bdesc.data_size = sizeof(res->element_data);
-	bdesc.element_count = 1;
-	bdesc.element_size = sizeof(res->element_data);
-	bdesc.flag = BufferFlag::eConstant;
-	bdesc.usage_cpu = UsageIntentCPU::eUpdateSometimes;
-	bdesc.usage_gpu = UsageIntentGPU::eReadOncePerFrame;
-	auto access_hdl = m_buf_mgr->create_buffer(bdesc);
-
-	// Allocate descriptors for the view group (bindless element) and texture
-	auto view_desc = m_view_desc_ator->allocate(4);		// depends on texture count
-	auto access_desc = m_access_desc_ator->allocate(1);	// one persistent per tex group
-
-	// Create views for the resources
-	m_buf_mgr->create_cbv(access_hdl, access_desc.cpu_handle());
-
-	// ordering matters!
-	m_tex_mgr->create_srv(desc.diffuse_tex, view_desc.cpu_handle(0));
-	m_tex_mgr->create_srv(desc.normal_tex, view_desc.cpu_handle(1));
-	m_tex_mgr->create_srv(desc.specular_tex, view_desc.cpu_handle(2));
-	m_tex_mgr->create_srv(desc.opacity_tex, view_desc.cpu_handle(3));
-
-	res->access_alloc = std::move(access_desc);
-	res->view_alloc = std::move(view_desc);
+	// Only this element is uploaded
+	m_up_ctx->mark_dirty(m_material_table, &res->element_data, (uint64_t)material_id * sizeof(BindlessElement), sizeof(BindlessElement));
 
 	// Fill bindless metadata
-	//res->access_index = idx_to_use;						// Use for bindless style (base is bound)
-	res->access_index = access_desc.offset_from_base();		// Use for dynamic descriptor access (no base is bound, need offset from Descriptor Heap base!)
+	res->access_index = material_id;
 	res->frame_idx_allocation = m_curr_frame_idx;
 
 	res->desc = desc;
 
-	m_loaded_bindless.insert({ desc.diffuse_tex, handle });
+	m_loaded_bindless.insert({ key, handle });
+	for (const auto& tex : key)
+	{
+		auto& users = m_texture_users[tex];
+		if (users.empty() || users.back() != handle)
+			users.push_back(handle);
+	}
 
 	return BindlessHandle(handle);
 }
@@ -136,40 +95,100 @@ void DXBindlessManager::destroy_bindless(BindlessHandle handle)
 {
 	auto res = m_handles.get_resource(handle.handle);
 
-	// push a deallocation request
-	// allows descriptor stomping after a full FIF cycle (guaranteed that this bindless group is not in use anymore!
-	auto del_func = [this, res, curr_frame = m_curr_frame_idx]()
+	// the cache defers the view release itself
+	m_view_cache->release(res->element_data.diffuse_idx);
+	m_view_cache->release(res->element_data.normal_idx);
+	m_view_cache->release(res->element_data.specular_idx);
+	m_view_cache->release(res->element_data.opacity_idx);
+
+	// allows slot re-use once the GPU is done with the frame (guaranteed that this material is not in use anymore!)
+	m_retired.retire(m_retirement->current_fence_value(), { handle.handle });
+	m_loaded_bindless.erase(to_key(res->desc));
+	for (const auto& tex : to_key(res->desc))
 	{
-		// deallocate descriptors to allow re-use (stomping)
-		m_view_desc_ator->deallocate(std::move(res->access_alloc));
-		m_access_desc_ator->deallocate(std::move(res->view_alloc));
-
-		// free access buffer
-		m_buf_mgr->destroy_buffer(res->access_buf);
-		// free bindless group to allow re-use
-		m_handles.free_handle(res->handle);
-		// re-use indices
-		m_used_indices.push(res->access_index);
-
-	};
-	m_deletion_queue.push({ m_curr_frame_idx, del_func });
-	m_loaded_bindless.erase(res->desc.diffuse_tex);
+		auto it = m_texture_users.find(tex);
+		if (it == m_texture_users.end())
+			continue;
+		auto& users = it->second;
+		users.erase(std::remove(users.begin(), users.end(), handle.handle), users.end());
+		if (users.empty())
+			m_texture_users.erase(it);
+	}
 }
 
-D3D12_GPU_DESCRIPTOR_HANDLE DXBindlessManager::get_views_start() const
+void DXBindlessManager::on_textures_resident(const std::vector<TextureHandle>& textures)
+{
+	std::vector<uint64_t> dirty;
+	for (const auto& tex : textures)
+	{
+		auto it = m_texture_users.find(tex);
+		if (it == m_texture_users.end())
+			continue;
+
+		for (const auto& user : it->second)
+		{
+			auto res = m_handles.get_resource(user);
+			auto& el = res->element_data;
+			const std::array<std::pair<TextureHandle, uint32_t*>, 4> slots =
+			{ {
+				{ res->desc.diffuse_tex, &el.diffuse_idx },
+				{ res->desc.normal_tex, &el.normal_idx },
+				{ res->desc.specular_tex, &el.specular_idx },
+				{ res->desc.opacity_tex, &el.opacity_idx },
+			} };
+
+			// the old view (placeholder) stays alive until the GPU is done with it
+			for (auto& [slot_tex, idx] : slots)
+			{
+				if (slot_tex == tex)
+				{
+					m_view_cache->release(*idx);
+					*idx = acquire_view(tex);
+				}
+			}
+			dirty.push_back(user);
+		}
+	}
+
+	std::sort(dirty.begin(), dirty.end());
+	dirty.erase(std::unique(dirty.begin(), dirty.end()), dirty.end());
+	for (const auto& user : dirty)
+	{
+		auto res = m_handles.get_resource(user);
+		m_up_ctx->mark_dirty(m_material_table, &res->element_data, res->access_index * sizeof(BindlessElement), sizeof(BindlessElement));
+	}
+}
+
+void DXBindlessManager::release(const RetiredBindless& record)
+{
+	auto res = m_handles.get_resource(record.handle);
+
+	// re-use table slot
+	m_free_materials.push((uint32_t)res->access_index);
+	// free bindless group to allow re-use
+	m_handles.free_handle(res->handle);
+}
+
+uint32_t DXBindlessManager::acquire_view(TextureHandle tex)
 {
-	return m_views_start;
+	const auto index = m_view_cache->get_srv(m_tex_mgr->get_resource(tex), m_tex_mgr->get_srv_desc(tex));
+	assert(index != DXViewCache::INVALID_INDEX);		// out of bindless views
+	return index;
 }
 
-D3D12_GPU_DESCRIPTOR_HANDLE DXBindlessManager::get_access_start() const
+DXBindlessManager::MaterialKey DXBindlessManager::to_key(const DXBindlessDesc& desc)
 {
-	return m_access_start;
+	return { desc.diffuse_tex, desc.normal_tex, desc.specular_tex, desc.opacity_tex };
 }
 
+D3D12_GPU_DESCRIPTOR_HANDLE DXBindlessManager::get_views_start() const
+{
+	return m_view_cache->get_start();
+}
 
-uint64_t DXBindlessManager::offset_to_access_part() const
+BufferHandle DXBindlessManager::get_material_table() const
 {
-	return m_offset_to_access_part;
+	return m_material_table;
 }
 
 uint64_t DXBindlessManager::access_index(BindlessHandle handle)
@@ -3,12 +3,23 @@
 #include "DXBindlessManager.h"
 #include "DXBufferManager.h"
 #include "DXTextureManager.h"
-#include "Descriptor/DXDescriptorPool.h"
+#include "DXUploadContext.h"
+#include "Descriptor/DXViewCache.h"
 #include "Utilities/HandlePool.h"
+#include "Utilities/RetirementQueue.h"
 #include "shaders/ShaderInterop_Renderer.h"
 
+#include <map>
 #include <unordered_map>
 
+/*
+	Bindless materials.
+
+	Every texture gets a single SRV in the bindless view range through the view cache, shared by all materials using it.
+	All BindlessElements live in one structured buffer (the material table) indexed by the material id,
+	only the element of a created material is uploaded (range update through the upload context).
+*/
+
 struct BindlessHandle
 {
 	BindlessHandle() = default;
@@ -29,24 +40,30 @@ class DXBindlessManager
 public:
 	DXBindlessManager(
 		Microsoft::WRL::ComPtr<ID3D12Device> dev,
-		DXDescriptorAllocation&& bindless_part,		// descriptors managed by the bindless system
-		DXBufferManager* buf_mgr,					// buffer creation interface to supply indices for each bindless primitive
-		DXTextureManager* tex_mgr					// texture creation interface to access internals
+		DXViewCache* view_cache,					// deduplicated views, its range is the bindless view table
+		DXBufferManager* buf_mgr,					// buffer creation interface for the material table
+		DXUploadContext* up_ctx,					// uploads material table elements
+		DXTextureManager* tex_mgr,					// texture creation interface to access internals
+		DXRetirementService* retirement,			// fence tracking for deferred destruction
+		uint32_t max_materials = 4096
 	);
 
 	void frame_begin(uint32_t frame_idx);
 
 	BindlessHandle create_bindless(const DXBindlessDesc& desc);
 
-	// Queues up the bindless chunk to the destruction queue (to be discarded after a full cycle from the requested frame
-	// discard it for re-use
+	// Retires the material, its table slot is re-used once the GPU has passed the current frame
 	void destroy_bindless(BindlessHandle handle);
 
+	// Re-creates the views of textures which were swapped in (async loads) and updates the materials using them
+	void on_textures_resident(const std::vector<TextureHandle>& textures);
+
 	D3D12_GPU_DESCRIPTOR_HANDLE get_views_start() const;
-	D3D12_GPU_DESCRIPTOR_HANDLE get_access_start() const;
 
-	uint64_t offset_to_access_part() const;
+	// Structured buffer of BindlessElement, bind as SRV and index with access_index()
+	BufferHandle get_material_table() const;
 
+	// Material id (index into the material table)
 	uint64_t access_index(BindlessHandle handle);
 
 private:
@@ -55,9 +72,6 @@ private:
 		uint64_t access_index = 0;
 
 		BindlessElement element_data;
-		BufferHandle access_buf;
-
-		DXDescriptorAllocation view_alloc, access_alloc;
 
 		uint32_t frame_idx_allocation = 0;
 
@@ -67,29 +81,39 @@ private:
 		void destroy() { }
 	};
 
+	struct RetiredBindless
+	{
+		uint64_t handle = 0;
+	};
+
+	using MaterialKey = std::array<uint64_t, 4>;
+
+private:
+	void release(const RetiredBindless& record);
+
+	uint32_t acquire_view(TextureHandle tex);
+
+	static MaterialKey to_key(const DXBindlessDesc& desc);
+
 private:
 	Microsoft::WRL::ComPtr<ID3D12Device> m_dev;
 	DXBufferManager* m_buf_mgr = nullptr;
+	DXUploadContext* m_up_ctx = nullptr;
 	DXTextureManager* m_tex_mgr = nullptr;
-	std::unique_ptr<DXDescriptorPool> m_view_desc_ator;			// desc ator for views
-	std::unique_ptr<DXDescriptorPool> m_access_desc_ator;		// desc ator for the access buffers (contiguous using CBV tables)
+	DXViewCache* m_view_cache = nullptr;
 	HandlePool<InternalBindlessResource> m_handles;
-	uint64_t m_offset_to_access_part = 0;
 
-	uint32_t m_curr_max_indices = 0;
-	std::queue<uint64_t> m_used_indices;
+	BufferHandle m_material_table;
+	uint32_t m_max_materials = 0;
+	uint32_t m_curr_max_materials = 0;
+	std::queue<uint32_t> m_free_materials;
 
 	uint32_t m_curr_frame_idx = 0;
 
-	uint32_t m_max_elements = 0;
-
-	std::queue<std::pair<uint32_t, std::function<void()>>> m_deletion_queue;
-
-	D3D12_GPU_DESCRIPTOR_HANDLE m_views_start;
-	D3D12_GPU_DESCRIPTOR_HANDLE m_access_start;
-
-	uint32_t m_access_offset_from_base = 0;
+	DXRetirementService* m_retirement = nullptr;
+	RetirementQueue<RetiredBindless> m_retired;
 
-	std::unordered_map<uint64_t, BindlessHandle> m_loaded_bindless;
+	std::map<MaterialKey, uint64_t> m_loaded_bindless;
+	std::unordered_map<uint64_t, std::vector<uint64_t>> m_texture_users;		// texture to materials
 };
 
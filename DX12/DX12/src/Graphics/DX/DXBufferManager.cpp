@@ -7,35 +7,47 @@ DXBufferManager::~DXBufferManager()
 
 }
 
-DXBufferManager::DXBufferManager(Microsoft::WRL::ComPtr<ID3D12Device> dev, uint32_t max_fif) :
-	m_dev(dev)
+DXBufferManager::DXBufferManager(Microsoft::WRL::ComPtr<ID3D12Device> dev, uint32_t max_fif, DXRetirementService* retirement) :
+	m_dev(dev),
+	m_retirement(retirement)
 {
-	// setup allocator for persistent memory
+	assert(retirement);
+
+	// pools are sized for the typical load, pages are appended on demand and released after idling for a while
+	DXBufferPoolAllocator::Settings pool_settings{};
+	pool_settings.allow_growth = true;
+	pool_settings.release_idle_after_frames = 300;
+
+	// setup allocator for immutable persistent memory (shared by all FIFs, written once)
 	{
-		m_constant_persistent_bufs.resize(max_fif);
 		auto pool_infos =
 		{
-			DXBufferPoolAllocator::PoolInfo(1, 256, 5000),
-			DXBufferPoolAllocator::PoolInfo(1, 512, 5000),
-			DXBufferPoolAllocator::PoolInfo(1, 1024, 30000),
+			DXBufferPoolAllocator::PoolInfo(1, 256, 2048),
+			DXBufferPoolAllocator::PoolInfo(1, 512, 2048),
+			DXBufferPoolAllocator::PoolInfo(1, 1024, 4096),
 		};
-		//m_constant_persistent_buf = std::make_unique<DXBufferPoolAllocator>(dev, pool_infos, D3D12_HEAP_TYPE_DEFAULT);
-		for (uint32_t i = 0; i < max_fif; ++i)
-			m_constant_persistent_bufs[i] = std::make_unique<DXBufferPoolAllocator>(dev, pool_infos, D3D12_HEAP_TYPE_DEFAULT);
+		m_constant_persistent_buf = std::make_unique<DXBufferPoolAllocator>(dev, pool_infos, D3D12_HEAP_TYPE_DEFAULT, pool_settings);
 	}
 
-	// setup ring buffer for transient upload buffer
+	// setup allocators for versioned persistent memory (only constants which are updated need per-FIF versions)
 	{
+		m_constant_versioned_bufs.resize(max_fif);
 		auto pool_infos =
 		{
-			DXBufferPoolAllocator::PoolInfo(1, 256, 5000),
-			DXBufferPoolAllocator::PoolInfo(1, 512, 5000),
-			DXBufferPoolAllocator::PoolInfo(1, 1024, 30000),
+			DXBufferPoolAllocator::PoolInfo(1, 256, 1024),
+			DXBufferPoolAllocator::PoolInfo(1, 512, 1024),
+			DXBufferPoolAllocator::PoolInfo(1, 1024, 1024),
 		};
-		auto pool_for_ring = std::make_unique<DXBufferPoolAllocator>(dev, pool_infos, D3D12_HEAP_TYPE_UPLOAD);
-		m_constant_ring_buf = std::make_unique<DXBufferRingPoolAllocator>(std::move(pool_for_ring));
+		for (uint32_t i = 0; i < max_fif; ++i)
+			m_constant_versioned_bufs[i] = std::make_unique<DXBufferPoolAllocator>(dev, pool_infos, D3D12_HEAP_TYPE_DEFAULT, pool_settings);
 	}
 
+	// setup ring buffer for transient upload buffer
+	m_constant_ring_buf = std::make_unique<DXBufferRingAllocator>(dev.Get(), 32 * 1024 * 1024, max_fif);
+
+	// setup ring buffer for staging initial buffer data (copy regions have no alignment requirement)
+	m_staging_ring_buf = std::make_unique<DXBufferRingAllocator>(dev.Get(), 64 * 1024 * 1024, max_fif, 16);
+
 	m_committed_def_ator = std::make_unique<DXBufferGenericAllocator>(m_dev, D3D12_HEAP_TYPE_DEFAULT);
 	m_committed_upload_ator = std::make_unique<DXBufferGenericAllocator>(m_dev, D3D12_HEAP_TYPE_UPLOAD);
 }
@@ -86,18 +98,15 @@ void DXBufferManager::destroy_buffer(BufferHandle hdl)
 	}
 	else
 	{
-		if (res->usage_gpu == UsageIntentGPU::eWrite)
-		{
-			m_committed_def_ator->deallocate(std::move(res->alloc));
-			m_handles.free_handle(res->handle);
-		}
+		retire({ RetiredAllocation::Source::eCommittedDefault, 0, std::move(res->alloc) });
+		m_handles.free_handle(res->handle);
 	}
 }
 
 void DXBufferManager::bind_as_direct_arg(ID3D12GraphicsCommandList* cmdl, BufferHandle buf, UINT param_idx, RootArgDest dest, bool write)
 {
 	const auto& res = m_handles.get_resource(buf.handle);
-
+	assert(!is_streamed(res));		// bind the address returned by stream_constant
 
 	if (res->is_constant)
 	{
@@ -142,16 +151,29 @@ void DXBufferManager::bind_as_direct_arg(ID3D12GraphicsCommandList* cmdl, Buffer
 }
 
 void DXBufferManager::create_cbv(BufferHandle handle, D3D12_CPU_DESCRIPTOR_HANDLE descriptor)
+{
+	const auto d = get_cbv_desc(handle);
+	m_dev->CreateConstantBufferView(&d, descriptor);
+}
+
+void DXBufferManager::create_srv(BufferHandle handle, D3D12_CPU_DESCRIPTOR_HANDLE descriptor, uint32_t start_el, uint32_t num_el, bool raw)
+{
+	const auto d = get_srv_desc(handle, start_el, num_el, raw);
+	m_dev->CreateShaderResourceView(get_resource(handle), &d, descriptor);
+}
+
+D3D12_CONSTANT_BUFFER_VIEW_DESC DXBufferManager::get_cbv_desc(BufferHandle handle)
 {
 	auto res = m_handles.get_resource(handle.handle);
+	assert(!is_streamed(res));
 
 	D3D12_CONSTANT_BUFFER_VIEW_DESC d{};
 	d.BufferLocation = res->alloc.gpu_adr();
 	d.SizeInBytes = res->alloc.size();
-	m_dev->CreateConstantBufferView(&d, descriptor);
+	return d;
 }
 
-void DXBufferManager::create_srv(BufferHandle handle, D3D12_CPU_DESCRIPTOR_HANDLE descriptor, uint32_t start_el, uint32_t num_el, bool raw)
+D3D12_SHADER_RESOURCE_VIEW_DESC DXBufferManager::get_srv_desc(BufferHandle handle, uint32_t start_el, uint32_t num_el, bool raw)
 {
 	D3D12_SHADER_RESOURCE_VIEW_DESC d{};
 	const auto& alloc = m_handles.get_resource(handle.handle)->alloc;
@@ -164,7 +186,13 @@ void DXBufferManager::create_srv(BufferHandle handle, D3D12_CPU_DESCRIPTOR_HANDL
 	d.Buffer.NumElements = num_el;
 	d.Buffer.StructureByteStride = alloc.element_size();
 	d.Buffer.Flags = raw ? D3D12_BUFFER_SRV_FLAG_RAW : D3D12_BUFFER_SRV_FLAG_NONE;
-	m_dev->CreateShaderResourceView(alloc.base_buffer(), &d, descriptor);
+	return d;
+}
+
+ID3D12Resource* DXBufferManager::get_resource(BufferHandle handle)
+{
+	assert(!is_streamed(m_handles.get_resource(handle.handle)));
+	return m_handles.get_resource(handle.handle)->alloc.base_buffer();
 }
 
 void DXBufferManager::create_rt_accel_view(BufferHandle handle, D3D12_CPU_DESCRIPTOR_HANDLE descriptor)
@@ -198,34 +226,38 @@ uint32_t DXBufferManager::get_element_count(BufferHandle handle)
 
 const DXBufferAllocation* DXBufferManager::get_buffer_alloc(BufferHandle handle)
 {
+	assert(!is_streamed(m_handles.get_resource(handle.handle)));
 	return &m_handles.get_resource(handle.handle)->alloc;
 }
 
+std::vector<NamedAllocatorStats> DXBufferManager::get_allocator_stats() const
+{
+	std::vector<NamedAllocatorStats> stats;
+	stats.push_back({ "Constant Persistent", m_constant_persistent_buf->get_stats() });
+	for (uint32_t i = 0; i < m_constant_versioned_bufs.size(); ++i)
+		stats.push_back({ fmt::format("Constant Versioned #{}", i), m_constant_versioned_bufs[i]->get_stats() });
+	stats.push_back({ "Constant Ring", m_constant_ring_buf->get_stats() });
+	stats.push_back({ "Committed Default", m_committed_def_ator->get_stats() });
+	stats.push_back({ "Staging Ring", m_staging_ring_buf->get_stats() });
+	stats.push_back({ "Committed Upload", m_committed_upload_ator->get_stats() });
+	return stats;
+}
+
 void DXBufferManager::frame_begin(uint32_t frame_idx)
 {
 	m_curr_frame_idx = frame_idx;
 
 	// resources are freed back to the ring buffer on a per-frame basis
 	m_constant_ring_buf->frame_begin(frame_idx);
+	m_staging_ring_buf->frame_begin(frame_idx);
 
-	// deallocate
-	if (!m_first_frame)
-	{
-		while (!m_deletion_queue.empty())
-		{
-			auto el = m_deletion_queue.front();
-			if (el.first == frame_idx)
-			{
-				auto& del_func = el.second;
-				del_func();
-				m_deletion_queue.pop();
-			}
-			else
-				break;
-		}
-	}
-	else
-		m_first_frame = false;
+	// release idle pool pages
+	m_constant_persistent_buf->frame_begin();
+	for (auto& versioned_buf : m_constant_versioned_bufs)
+		versioned_buf->frame_begin();
+
+	// deallocate everything the GPU is done with
+	m_retired.release_completed(m_retirement->completed_fence_value(), [this](RetiredAllocation& record) { release(record); });
 }
 
 
@@ -233,6 +265,19 @@ void DXBufferManager::frame_begin(uint32_t frame_idx)
 
 
 
+D3D12_GPU_VIRTUAL_ADDRESS DXBufferManager::stream_constant(BufferHandle handle, const void* data, size_t size)
+{
+	auto res = m_handles.get_resource(handle.handle);
+	assert(is_streamed(res));
+	assert(size <= res->total_requested_size);
+
+	// versions are retired with the frame by the ring buffer
+	const auto alloc = m_constant_ring_buf->allocate(res->total_requested_size);
+	std::memcpy(alloc.mapped_memory(), data, size);
+
+	return alloc.gpu_adr();
+}
+
 DXBufferManager::InternalBufferResource* DXBufferManager::get_internal_buf(BufferHandle handle)
 {
 	return m_handles.get_resource(handle.handle);
@@ -249,60 +294,28 @@ DXBufferManager::InternalBufferResource* DXBufferManager::create_constant(const
 	const auto& usage_gpu = desc.usage_gpu;
 	uint32_t requested_size = desc.element_count * desc.element_size;
 
-	if (desc.usage_gpu == UsageIntentGPU::eReadMultipleTimesPerFrame)
-		assert(false);		// currently not supported
-
 	// Immutable. Irrelevant what GPU read access is given
 	if (usage_cpu == UsageIntentCPU::eUpdateNever)
 	{
-		// allocate from persistent allocator
-		//auto alloc = m_constant_persistent_buf->allocate(requested_size);
-		auto alloc = m_constant_persistent_bufs[m_curr_frame_idx]->allocate(requested_size);
+		// allocate from shared persistent allocator
+		auto alloc = m_constant_persistent_buf->allocate(requested_size);
 		resource->alloc = alloc;
 		resource->is_transient = false;
 
-		// grab temp staging memory
-		auto staging = m_constant_ring_buf->allocate(requested_size);
-
-		// copy data to staging
-		auto dst = staging.mapped_memory();
-		auto src = desc.data;
-		std::memcpy(dst, src, desc.data_size);
-
-		// schedule GPU-GPU copy to new version
-		auto upload_func = [staging, alloc, requested_size](ID3D12GraphicsCommandList* cmdl)
-		{
-			cmdl->CopyBufferRegion(
-				alloc.base_buffer(), alloc.offset_from_base(),
-				staging.base_buffer(), staging.offset_from_base(), requested_size);
-		};
-		m_deferred_init_copies.push(upload_func);
+		// copy the whole slot so that neighbouring constants coalesce into a single copy
+		stage_init_data(alloc, desc.data, desc.data_size, alloc.size());
 	}
-	// Only updates sometimes every X frames
-	else if (usage_cpu == UsageIntentCPU::eUpdateSometimes)
+	// Only updates sometimes every X frames OR once per frame but read many times --> device-local versions
+	else if (usage_cpu == UsageIntentCPU::eUpdateSometimes ||
+		(usage_cpu == UsageIntentCPU::eUpdateOnce && usage_gpu == UsageIntentGPU::eReadMultipleTimesPerFrame))
 	{
-		auto alloc = m_constant_persistent_bufs[m_curr_frame_idx]->allocate(requested_size);
+		// first version, later versions are allocated on update
+		auto alloc = m_constant_versioned_bufs[m_curr_frame_idx]->allocate(requested_size);
 		resource->alloc = alloc;
 		resource->is_transient = false;
 
-		// grab temp staging memory
-		auto staging = m_constant_ring_buf->allocate(requested_size);
-
-		// copy data to staging
-		auto dst = staging.mapped_memory();
-		auto src = desc.data;
-		std::memcpy(dst, src, desc.data_size);
-
-		// schedule GPU-GPU copy to new version
-		auto upload_func = [staging, alloc, requested_size](ID3D12GraphicsCommandList* cmdl)
-		{
-			cmdl->CopyBufferRegion(
-				alloc.base_buffer(), alloc.offset_from_base(),
-				staging.base_buffer(), staging.offset_from_base(), requested_size);
-		};
-		m_deferred_init_copies.push(upload_func);
-
-
+		// copy the whole slot so that neighbouring constants coalesce into a single copy
+		stage_init_data(alloc, desc.data, desc.data_size, alloc.size());
 	}
 	// Write-once-read-once --> MSFT recommends Upload Heap
 	// https://docs.microsoft.com/en-us/windows/win32/direct3d12/uploading-resources
@@ -316,26 +329,13 @@ DXBufferManager::InternalBufferResource* DXBufferManager::create_constant(const
 		assert(alloc.mappable());
 		std::memcpy(alloc.mapped_memory(), desc.data, desc.data_size);
 	}
-	else if (usage_cpu == UsageIntentCPU::eUpdateOnce && usage_gpu == UsageIntentGPU::eReadMultipleTimesPerFrame)
-	{
-		// not supported for now
-		// allocate from persistent allocator (max FIF versions, to handle worst case)
-		// each update request --> cycle resource --> copy up to new resource
-		// on the update request --> we discard the existing allocation by pushing it into a deletion queue 
-		// deletion queue includes a lambda
-		// allocate from persistent allocator
-		//auto alloc = m_constant_persistent_buf->allocate(requested_size);
-		auto alloc = m_constant_persistent_bufs[m_curr_frame_idx]->allocate(requested_size);
-		resource->alloc = alloc;
-		resource->is_transient = true;
-
-		assert(false);
-	}
+	// Streamed: every write grabs fresh memory from the ring buffer (see stream_constant)
 	else if (usage_cpu == UsageIntentCPU::eUpdateMultipleTimesPerFrame && usage_gpu == UsageIntentGPU::eReadMultipleTimesPerFrame)
 	{
-		// not supported for now: this could either be on Upload Heap OR device-local
-		// we could just subscribe this to the ring buffer, but not doing it now unless we need this explicitly.
-		assert(false);
+		// no memory is kept: a version outlives neither its frame nor the next write,
+		// so versions are only bound through the address stream_constant returns
+		assert(desc.data == nullptr);
+		resource->is_transient = true;
 	}
 	else if (usage_cpu == UsageIntentCPU::eUpdateMultipleTimesPerFrame && usage_gpu == UsageIntentGPU::eReadOncePerFrame)
 	{
@@ -370,64 +370,17 @@ DXBufferManager::InternalBufferResource* DXBufferManager::create_non_constant(co
 		resource->is_transient = false;
 
 		if (desc.data && desc.data_size > 0)
-		{
-			// grab temp staging memory
-			auto staging = m_committed_upload_ator->allocate(desc.element_count, desc.element_size);
-
-			// copy data to staging
-			auto dst = staging.mapped_memory();
-			auto src = desc.data;
-			std::memcpy(dst, src, desc.data_size);
-
-			// schedule GPU-GPU copy to new version
-			auto upload_func = [staging, alloc = resource->alloc, requested_size](ID3D12GraphicsCommandList* cmdl)
-			{
-				cmdl->CopyBufferRegion(
-					alloc.base_buffer(), alloc.offset_from_base(),
-					staging.base_buffer(), staging.offset_from_base(), requested_size);
-			};
-			m_deferred_init_copies.push(upload_func);
-
-			// remove staging later (we need to guarantee GPU-GPU copy)
-			auto del_func = [this, staging]() mutable
-			{
-				m_committed_upload_ator->deallocate(std::move(staging));
-			};
-			m_deletion_queue.push({ m_curr_frame_idx, del_func });		// defer destruction of staging until next frame
-		}
+			stage_init_data(resource->alloc, desc.data, desc.data_size);
 	}
-	// Immutable
-	else if (desc.usage_cpu == UsageIntentCPU::eUpdateNever && desc.usage_gpu != UsageIntentGPU::eInvalid)
+	// Immutable OR updated in place by ranges through the upload context (see DXUploadContext::mark_dirty)
+	else if ((desc.usage_cpu == UsageIntentCPU::eUpdateNever || desc.usage_cpu == UsageIntentCPU::eUpdateSometimes) && 
+		desc.usage_gpu != UsageIntentGPU::eInvalid)
 	{
 		resource->alloc = std::move(m_committed_def_ator->allocate(desc.element_count, desc.element_size));
 		resource->is_transient = false;
 
 		if (desc.data && desc.data_size > 0)
-		{
-			// grab temp staging memory
-			auto staging = m_committed_upload_ator->allocate(desc.element_count, desc.element_size);
-
-			// copy data to staging
-			auto dst = staging.mapped_memory();
-			auto src = desc.data;
-			std::memcpy(dst, src, desc.data_size);
-
-			// schedule GPU-GPU copy to new version
-			auto upload_func = [staging, alloc = resource->alloc, requested_size](ID3D12GraphicsCommandList* cmdl)
-			{
-				cmdl->CopyBufferRegion(
-					alloc.base_buffer(), alloc.offset_from_base(),
-					staging.base_buffer(), staging.offset_from_base(), requested_size);
-			};
-			m_deferred_init_copies.push(upload_func);
-
-			// remove staging later (we need to guarantee GPU-GPU copy)
-			auto del_func = [this, staging]() mutable
-			{
-				m_committed_upload_ator->deallocate(std::move(staging));
-			};
-			m_deletion_queue.push({ m_curr_frame_idx, del_func });		// defer destruction of staging until next frame
-		}
+			stage_init_data(resource->alloc, desc.data, desc.data_size);
 	}
 
 	else
@@ -439,32 +392,103 @@ DXBufferManager::InternalBufferResource* DXBufferManager::create_non_constant(co
 
 void DXBufferManager::destroy_constant(InternalBufferResource* res)
 {
+	// GPU may still be reading the current version, free once this frame is off flight
 	if (res->usage_cpu == UsageIntentCPU::eUpdateNever)
 	{
-		//m_constant_persistent_buf->deallocate(std::move(res->alloc));
-		m_constant_persistent_bufs[res->frame_idx_allocation]->deallocate(std::move(res->alloc));
+		retire({ RetiredAllocation::Source::eConstantPersistent, 0, std::move(res->alloc) });
 		m_handles.free_handle(res->handle);
 	}
-	else if (res->usage_cpu == UsageIntentCPU::eUpdateOnce && res->usage_gpu == UsageIntentGPU::eReadOncePerFrame)
-	{
-		// automatically cleaned up on frame begin
-		return;
-	}
-	else if (res->usage_cpu == UsageIntentCPU::eUpdateOnce && res->usage_gpu == UsageIntentGPU::eReadMultipleTimesPerFrame)
+	else if ((res->usage_cpu == UsageIntentCPU::eUpdateOnce && res->usage_gpu == UsageIntentGPU::eReadOncePerFrame) ||
+		res->usage_cpu == UsageIntentCPU::eUpdateMultipleTimesPerFrame)
 	{
-		//m_constant_persistent_buf->deallocate(std::move(res->alloc));
-		m_constant_persistent_bufs[res->frame_idx_allocation]->deallocate(std::move(res->alloc));
+		// memory is automatically cleaned up by the ring buffer on frame begin
 		m_handles.free_handle(res->handle);
 	}
-	else if (res->usage_cpu == UsageIntentCPU::eUpdateSometimes)
+	else if (res->usage_cpu == UsageIntentCPU::eUpdateSometimes ||
+		(res->usage_cpu == UsageIntentCPU::eUpdateOnce && res->usage_gpu == UsageIntentGPU::eReadMultipleTimesPerFrame))
 	{
-		//m_constant_persistent_buf->deallocate(std::move(res->alloc));
-		m_constant_persistent_bufs[res->frame_idx_allocation]->deallocate(std::move(res->alloc));
+		retire({ RetiredAllocation::Source::eConstantVersioned, res->frame_idx_allocation, std::move(res->alloc) });
 		m_handles.free_handle(res->handle);
 	}
 	else
 		assert(false);
 }
 
+void DXBufferManager::stage_init_data(const DXBufferAllocation& dst, const void* data, size_t data_size, size_t region_size)
+{
+	region_size = (std::max)(region_size, data_size);
+	const auto staging = allocate_staging(region_size);
+
+	// copy data to staging
+	if (data && data_size > 0)
+		std::memcpy(staging.mapped_memory(), data, data_size);
+
+	// schedule GPU-GPU copy
+	BufferCopy copy{};
+	copy.dst = dst.base_buffer();
+	copy.dst_offset = dst.offset_from_base();
+	copy.src = staging.base_buffer();
+	copy.src_offset = staging.offset_from_base();
+	copy.size = region_size;
+	queue_init_copy(copy);
+}
+
+DXBufferAllocation DXBufferManager::allocate_staging(size_t size)
+{
+	// grab temp staging memory, fall back to a dedicated upload buffer if the ring is full (e.g large loads within a single frame)
+	auto staging = m_staging_ring_buf->try_allocate(size);
+	if (staging.base_buffer())
+		return staging;
+
+	staging = m_committed_upload_ator->allocate(1, (uint32_t)size);
+
+	// remove staging later (we need to guarantee GPU-GPU copy), the returned copy stays valid until then.
+	// Copies are recorded this frame (dirty ranges) or with the next one (init copies), retire for the latter
+	m_retired.retire(m_retirement->current_fence_value() + 1, { RetiredAllocation::Source::eCommittedUpload, 0, staging });
+	return staging;
+}
+
+void DXBufferManager::queue_init_copy(const BufferCopy& copy)
+{
+	// extend the previous copy if both regions continue where it left off
+	if (!m_deferred_init_copies.empty())
+	{
+		auto& prev = m_deferred_init_copies.back();
+		if (prev.dst == copy.dst && prev.src == copy.src &&
+			prev.dst_offset + prev.size == copy.dst_offset &&
+			prev.src_offset + prev.size == copy.src_offset)
+		{
+			prev.size += copy.size;
+			return;
+		}
+	}
+	m_deferred_init_copies.push_back(copy);
+}
 
+void DXBufferManager::retire(RetiredAllocation&& record)
+{
+	// copies queued but not yet recorded by the upload context only execute with the next frame
+	const auto fence_value = m_retirement->current_fence_value() + (m_deferred_init_copies.empty() ? 0 : 1);
+	m_retired.retire(fence_value, std::move(record));
+}
 
+void DXBufferManager::release(RetiredAllocation& record)
+{
+	switch (record.source)
+	{
+	case RetiredAllocation::Source::eConstantPersistent:
+		m_constant_persistent_buf->deallocate(std::move(record.alloc));
+		break;
+	case RetiredAllocation::Source::eConstantVersioned:
+		m_constant_versioned_bufs[record.version_idx]->deallocate(std::move(record.alloc));
+		break;
+	case RetiredAllocation::Source::eCommittedDefault:
+		m_committed_def_ator->deallocate(std::move(record.alloc));
+		break;
+	case RetiredAllocation::Source::eCommittedUpload:
+		m_committed_upload_ator->deallocate(std::move(record.alloc));
+		break;
+	default:
+		assert(false);
+	}
+}
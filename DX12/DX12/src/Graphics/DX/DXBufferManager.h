@@ -1,11 +1,13 @@
 #pragma once
-#include <functional>
+#include <queue>
 #include "Utilities/HandlePool.h"
+#include "Utilities/RetirementQueue.h"
 #include "Graphics/DX/DXCommon.h"
+#include "Graphics/DX/DXRetirementService.h"
 
 
 #include "Buffer/DXBufferPoolAllocator.h"			// Suballocators
-#include "Buffer/DXBufferRingPoolAllocator.h"		// Suballocators
+#include "Buffer/DXBufferRingAllocator.h"			// Linear allocator for transient memory
 #include "Buffer/DXBufferGenericAllocator.h"		// Committed resource allocator
 
 // Allocation algorithms for constant data management
@@ -44,7 +46,7 @@ class DXBufferManager
 {
 
 public:
-	DXBufferManager(Microsoft::WRL::ComPtr<ID3D12Device> dev, uint32_t max_fif);
+	DXBufferManager(Microsoft::WRL::ComPtr<ID3D12Device> dev, uint32_t max_fif, DXRetirementService* retirement);
 	~DXBufferManager();
 
 	void frame_begin(uint32_t frame_idx);
@@ -58,12 +60,25 @@ public:
 	void create_cbv(BufferHandle handle, D3D12_CPU_DESCRIPTOR_HANDLE descriptor);	// constant view
 	void create_srv(BufferHandle handle, D3D12_CPU_DESCRIPTOR_HANDLE descriptor, uint32_t start_el, uint32_t num_el, bool raw = false);		// structured view
 	void create_rt_accel_view(BufferHandle handle, D3D12_CPU_DESCRIPTOR_HANDLE descriptor);
+
+	// View descriptions used by the create functions above (e.g for DXViewCache)
+	D3D12_CONSTANT_BUFFER_VIEW_DESC get_cbv_desc(BufferHandle handle);
+	D3D12_SHADER_RESOURCE_VIEW_DESC get_srv_desc(BufferHandle handle, uint32_t start_el, uint32_t num_el, bool raw = false);
+	ID3D12Resource* get_resource(BufferHandle handle);
 	D3D12_INDEX_BUFFER_VIEW get_ibv(BufferHandle handle, DXGI_FORMAT format = DXGI_FORMAT_R32_UINT);
 
 	uint32_t get_element_count(BufferHandle handle);
 
 	const DXBufferAllocation* get_buffer_alloc(BufferHandle handle);
 
+	// Writes a new version of a streamed constant (eUpdateMultipleTimesPerFrame) and returns its address.
+	// Each call grabs fresh ring memory, so earlier addresses stay valid for draws already recorded this frame.
+	// Streamed constants have no memory of their own (no initial data), this address is the only way to bind them.
+	D3D12_GPU_VIRTUAL_ADDRESS stream_constant(BufferHandle handle, const void* data, size_t size);
+
+	// Usage statistics of every internal allocator
+	std::vector<NamedAllocatorStats> get_allocator_stats() const;
+
 private:
 	friend class DXUploadContext;
 
@@ -85,6 +100,7 @@ private:
 	};
 
 	InternalBufferResource* get_internal_buf(BufferHandle handle);
+	static bool is_streamed(const InternalBufferResource* res) { return res->is_constant && res->usage_cpu == UsageIntentCPU::eUpdateMultipleTimesPerFrame; }
 
 
 private:
@@ -93,19 +109,59 @@ private:
 	InternalBufferResource* create_non_constant(const DXBufferDesc& desc);
 	void destroy_constant(InternalBufferResource* res);
 
+	// Buffer-to-buffer copy recorded by the upload context. Resources are not kept alive by the record.
+	struct BufferCopy
+	{
+		ID3D12Resource* dst = nullptr;
+		uint64_t dst_offset = 0;
+		ID3D12Resource* src = nullptr;
+		uint64_t src_offset = 0;
+		uint64_t size = 0;
+	};
+
+	// Memory which may still be in use by the GPU, released once the fence value it was retired on is reached
+	struct RetiredAllocation
+	{
+		enum class Source : uint8_t
+		{
+			eConstantPersistent,
+			eConstantVersioned,
+			eCommittedDefault,
+			eCommittedUpload
+		};
+
+		Source source = Source::eCommittedDefault;
+		uint32_t version_idx = 0;		// Versioned pool the allocation belongs to
+		DXBufferAllocation alloc;
+	};
+
+	void retire(RetiredAllocation&& record);
+	void release(RetiredAllocation& record);
+
+	// Copies initial data to staging memory and queues the GPU-GPU copy of region_size bytes (at least data_size) to dst
+	void stage_init_data(const DXBufferAllocation& dst, const void* data, size_t data_size, size_t region_size = 0);
+
+	// Mapped upload memory valid for copies recorded this frame (staging ring, or a committed upload buffer if the ring is full)
+	DXBufferAllocation allocate_staging(size_t size);
+	void queue_init_copy(const BufferCopy& copy);
+
 private:
 	Microsoft::WRL::ComPtr<ID3D12Device> m_dev;
 	HandlePool<InternalBufferResource> m_handles;
 	uint32_t m_curr_frame_idx = 0;
 
-	bool m_first_frame = true;
+	DXRetirementService* m_retirement = nullptr;
+	RetirementQueue<RetiredAllocation> m_retired;
 
 
 
-	std::unique_ptr<DXBufferRingPoolAllocator> m_constant_ring_buf;
+	std::unique_ptr<DXBufferRingAllocator> m_constant_ring_buf;
 
 
-	// one for each FIF since we resource states can be different..
+	// Immutable constants: written once on creation, a single copy is shared by all frames in flight
+	std::unique_ptr<DXBufferPoolAllocator> m_constant_persistent_buf;
+
+	// Versioned constants: every update grabs a new version from the pool of the current frame, the old version is freed once off flight
 	/*
 		
 	"At any given time, a subresource is in exactly one state, determined by the set of D3D12_RESOURCE_STATES flags supplied to ResourceBarrier. 
@@ -114,15 +170,14 @@ private:
 	
 	*/
 	// one for each FIF since we resource states can be different..
-	std::vector<std::unique_ptr<DXBufferPoolAllocator>> m_constant_persistent_bufs;
-	//std::unique_ptr<DXBufferPoolAllocator> m_constant_persistent_buf;
-
+	std::vector<std::unique_ptr<DXBufferPoolAllocator>> m_constant_versioned_bufs;
 
-	std::queue<std::pair<uint32_t, std::function<void()>>> m_deletion_queue;		// pair: [frame idx to delete on, deletion function]
 
+	// Staging memory for initial data, committed upload buffers are only used if the ring is full
+	std::unique_ptr<DXBufferRingAllocator> m_staging_ring_buf;
 
-	// Defers to the initialization of data on device-local onto the first frame (handled by UploadContext)
-	std::queue<std::function<void(ID3D12GraphicsCommandList*)>> m_deferred_init_copies;
+	// Defers to the initialization of data on device-local onto the first frame (recorded by UploadContext, sorted and merged)
+	std::vector<BufferCopy> m_deferred_init_copies;
 
 	std::unique_ptr<DXBufferGenericAllocator> m_committed_def_ator;
 	std::unique_ptr<DXBufferGenericAllocator> m_committed_upload_ator;
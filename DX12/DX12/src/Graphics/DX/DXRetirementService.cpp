@@ -0,0 +1,29 @@
+#include "pch.h"
+#include "DXRetirementService.h"
+
+DXRetirementService::DXRetirementService(ID3D12Device* dev)
+{
+	auto hr = dev->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(m_fence.GetAddressOf()));
+	if (FAILED(hr))
+		assert(false);
+}
+
+uint64_t DXRetirementService::completed_fence_value() const
+{
+	return m_fence->GetCompletedValue();
+}
+
+void DXRetirementService::frame_end(ID3D12CommandQueue* queue)
+{
+	auto hr = queue->Signal(m_fence.Get(), m_current_value);
+	if (FAILED(hr))
+		assert(false);
+	++m_current_value;
+}
+
+void DXRetirementService::wait(ID3D12CommandQueue* queue, uint64_t fence_value) const
+{
+	auto hr = queue->Wait(m_fence.Get(), fence_value);
+	if (FAILED(hr))
+		assert(false);
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include "DXCommon.h"
+
+/*
+	Tracks completion of the work submitted on a queue with a single monotonic fence.
+
+	Every frame owns a fence value (current_fence_value) which is signaled on the queue at frame_end, after the last submission of the frame.
+	Resources which are no longer needed are retired against the current value in a RetirementQueue and released
+	as soon as the GPU has passed it, instead of waiting until the same frame index comes around again.
+
+	Work on other queues is covered as long as the queue waits for it before the frame's signal (e.g async copy).
+*/
+class DXRetirementService
+{
+public:
+	DXRetirementService(ID3D12Device* dev);
+	~DXRetirementService() = default;
+
+	// Value signaled once all work submitted during the current frame is done
+	uint64_t current_fence_value() const { return m_current_value; }
+	uint64_t completed_fence_value() const;
+
+	// Signals the current value on the queue and moves on to the next
+	void frame_end(ID3D12CommandQueue* queue);
+
+	// GPU-side wait on another queue until the given value is reached (e.g copies overwriting data read by earlier frames)
+	void wait(ID3D12CommandQueue* queue, uint64_t fence_value) const;
+
+private:
+	cptr<ID3D12Fence> m_fence;
+	uint64_t m_current_value = 1;
+};
@@ -1,10 +1,14 @@
 #include "pch.h"
 #include "DXTextureManager.h"
+#include "Utilities/Hash.h"
+#include "Utilities/Stopwatch.h"
 
 
-DXTextureManager::DXTextureManager(cptr<ID3D12Device> dev, cptr<ID3D12CommandQueue> wait_queue) :
+DXTextureManager::DXTextureManager(cptr<ID3D12Device> dev, cptr<ID3D12CommandQueue> wait_queue, ThreadPool* workers, DXRetirementService* retirement) :
 	m_dev(dev),
-	m_wait_queue(wait_queue)
+	m_wait_queue(wait_queue),
+	m_workers(workers),
+	m_retirement(retirement)
 {
 	m_up_batch = std::make_unique<DirectX::ResourceUploadBatch>(dev.Get());
 
@@ -19,60 +23,539 @@ DXTextureManager::DXTextureManager(cptr<ID3D12Device> dev, cptr<ID3D12CommandQue
 	m_def_tex = create_texture(def);
 }
 
+DXTextureManager::~DXTextureManager()
+{
+	// decode jobs write to this manager
+	if (m_workers)
+		m_workers->wait_idle();
+	if (m_in_flight.finished.valid())
+		m_in_flight.finished.wait();
+
+	// owner waits for the GPU before tearing down
+	m_retired.release_all([](cptr<ID3D12Resource>&) {});
+}
+
 TextureHandle DXTextureManager::create_texture(const DXTextureDesc& desc)
 {
 	if (!desc.filepath.has_filename())
+	{
+		m_handles.get_resource(m_def_tex.handle)->add_ref("");
 		return m_def_tex;			// default texture
+	}
 
-	auto it = m_loaded_path_to_handle.find(desc.filepath.string());
-	if (it != m_loaded_path_to_handle.cend())
+	uint64_t content_hash = 0;
+	if (const auto loaded = acquire_loaded(desc, content_hash); loaded != 0)
+		return TextureHandle(loaded);
+
+	// Dynamic textures not supported for now (but we will soon)
+	if (desc.usage_cpu != UsageIntentCPU::eUpdateNever)
+		assert(false);
+
+	Stopwatch decode_time;
+	decode_time.start();
+	DecodedTexture loaded{};
+	if (!load_cooked(desc.filepath, loaded) && !load_wic(desc.filepath, get_load_flags(desc), loaded))
 	{
-		return TextureHandle(it->second);;
+		// fall back to the default texture (which itself has to load)
+		std::cout << fmt::format("Failed to load texture: {}\n", desc.filepath.string());
+		assert(m_def_tex.handle != 0);
+		m_handles.get_resource(m_def_tex.handle)->add_ref("");
+		return m_def_tex;
 	}
+	decode_time.stop();
 
 	m_up_batch->Begin();
+	upload(*m_up_batch.get(), loaded);
+	auto finish = m_up_batch->End(m_wait_queue.Get());
+
+	auto [handle, internal_res] = m_handles.get_next_free_handle();
+	internal_res->tex = DXTexture(loaded.res);
+	internal_res->usage_cpu = desc.usage_cpu;
+	internal_res->usage_gpu = desc.usage_gpu;
+	internal_res->resident = true;
+	internal_res->vram_bytes = get_vram_bytes(loaded.res.Get());
+	internal_res->decode_ms = decode_time.elapsed(Stopwatch::Unit::eMillisecond);
+
+	// Wait for the upload thread to terminate
+	finish.wait();
+
+	register_loaded(desc, handle, content_hash);
+	if (loaded.cooked.is_open())
+		add_streamed(handle, std::move(loaded.cooked));
+
+	return TextureHandle(handle);
+}
+
+TextureHandle DXTextureManager::create_texture_async(const DXTextureDesc& desc)
+{
+	if (!m_workers)
+		return create_texture(desc);
+
+	if (!desc.filepath.has_filename())
+	{
+		m_handles.get_resource(m_def_tex.handle)->add_ref("");
+		return m_def_tex;			// default texture
+	}
+
+	uint64_t content_hash = 0;
+	if (const auto loaded = acquire_loaded(desc, content_hash); loaded != 0)
+		return TextureHandle(loaded);
 
 	// Dynamic textures not supported for now (but we will soon)
 	if (desc.usage_cpu != UsageIntentCPU::eUpdateNever)
 		assert(false);
 
-	DirectX::WIC_LOADER_FLAGS flags =
-		DirectX::WIC_LOADER_FLAGS::WIC_LOADER_MIP_AUTOGEN |
-		DirectX::WIC_LOADER_FLAGS::WIC_LOADER_FORCE_RGBA32;
-		//DirectX::WIC_LOADER_FLAGS::WIC_LOADER_FIT_POW2;		// It seems like it sometimes uses BGRA instead..
+	// refer to the default texture until resident
+	auto [handle, internal_res] = m_handles.get_next_free_handle();
+	internal_res->tex = DXTexture(get_resource(m_def_tex));
+	internal_res->usage_cpu = desc.usage_cpu;
+	internal_res->usage_gpu = desc.usage_gpu;
+	internal_res->resident = false;
 
-	if (desc.flag == TextureFlag::eSRGB)
-		flags |= DirectX::WIC_LOADER_FLAGS::WIC_LOADER_FORCE_SRGB;
+	register_loaded(desc, handle, content_hash);
+	internal_res->begin_upload();
+	++m_num_decoding;
 
-	cptr<ID3D12Resource> res;
-	// force SRGB (we do gamma correct rendering)
-	auto hr = DirectX::CreateWICTextureFromFileEx(m_dev.Get(), *m_up_batch.get(), desc.filepath.c_str(), 0, D3D12_RESOURCE_FLAG_NONE, flags, res.GetAddressOf());
+	// decode (and create the resource) in the background
+	m_workers->submit([this, handle = handle, path = desc.filepath, flags = get_load_flags(desc)]()
+		{
+			Stopwatch decode_time;
+			decode_time.start();
+			DecodedTexture decoded{};
+			decoded.handle = handle;
+			if (!load_cooked(path, decoded) && !load_wic(path, flags, decoded))
+			{
+				// no resource, the handle keeps referring to the default texture
+				decoded.res.Reset();
+				std::cout << fmt::format("Failed to load texture: {}\n", path.string());
+			}
+			decode_time.stop();
+			decoded.decode_ms = decode_time.elapsed(Stopwatch::Unit::eMillisecond);
+
+			std::lock_guard<std::mutex> lock(m_decoded_mutex);
+			m_decoded.push_back(std::move(decoded));
+		});
+
+	return TextureHandle(handle);
+}
+
+const std::vector<TextureHandle>& DXTextureManager::frame_begin()
+{
+	m_resident_this_frame.clear();
+	++m_frame_count;			// streaming holds count frames, planning is skipped while a batch is in flight
+
+	if (m_retirement)
+		m_retired.release_completed(m_retirement->completed_fence_value(), [](cptr<ID3D12Resource>&) {});
+
+	// swap in the textures of the previous batch once it is done, otherwise keep decoded textures waiting
+	if (m_in_flight.finished.valid())
+	{
+		if (m_in_flight.finished.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+			return m_resident_this_frame;
+		finish_upload();
+	}
+
+	plan_streaming();
+	kick_upload();
+	return m_resident_this_frame;
+}
+
+void DXTextureManager::kick_upload()
+{
+	std::vector<DecodedTexture> decoded;
+	{
+		std::lock_guard<std::mutex> lock(m_decoded_mutex);
+		std::swap(decoded, m_decoded);
+	}
+
+	m_num_decoding -= (uint32_t)decoded.size();
+
+	// streamed textures go out with the same batch
+	for (auto& tex : m_stream_uploads)
+		decoded.push_back(std::move(tex));
+	m_stream_uploads.clear();
+
+	if (decoded.empty())
+		return;
+
+	// single batch for everything decoded since the last upload
+	m_up_batch->Begin();
+	for (auto& tex : decoded)
+	{
+		// destroyed while decoding, or failed to load (keeps the default texture)
+		auto res = m_handles.get_resource(tex.handle);
+		if (res->destroyed || !tex.res)
+		{
+			end_upload(tex.handle);
+			continue;
+		}
+
+		upload(*m_up_batch.get(), tex);
+
+		// streamed re-uploads keep the decode time of the initial load
+		if (tex.decode_ms > 0.0)
+			res->decode_ms = tex.decode_ms;
+		if (tex.cooked.is_open())
+			add_streamed(tex.handle, std::move(tex.cooked));
+
+		m_in_flight.textures.push_back({ tex.handle, std::move(tex.res) });
+	}
+	m_in_flight.finished = m_up_batch->End(m_wait_queue.Get());
+}
+
+void DXTextureManager::finish_upload()
+{
+	m_in_flight.finished.get();
+
+	for (auto& [handle, res] : m_in_flight.textures)
+	{
+		// destroyed while uploading, the new resource was never used
+		auto internal_res = m_handles.get_resource(handle);
+		if (internal_res->destroyed)
+		{
+			end_upload(handle);
+			continue;
+		}
+
+		internal_res->vram_bytes = get_vram_bytes(res.Get());
+
+		// the replaced texture may still be used by frames in flight (the default texture for async loads)
+		if (m_retirement)
+			m_retired.retire(m_retirement->current_fence_value(), cptr<ID3D12Resource>(internal_res->tex.resource()));
+		internal_res->tex = DXTexture(std::move(res));
+		internal_res->resident = true;
+		end_upload(handle);
+		m_resident_this_frame.push_back(TextureHandle(handle));
+	}
+	m_in_flight = {};
+}
+
+void DXTextureManager::end_upload(uint64_t handle)
+{
+	if (m_handles.get_resource(handle)->end_upload())
+		free_texture(handle);
+}
+
+void DXTextureManager::free_texture(uint64_t handle)
+{
+	// frames in flight may still sample the current resource
+	auto res = m_handles.get_resource(handle);
+	if (m_retirement)
+		m_retired.retire(m_retirement->current_fence_value(), cptr<ID3D12Resource>(res->tex.resource()));
+	m_handles.free_handle(handle);
+}
+
+bool DXTextureManager::is_resident(TextureHandle handle)
+{
+	return m_handles.get_resource(handle.handle)->resident;
+}
+
+uint32_t DXTextureManager::num_pending() const
+{
+	return m_num_decoding + (uint32_t)m_in_flight.textures.size();
+}
+
+DXTextureManager::DedupStats DXTextureManager::get_dedup_stats()
+{
+	DedupStats stats{};
+	stats.hits = m_dedup_hits;
+	for (const auto& [content_hash, handle] : m_content_to_handle)
+	{
+		const auto res = m_handles.get_resource(handle);
+		if (!res->resident)
+			continue;			// size and decode time are known once loaded
+
+		// every path but one would have loaded its own copy
+		const auto duplicates = res->paths.empty() ? 0 : res->paths.size() - 1;
+		stats.vram_bytes_avoided += duplicates * res->vram_bytes;
+		stats.decode_ms_avoided += duplicates * res->decode_ms;
+	}
+	return stats;
+}
+
+uint64_t DXTextureManager::acquire_loaded(const DXTextureDesc& desc, uint64_t& content_hash)
+{
+	content_hash = 0;
+
+	const auto path = desc.filepath.string();
+	auto it = m_loaded_path_to_handle.find(path);
+	if (it != m_loaded_path_to_handle.cend())
+	{
+		m_handles.get_resource(it->second)->add_ref(path);
+		return it->second;
+	}
+
+	// same contents under another path (mapping and hashing the file is cheap next to decoding it)
+	content_hash = get_content_hash(desc);
+	if (content_hash == 0)
+		return 0;
+
+	auto content_it = m_content_to_handle.find(content_hash);
+	if (content_it == m_content_to_handle.cend())
+		return 0;
+
+	m_handles.get_resource(content_it->second)->add_path(path);
+	++m_dedup_hits;
+	m_loaded_path_to_handle.insert({ path, content_it->second });
+	return content_it->second;
+}
+
+void DXTextureManager::register_loaded(const DXTextureDesc& desc, uint64_t handle, uint64_t content_hash)
+{
+	// the slot may have been used by a destroyed texture before
+	m_handles.get_resource(handle)->acquire(desc.filepath.string(), content_hash);
+
+	m_loaded_path_to_handle.insert({ desc.filepath.string(), handle });
+	if (content_hash != 0)
+		m_content_to_handle.insert({ content_hash, handle });
+}
+
+uint64_t DXTextureManager::get_content_hash(const DXTextureDesc& desc)
+{
+	// hash what is actually uploaded, the cooked container if there is one
+	const auto cooked_path = get_cooked_path(desc.filepath);
+	const bool cooked = cooked_path != desc.filepath && std::filesystem::exists(cooked_path);
+
+	MappedFile file;
+	if (!file.open(cooked ? cooked_path : desc.filepath))
+		return 0;
+
+	// the same image loaded as sRGB and as linear are different textures (cooked containers store their format)
+	const uint64_t seed = cooked ? 0 : (uint64_t)get_load_flags(desc);
+	return xxhash64(file.data(), file.size(), seed);
+}
+
+void DXTextureManager::set_streaming(bool enabled, uint64_t budget_bytes)
+{
+	assert(!enabled || m_retirement);
+	m_streaming = enabled;
+	m_streaming_budget = budget_bytes;
+}
+
+void DXTextureManager::set_streaming_view(const ResidencyView& view)
+{
+	m_streaming_view = view;
+}
+
+void DXTextureManager::request_residency(TextureHandle handle, float distance, float radius)
+{
+	auto it = m_streamed.find(handle.handle);
+	if (it == m_streamed.cend())
+		return;			// loaded through WIC or not resident yet
+
+	const float mip = ResidencyPlanner::mip_for_screen_size(m_streaming_view, distance, radius, it->second.size);
+	m_planner.request(it->second.residency_id, (uint32_t)mip);
+}
+
+const ResidencyPlanner::Stats& DXTextureManager::get_streaming_stats() const
+{
+	return m_planner.get_stats();
+}
+
+void DXTextureManager::add_streamed(uint64_t handle, MappedFile&& cooked)
+{
+	// dropping mips re-creates the texture, the replaced one has to be retired
+	if (!m_retirement || m_streamed.count(handle) != 0)
+		return;
+
+	StreamedTexture streamed{};
+	streamed.cooked = std::move(cooked);
+	if (!streamed.container.parse(streamed.cooked.data(), streamed.cooked.size()))
+		return;
+
+	const auto& header = streamed.container.header();
+	ResidencyTextureDesc desc{};
+	for (uint32_t i = 0; i < header.mip_count; ++i)
+	{
+		const auto& mip = streamed.container.mip(i);
+		desc.mip_bytes.push_back(mip.size);
+
+		// block compressed top levels have to be a multiple of 4
+		if (mip.width % 4 == 0 && mip.height % 4 == 0)
+			desc.tail_mip = i;
+	}
+	desc.resident_mip = 0;
+
+	streamed.size = (std::max)(header.width, header.height);
+	streamed.residency_id = m_planner.add_texture(desc);
+	if (m_residency_to_handle.size() <= streamed.residency_id)
+		m_residency_to_handle.resize(streamed.residency_id + 1);
+	m_residency_to_handle[streamed.residency_id] = handle;
+
+	m_streamed.insert({ handle, std::move(streamed) });
+}
+
+void DXTextureManager::plan_streaming()
+{
+	if (m_streamed.empty())
+		return;
+
+	// full chains when disabled
+	if (!m_streaming)
+	{
+		for (const auto& [handle, streamed] : m_streamed)
+			m_planner.request(streamed.residency_id, 0);
+	}
+
+	for (const auto& change : m_planner.plan(m_streaming ? m_streaming_budget : ~0ull, m_frame_count))
+	{
+		const auto handle = m_residency_to_handle[change.id];
+
+		DecodedTexture tex{};
+		tex.handle = handle;
+		if (!create_from_container(m_streamed[handle].container, change.to_mip, tex))
+			assert(false);			// dropped in kick_upload, the current mips stay
+		m_handles.get_resource(handle)->begin_upload();
+		m_stream_uploads.push_back(std::move(tex));
+	}
+}
+
+uint64_t DXTextureManager::get_vram_bytes(ID3D12Resource* res)
+{
+	const auto desc = res->GetDesc();
+	return m_dev->GetResourceAllocationInfo(0, 1, &desc).SizeInBytes;
+}
+
+bool DXTextureManager::load_cooked(const std::filesystem::path& path, DecodedTexture& out)
+{
+	const auto cooked_path = get_cooked_path(path);
+	if (cooked_path == path || !std::filesystem::exists(cooked_path) || !out.cooked.open(cooked_path))
+		return false;
+
+	TextureContainerView container;
+	if (!container.parse(out.cooked.data(), out.cooked.size()))
+	{
+		out.cooked.close();
+		return false;
+	}
+
+	if (!create_from_container(container, 0, out))
+	{
+		out.cooked.close();
+		return false;
+	}
+	return true;
+}
+
+bool DXTextureManager::create_from_container(const TextureContainerView& container, uint32_t top_mip, DecodedTexture& out)
+{
+	const auto& header = container.header();
+	const auto format = get_cooked_format(header);
+	if (format == DXGI_FORMAT_UNKNOWN)
+		return false;
 
+	const auto& top = container.mip(top_mip);
+	auto desc = CD3DX12_RESOURCE_DESC::Tex2D(format, top.width, top.height, 1, (UINT16)(header.mip_count - top_mip));
+	auto heap_props = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
+	auto hr = m_dev->CreateCommittedResource(&heap_props, D3D12_HEAP_FLAG_NONE, &desc, D3D12_RESOURCE_STATE_COPY_DEST, nullptr, IID_PPV_ARGS(out.res.GetAddressOf()));
 	if (FAILED(hr))
+	{
 		assert(false);
+		return false;
+	}
 
-	auto [handle, internal_res] = m_handles.get_next_free_handle();
-	internal_res->tex = DXTexture(res);
+	// upload straight from the mapping
+	out.subresources.resize(header.mip_count - top_mip);
+	for (uint32_t i = top_mip; i < header.mip_count; ++i)
+	{
+		out.subresources[i - top_mip].pData = container.mip_data(i);
+		out.subresources[i - top_mip].RowPitch = container.mip(i).row_pitch;
+		out.subresources[i - top_mip].SlicePitch = container.mip(i).size;
+	}
+	out.generate_mips = false;
 
+	return true;
+}
 
-	auto finish = m_up_batch->End(m_wait_queue.Get());
+bool DXTextureManager::load_wic(const std::filesystem::path& path, DirectX::WIC_LOADER_FLAGS flags, DecodedTexture& out)
+{
+	const auto com_hr = CoInitializeEx(nullptr, COINIT_MULTITHREADED);		// WIC (no-op if already initialized on this thread)
 
-	// Wait for the upload thread to terminate
-	finish.wait();
+	out.subresources.resize(1);
+	auto hr = DirectX::LoadWICTextureFromFileEx(m_dev.Get(), path.c_str(), 0, D3D12_RESOURCE_FLAG_NONE, flags, out.res.GetAddressOf(), out.data, out.subresources[0]);
 
-	m_loaded_path_to_handle.insert({ desc.filepath.string(), handle});
+	if (SUCCEEDED(com_hr))
+		CoUninitialize();
 
-	return TextureHandle(handle);
+	if (FAILED(hr))
+		return false;
+
+	out.generate_mips = out.res->GetDesc().MipLevels > 1;
+	return true;
+}
+
+void DXTextureManager::upload(DirectX::ResourceUploadBatch& batch, DecodedTexture& tex)
+{
+	// the batch copies into its own upload buffers, the source memory can go right after
+	batch.Upload(tex.res.Get(), 0, tex.subresources.data(), (uint32_t)tex.subresources.size());
+	batch.Transition(tex.res.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+	if (tex.generate_mips)
+		batch.GenerateMips(tex.res.Get());
+}
+
+std::filesystem::path DXTextureManager::get_cooked_path(const std::filesystem::path& path)
+{
+	return std::filesystem::path(path).replace_extension(".ctex");
+}
+
+DXGI_FORMAT DXTextureManager::get_cooked_format(const TextureContainerHeader& header)
+{
+	switch (header.format)
+	{
+	case TextureContainerFormat::eBC1:
+		return header.srgb ? DXGI_FORMAT_BC1_UNORM_SRGB : DXGI_FORMAT_BC1_UNORM;
+	case TextureContainerFormat::eBC3:
+		return header.srgb ? DXGI_FORMAT_BC3_UNORM_SRGB : DXGI_FORMAT_BC3_UNORM;
+	case TextureContainerFormat::eBC4:
+		return DXGI_FORMAT_BC4_UNORM;
+	case TextureContainerFormat::eBC5:
+		return DXGI_FORMAT_BC5_UNORM;
+	case TextureContainerFormat::eBC7:
+		return header.srgb ? DXGI_FORMAT_BC7_UNORM_SRGB : DXGI_FORMAT_BC7_UNORM;
+	default:
+		return DXGI_FORMAT_UNKNOWN;
+	}
+}
+
+DirectX::WIC_LOADER_FLAGS DXTextureManager::get_load_flags(const DXTextureDesc& desc)
+{
+	DirectX::WIC_LOADER_FLAGS flags =
+		DirectX::WIC_LOADER_FLAGS::WIC_LOADER_MIP_AUTOGEN |
+		DirectX::WIC_LOADER_FLAGS::WIC_LOADER_FORCE_RGBA32;
+		//DirectX::WIC_LOADER_FLAGS::WIC_LOADER_FIT_POW2;		// It seems like it sometimes uses BGRA instead..
+
+	// force SRGB (we do gamma correct rendering)
+	if (desc.flag == TextureFlag::eSRGB)
+		flags |= DirectX::WIC_LOADER_FLAGS::WIC_LOADER_FORCE_SRGB;
+
+	return flags;
 }
 
 void DXTextureManager::destroy_texture(TextureHandle handle)
 {
-	m_handles.free_handle(handle.handle);
+	auto res = m_handles.get_resource(handle.handle);
 
-	auto it = std::find_if(m_loaded_path_to_handle.begin(), m_loaded_path_to_handle.end(), [handle](auto it) { return it.second == handle.handle;  });
+	// paths no longer referenced aren't found anymore (every path which resolved to it on the last reference)
+	std::vector<std::string> unreferenced;
+	const bool last_ref = res->release(unreferenced);
+	for (const auto& path : unreferenced)
+		m_loaded_path_to_handle.erase(path);
+	if (!last_ref)
+		return;
 
-	if (it != m_loaded_path_to_handle.cend())
-		m_loaded_path_to_handle.erase(it);
+	if (res->content_hash != 0)
+		m_content_to_handle.erase(res->content_hash);
+
+	// still decoding/uploading: freed once the last upload lands
+	if (res->retire())
+		free_texture(handle.handle);
+
+	auto streamed_it = m_streamed.find(handle.handle);
+	if (streamed_it != m_streamed.cend())
+	{
+		m_planner.remove_texture(streamed_it->second.residency_id);
+		m_streamed.erase(streamed_it);
+	}
 }
 
 ID3D12Resource* DXTextureManager::get_resource(TextureHandle tex)
@@ -81,6 +564,12 @@ ID3D12Resource* DXTextureManager::get_resource(TextureHandle tex)
 }
 
 void DXTextureManager::create_srv(TextureHandle handle, D3D12_CPU_DESCRIPTOR_HANDLE descriptor)
+{
+	const auto vdesc = get_srv_desc(handle);
+	m_dev->CreateShaderResourceView(get_resource(handle), &vdesc, descriptor);
+}
+
+D3D12_SHADER_RESOURCE_VIEW_DESC DXTextureManager::get_srv_desc(TextureHandle handle)
 {
 	auto res = m_handles.get_resource(handle.handle);
 
@@ -94,7 +583,5 @@ void DXTextureManager::create_srv(TextureHandle handle, D3D12_CPU_DESCRIPTOR_HAN
 	vdesc.Texture2D.MostDetailedMip = 0;
 	vdesc.Texture2D.PlaneSlice = 0;
 	vdesc.Texture2D.ResourceMinLODClamp = 0;
-
-	m_dev->CreateShaderResourceView(res->tex.resource(), &vdesc, descriptor);
-
+	return vdesc;
 }
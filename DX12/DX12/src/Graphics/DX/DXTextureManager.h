@@ -1,16 +1,24 @@
 #pragma once
 #include "DXCommon.h"
+#include "DXRetirementService.h"
 
 #include <unordered_map>
 
 #include "Texture/DXTexture.h"
 #include "Utilities/HandlePool.h"
+#include "Utilities/ThreadPool.h"
+#include "Utilities/MappedFile.h"
+#include "Utilities/TextureContainer.h"
+#include "Utilities/ResidencyPlanner.h"
+#include "Utilities/RetirementQueue.h"
+#include "Utilities/TextureSlotState.h"
 
 // DXTK for quick mip-mapped loading
 #include "DXTK/WICTextureLoader.h"
 #include "DXTK/ResourceUploadBatch.h"
 
-	
+#include <future>
+#include <mutex>
 
 
 // Strongly typed handle to a txture for the application to hold on to
@@ -20,7 +28,7 @@ struct TextureHandle
 
 	bool operator==(const TextureHandle& other) const
 	{
-		return handle == handle;
+		return handle == other.handle;
 	}
 
 	operator uint64_t() const
@@ -46,23 +54,66 @@ struct DXTextureDesc
 	std::filesystem::path filepath;
 };
 
+/*
+	Textures are loaded from file, either blocking (create_texture) or in the background (create_texture_async).
+
+	Async textures return a handle right away which refers to the default texture until the real one is resident.
+	Files are decoded on the worker pool, decoded textures are uploaded in one batch per frame (frame_begin)
+	and swapped in once the batch's fence has completed, frame_begin returns the textures which became resident.
+	Views of an async texture have to be recreated when it becomes resident.
+
+	Loads are deduplicated by path and by contents (xxhash64 of the file which is uploaded, plus the load flags):
+	identical images under different names share one resource. Every handle returned by create_* holds a reference,
+	destroy_texture releases it.
+
+	If a cooked sibling exists (same path with a .ctex extension, see tools/TextureCooker) it is memory mapped and
+	uploaded as is instead of decoding the source image: block compressed, all mips precomputed, sRGB as cooked.
+
+	Streaming (cooked textures only, needs the retirement service): users request residency every frame from their
+	distance and bounds, frame_begin plans the top mip of every texture against the budget (ResidencyPlanner) and
+	re-creates the textures whose top mip changed from their mapped container. They are swapped in like async loads,
+	the replaced resource is retired. With streaming disabled every texture goes back to its full chain.
+*/
 class DXTextureManager
 {
 public:
-	DXTextureManager(cptr<ID3D12Device> dev, cptr<ID3D12CommandQueue> wait_queue);
-	~DXTextureManager() = default;
+	struct DedupStats
+	{
+		uint64_t hits = 0;					// loads served by a texture with identical contents under another path
+		uint64_t vram_bytes_avoided = 0;	// by the duplicate paths still referenced
+		double decode_ms_avoided = 0.0;
+	};
+
+public:
+	DXTextureManager(cptr<ID3D12Device> dev, cptr<ID3D12CommandQueue> wait_queue, ThreadPool* workers = nullptr, DXRetirementService* retirement = nullptr);
+	~DXTextureManager();
 
 	TextureHandle create_texture(const DXTextureDesc& desc);
+	TextureHandle create_texture_async(const DXTextureDesc& desc);		// blocking if there are no workers
 	void destroy_texture(TextureHandle handle);
 
+	// Kicks off the upload of decoded textures, returns the textures which became resident since the last call
+	const std::vector<TextureHandle>& frame_begin();
+
+	bool is_resident(TextureHandle handle);
+	uint32_t num_pending() const;		// decoding or uploading
+	DedupStats get_dedup_stats();
+
+	void set_streaming(bool enabled, uint64_t budget_bytes);
+	void set_streaming_view(const ResidencyView& view);
+	void request_residency(TextureHandle handle, float distance, float radius);		// for this frame, ignored if not streamable
+	const ResidencyPlanner::Stats& get_streaming_stats() const;
+
 	ID3D12Resource* get_resource(TextureHandle tex);
 
 	void create_srv(TextureHandle handle, D3D12_CPU_DESCRIPTOR_HANDLE descriptor);
+	D3D12_SHADER_RESOURCE_VIEW_DESC get_srv_desc(TextureHandle handle);		// view description used by create_srv (e.g for DXViewCache)
 
 private:
 	friend class DXUploadContext;
 
-	struct InternalTextureResource
+	// references, paths and uploads in flight in TextureSlotState
+	struct InternalTextureResource : TextureSlotState
 	{
 		DXTexture tex;
 
@@ -70,21 +121,102 @@ private:
 		UsageIntentCPU usage_cpu = UsageIntentCPU::eInvalid;
 		UsageIntentGPU usage_gpu = UsageIntentGPU::eInvalid;
 		uint32_t frame_idx_allocation = 0;
+		bool resident = true;			// false while refering to the default texture
+
+		uint64_t vram_bytes = 0;
+		double decode_ms = 0.0;
 
 		uint64_t handle = 0;
 		void destroy() { tex.~tex(); }
 	};
 
+	struct DecodedTexture
+	{
+		uint64_t handle = 0;
+		cptr<ID3D12Resource> res;
+		std::unique_ptr<uint8_t[]> data;			// WIC decoded top mip
+		MappedFile cooked;							// or the cooked container backing the subresources
+		std::vector<D3D12_SUBRESOURCE_DATA> subresources;
+		bool generate_mips = false;
+		double decode_ms = 0.0;
+	};
+
+	struct StreamedTexture
+	{
+		MappedFile cooked;
+		TextureContainerView container;		// views the mapping
+		uint32_t residency_id = ResidencyPlanner::INVALID_ID;
+		uint32_t size = 0;					// larger dimension of mip 0
+	};
+
+	struct UploadBatch
+	{
+		std::future<void> finished;
+		std::vector<std::pair<uint64_t, cptr<ID3D12Resource>>> textures;
+	};
+
+private:
+	static DirectX::WIC_LOADER_FLAGS get_load_flags(const DXTextureDesc& desc);
+	static std::filesystem::path get_cooked_path(const std::filesystem::path& path);
+	static DXGI_FORMAT get_cooked_format(const TextureContainerHeader& header);
+
+	// Map the cooked container or decode through WIC, the resource is created in COPY_DEST (thread safe)
+	bool load_cooked(const std::filesystem::path& path, DecodedTexture& out);
+	bool create_from_container(const TextureContainerView& container, uint32_t top_mip, DecodedTexture& out);
+	bool load_wic(const std::filesystem::path& path, DirectX::WIC_LOADER_FLAGS flags, DecodedTexture& out);
+
+	void upload(DirectX::ResourceUploadBatch& batch, DecodedTexture& tex);
+
+	// Returns an already loaded texture with the same path or contents and adds a reference, 0 if there is none
+	uint64_t acquire_loaded(const DXTextureDesc& desc, uint64_t& content_hash);
+	void register_loaded(const DXTextureDesc& desc, uint64_t handle, uint64_t content_hash);
+	uint64_t get_content_hash(const DXTextureDesc& desc);		// 0 if the file can't be read
+	uint64_t get_vram_bytes(ID3D12Resource* res);
+
+	void add_streamed(uint64_t handle, MappedFile&& cooked);
+	void plan_streaming();
+
+	void kick_upload();
+	void finish_upload();
+
+	// Drops an upload's hold on the texture, a destroyed texture is freed with the last one
+	void end_upload(uint64_t handle);
+	void free_texture(uint64_t handle);
+
 private:
 	cptr<ID3D12Device> m_dev;
 	cptr<ID3D12CommandQueue> m_wait_queue;
 
 	std::unordered_map<std::string, uint64_t> m_loaded_path_to_handle;
+	std::unordered_map<uint64_t, uint64_t> m_content_to_handle;
+	uint64_t m_dedup_hits = 0;
 
 	HandlePool<InternalTextureResource> m_handles;
 	
 	uptr<DirectX::ResourceUploadBatch> m_up_batch;
 	TextureHandle m_def_tex;
 
+	ThreadPool* m_workers = nullptr;
+
+	// Written by the workers
+	std::mutex m_decoded_mutex;
+	std::vector<DecodedTexture> m_decoded;
+
+	uint32_t m_num_decoding = 0;
+	UploadBatch m_in_flight;
+	std::vector<TextureHandle> m_resident_this_frame;
+
+	DXRetirementService* m_retirement = nullptr;
+	RetirementQueue<cptr<ID3D12Resource>> m_retired;		// replaced by streaming
+
+	bool m_streaming = false;
+	uint64_t m_streaming_budget = 0;
+	ResidencyView m_streaming_view;
+	ResidencyPlanner m_planner;
+	uint64_t m_frame_count = 0;			// frame_begin calls
+	std::unordered_map<uint64_t, StreamedTexture> m_streamed;		// by texture handle
+	std::vector<uint64_t> m_residency_to_handle;
+	std::vector<DecodedTexture> m_stream_uploads;
+
 };
 
@@ -1,6 +1,7 @@
 #include "pch.h"
 #include "DXUploadContext.h"
 #include "WinPixEventRuntime/pix3.h"
+#include <algorithm>
 
 static int thing = 0;
 
@@ -58,15 +59,7 @@ void DXUploadContext::frame_begin(uint32_t frame_idx)
 #endif
 
 	// Upload initial data for device-local memory (if any) requested upon load on the Buffer Manager
-	while (!m_buf_mgr->m_deferred_init_copies.empty())
-	{
-		auto upload_func = m_buf_mgr->m_deferred_init_copies.front();
-
-		// call upload func on the copy queue
-		upload_func(m_cmdls[frame_idx].Get());
-
-		m_buf_mgr->m_deferred_init_copies.pop();
-	}
+	record_init_copies(m_cmdls[frame_idx].Get());
 	
 
 
@@ -84,12 +77,40 @@ void DXUploadContext::upload_data(void* data, size_t size, BufferHandle hdl)
 	{
 		update_constant(data, size, res);
 	}
+	else
+	{
+		mark_dirty(hdl, data, 0, size);
+	}
+}
+
+void DXUploadContext::mark_dirty(BufferHandle hdl, const void* data, uint64_t offset, uint64_t size)
+{
+	auto res = m_buf_mgr->get_internal_buf(hdl);
+	assert(!res->is_constant);
+	assert(res->usage_cpu == UsageIntentCPU::eUpdateSometimes && res->usage_gpu != UsageIntentGPU::eWrite);
+	assert(offset + size <= res->total_requested_size);
+
+	if (size == 0)
+		return;
+
+	DirtyWrite write{};
+	write.handle = res->handle;
+	write.dst_offset = offset;
+	write.size = size;
+	write.data_offset = m_dirty_data.size();
+	write.order = (uint32_t)m_dirty_writes.size();
+	m_dirty_writes.push_back(write);
+
+	const auto src = (const uint8_t*)data;
+	m_dirty_data.insert(m_dirty_data.end(), src, src + size);
 }
 
 void DXUploadContext::submit_work(uint64_t sig_val)
 {
 	auto cmdl = m_cmdls[m_curr_frame_idx].Get();
 
+	flush_dirty_ranges(cmdl);
+
 
 #ifndef _DEBUG
 	if (m_profiler)
@@ -101,6 +122,17 @@ void DXUploadContext::submit_work(uint64_t sig_val)
 #endif
 
 	cmdl->Close();
+
+	// in-place writes: every frame still in flight may read the ranges, the last one is the previous frame
+	// (this frame's graphics work waits on the copy)
+	if (!m_dirty_writes.empty())
+	{
+		auto retirement = m_buf_mgr->m_retirement;
+		retirement->wait(m_copy_queue.Get(), retirement->current_fence_value() - 1);
+		m_dirty_writes.clear();
+		m_dirty_data.clear();
+	}
+
 	ID3D12CommandList* cmdls[] = { cmdl };
 	m_copy_queue->ExecuteCommandLists(1, cmdls);
 	// Resources decays to common state
@@ -127,7 +159,8 @@ void DXUploadContext::wait_for_async_copy(ID3D12CommandQueue* queue)
 
 void DXUploadContext::update_constant(void* data, size_t size, DXBufferManager::InternalBufferResource* res)
 {
-	if (res->usage_cpu == UsageIntentCPU::eUpdateNever)
+	// streamed constants are written with DXBufferManager::stream_constant
+	if (res->usage_cpu == UsageIntentCPU::eUpdateNever || res->usage_cpu == UsageIntentCPU::eUpdateMultipleTimesPerFrame)
 	{
 		assert(false);
 	}
@@ -152,16 +185,11 @@ void DXUploadContext::update_constant(void* data, size_t size, DXBufferManager::
 			(res->usage_cpu == UsageIntentCPU::eUpdateOnce && res->usage_gpu == UsageIntentGPU::eReadMultipleTimesPerFrame)
 		)
 	{
-		// push delayed deallocation
-		auto del_func = [this, frame_idx = res->frame_idx_allocation, alloc = std::move(res->alloc)]() mutable
-		{
-			m_buf_mgr->m_constant_persistent_bufs[frame_idx]->deallocate(std::move(alloc));
-		};
-		// last time it was used is likely this frame (conservative)
-		m_buf_mgr->m_deletion_queue.push({ m_curr_frame_idx, del_func });
+		// push delayed deallocation (last time it was used is likely this frame, conservative)
+		m_buf_mgr->retire({ DXBufferManager::RetiredAllocation::Source::eConstantVersioned, res->frame_idx_allocation, std::move(res->alloc) });
 
 		// grab new version
-		auto new_alloc = m_buf_mgr->m_constant_persistent_bufs[m_curr_frame_idx]->allocate(res->total_requested_size);
+		auto new_alloc = m_buf_mgr->m_constant_versioned_bufs[m_curr_frame_idx]->allocate(res->total_requested_size);
 		res->frame_idx_allocation = m_curr_frame_idx;
 
 		// grab temp staging memory
@@ -184,3 +212,101 @@ void DXUploadContext::update_constant(void* data, size_t size, DXBufferManager::
 	}
 }
 
+void DXUploadContext::record_init_copies(ID3D12GraphicsCommandList* cmdl)
+{
+	auto& copies = m_buf_mgr->m_deferred_init_copies;
+	if (copies.empty())
+		return;
+
+	// order by destination so that contiguous regions end up next to each other (stable to keep submission order otherwise)
+	std::stable_sort(copies.begin(), copies.end(), [](const DXBufferManager::BufferCopy& a, const DXBufferManager::BufferCopy& b)
+		{
+			if (a.dst != b.dst)
+				return a.dst < b.dst;
+			return a.dst_offset < b.dst_offset;
+		});
+
+	// merge in place where both destination and source continue where the previous copy left off
+	size_t num_merged = 0;
+	for (size_t i = 1; i < copies.size(); ++i)
+	{
+		auto& prev = copies[num_merged];
+		const auto& curr = copies[i];
+		if (prev.dst == curr.dst && prev.src == curr.src &&
+			prev.dst_offset + prev.size == curr.dst_offset &&
+			prev.src_offset + prev.size == curr.src_offset)
+			prev.size += curr.size;
+		else
+			copies[++num_merged] = curr;
+	}
+	++num_merged;
+
+	for (size_t i = 0; i < num_merged; ++i)
+	{
+		const auto& copy = copies[i];
+		cmdl->CopyBufferRegion(copy.dst, copy.dst_offset, copy.src, copy.src_offset, copy.size);
+	}
+	copies.clear();
+}
+
+void DXUploadContext::flush_dirty_ranges(ID3D12GraphicsCommandList* cmdl)
+{
+	if (m_dirty_writes.empty())
+		return;
+
+	// group writes per buffer, ordered by offset
+	std::sort(m_dirty_writes.begin(), m_dirty_writes.end(), [](const DirtyWrite& a, const DirtyWrite& b)
+		{
+			if (a.handle != b.handle)
+				return a.handle < b.handle;
+			if (a.dst_offset != b.dst_offset)
+				return a.dst_offset < b.dst_offset;
+			return a.order < b.order;
+		});
+
+	size_t i = 0;
+	while (i < m_dirty_writes.size())
+	{
+		// grow the range while the next write overlaps or is adjacent
+		const auto handle = m_dirty_writes[i].handle;
+		const auto range_start = m_dirty_writes[i].dst_offset;
+		auto range_end = range_start + m_dirty_writes[i].size;
+
+		m_dirty_group.clear();
+		m_dirty_group.push_back((uint32_t)i);
+		size_t j = i + 1;
+		for (; j < m_dirty_writes.size(); ++j)
+		{
+			const auto& next = m_dirty_writes[j];
+			if (next.handle != handle || next.dst_offset > range_end)
+				break;
+			range_end = (std::max)(range_end, next.dst_offset + next.size);
+			m_dirty_group.push_back((uint32_t)j);
+		}
+
+		// the buffer may have been destroyed since it was marked
+		if (!m_buf_mgr->m_handles.is_valid(handle))
+		{
+			i = j;
+			continue;
+		}
+
+		// replay in submission order into staging
+		std::sort(m_dirty_group.begin(), m_dirty_group.end(), [this](uint32_t a, uint32_t b) { return m_dirty_writes[a].order < m_dirty_writes[b].order; });
+
+		const auto range_size = range_end - range_start;
+		const auto staging = m_buf_mgr->allocate_staging(range_size);
+		for (auto idx : m_dirty_group)
+		{
+			const auto& write = m_dirty_writes[idx];
+			std::memcpy(staging.mapped_memory() + (write.dst_offset - range_start), m_dirty_data.data() + write.data_offset, write.size);
+		}
+
+		const auto& dst = m_buf_mgr->m_handles.get_resource(handle)->alloc;
+		cmdl->CopyBufferRegion(
+			dst.base_buffer(), dst.offset_from_base() + range_start,
+			staging.base_buffer(), staging.offset_from_base(), range_size);
+
+		i = j;
+	}
+}
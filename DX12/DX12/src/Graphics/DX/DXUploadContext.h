@@ -24,9 +24,20 @@ public:
 	
 	*/
 
-	// CPU-to-GPU buffer upload
+	// CPU-to-GPU buffer upload (whole buffer for non-constant buffers)
 	void upload_data(void* data, size_t size, BufferHandle hdl);
 
+	/*
+		In-place partial update of a non-constant buffer (eUpdateSometimes), data is copied on call.
+		Writes are merged per buffer on submit_work (overlapping or adjacent ranges become one copy, later writes win),
+		so the copy cost scales with the bytes changed rather than the buffer size.
+
+		The copy lands before graphics work waiting on this frame (wait_for_async_copy).
+		Earlier frames may still read the range, so on frames with dirty writes the copy queue waits for the previous frame
+		to retire before the copies run (GPU-side wait). Frames without dirty writes keep copies overlapping with graphics.
+	*/
+	void mark_dirty(BufferHandle hdl, const void* data, uint64_t offset, uint64_t size);
+
 
 
 
@@ -39,6 +50,17 @@ public:
 
 private:
 	void update_constant(void* data, size_t size, DXBufferManager::InternalBufferResource* res);
+	void record_init_copies(ID3D12GraphicsCommandList* cmdl);
+	void flush_dirty_ranges(ID3D12GraphicsCommandList* cmdl);
+
+	struct DirtyWrite
+	{
+		uint64_t handle = 0;
+		uint64_t dst_offset = 0;
+		uint64_t size = 0;
+		uint64_t data_offset = 0;		// into m_dirty_data
+		uint32_t order = 0;				// submission order, later writes win on overlap
+	};
 
 
 
@@ -62,5 +84,10 @@ private:
 
 	GPUProfiler* m_profiler = nullptr;
 
+	// Pending partial updates for this frame
+	std::vector<DirtyWrite> m_dirty_writes;
+	std::vector<uint8_t> m_dirty_data;
+	std::vector<uint32_t> m_dirty_group;
+
 };
 
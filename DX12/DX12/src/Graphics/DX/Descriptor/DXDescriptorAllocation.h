@@ -15,12 +15,14 @@ public:
 		D3D12_GPU_DESCRIPTOR_HANDLE gpu_handle,
 		uint32_t descriptor_size,
 		uint32_t descriptor_count,
-		uint32_t offset_from_base)  :
+		uint32_t offset_from_base,
+		uint32_t owner_block = ~0u)  :
 		m_cpu_handle(cpu_handle),
 		m_gpu_handle(gpu_handle),
 		m_descriptor_size(descriptor_size),
 		m_descriptor_count(descriptor_count),
-		m_offset_from_base(offset_from_base)
+		m_offset_from_base(offset_from_base),
+		m_owner_block(owner_block)
 	{
 	}
 
@@ -28,6 +30,9 @@ public:
 	uint32_t descriptor_size() const { return m_descriptor_size; }
 	uint32_t offset_from_base() const { return m_offset_from_base; }
 
+	// Block within the allocator which handed out this allocation
+	uint32_t owner_block() const { return m_owner_block; }
+
 	bool gpu_visible() const { return m_gpu_handle.ptr != 0; }
 
 	D3D12_CPU_DESCRIPTOR_HANDLE cpu_handle(uint32_t index = 0) const 
@@ -55,6 +60,8 @@ private:
 
 	// Offset from the beginning of the heap this is allocated on
 	uint32_t m_offset_from_base = 0;
+
+	uint32_t m_owner_block = ~0u;
 };
 
 /*
@@ -72,6 +79,6 @@ private:
 	DXDescriptorAllocatorGPU		--> Uses DXDescriptorPool (shader visible)
 		make 2: One CBV/SRV/UAV and One Sampler
 
-	These two are thin wrappers, just like DXBufferPoolAllocator and RingPoolAllocator
+	These two are thin wrappers, just like DXBufferPoolAllocator and DXBufferRingAllocator
 
 */
@@ -38,6 +38,7 @@ void DXDescriptorHeapCPU::deallocate(DXDescriptorAllocation&& alloc)
 		assert(false);		// this allocation does not belong to this manager
 
 	// return allocation to pool
-	auto& [_, pool] = *it;
+	auto pool = it->second;
+	m_allocation_to_pool.erase(it);
 	pool->deallocate(std::move(alloc));
 }
@@ -1,7 +1,7 @@
 #include "pch.h"
 #include "DXDescriptorHeapGPU.h"
 
-DXDescriptorHeapGPU::DXDescriptorHeapGPU(cptr<ID3D12Device> dev, D3D12_DESCRIPTOR_HEAP_TYPE type, uint32_t max_descriptors) :
+DXDescriptorHeapGPU::DXDescriptorHeapGPU(cptr<ID3D12Device> dev, D3D12_DESCRIPTOR_HEAP_TYPE type, uint32_t max_descriptors, uint32_t max_fif) :
 	m_dev(dev),
 	m_type(type)
 {
@@ -13,34 +13,27 @@ DXDescriptorHeapGPU::DXDescriptorHeapGPU(cptr<ID3D12Device> dev, D3D12_DESCRIPTO
 
 	// steal allocations and sub-manage
 	m_static_part = std::make_unique<DXDescriptorPool>(dev, std::move(static_alloc), type);
-	m_dynamic_part = std::make_unique<DXDescriptorPool>(dev, std::move(dyn_alloc), type);
+	m_dynamic_part = std::make_unique<DXDescriptorRingBuffer>(std::move(dyn_alloc), max_fif);
 }
 
 void DXDescriptorHeapGPU::frame_begin(uint32_t frame_idx)
 {
-	m_frame_idx = frame_idx;
-
-	while (!m_active_dynamic_allocs2.empty())
-	{
-		auto& alloc_in_use = m_active_dynamic_allocs2.front();
-		if (alloc_in_use.frame_idx == frame_idx)
-		{
-			// remove from internal tracker
-			m_active_dynamic_allocs2.pop();
-
-			m_dynamic_part->deallocate(std::move(alloc_in_use.alloc));
-		}
-		else
-			break;
-	}
+	std::lock_guard<std::mutex> lock(m_mutex);
 
+	// retires the transient descriptors of the frame previously using this index
+	m_dynamic_part->frame_begin(frame_idx);
 }
 
 DXDescriptorAllocation DXDescriptorHeapGPU::allocate_static(uint32_t num_descriptors)
 {
+	std::lock_guard<std::mutex> lock(m_mutex);
+
 	auto to_ret = m_static_part->allocate(num_descriptors);
 	if (to_ret.num_descriptors() == 0)
+	{
 		assert(false);	// please increase size manually
+		return {};
+	}
 
 	// tag allocation
 	m_active_static_allocs.insert(to_ret.gpu_handle().ptr);
@@ -49,26 +42,23 @@ DXDescriptorAllocation DXDescriptorHeapGPU::allocate_static(uint32_t num_descrip
 
 DXDescriptorAllocation DXDescriptorHeapGPU::allocate_dynamic(uint32_t num_descriptors)
 {
+	std::lock_guard<std::mutex> lock(m_mutex);
+
 	auto to_ret = m_dynamic_part->allocate(num_descriptors);
 	if (to_ret.num_descriptors() == 0)
 		assert(false);	// please increase size manually
 
-	// tag allocation
-	m_active_dynamic_allocs.insert(to_ret.gpu_handle().ptr);
-
-	DynamicElement el{};
-	el.alloc = to_ret;
-	el.frame_idx = m_frame_idx;
-	m_active_dynamic_allocs2.push(std::move(el));
-
 	return to_ret;
 }
 
 void DXDescriptorHeapGPU::deallocate_static(DXDescriptorAllocation&& alloc)
 {
+	std::lock_guard<std::mutex> lock(m_mutex);
+
 	auto it = m_active_static_allocs.find(alloc.gpu_handle().ptr);
 	if (it == m_active_static_allocs.cend())
 		assert(false);		// couldnt find, programmer error
+	m_active_static_allocs.erase(it);
 
 	m_static_part->deallocate(std::move(alloc));
 }
@@ -77,3 +67,13 @@ ID3D12DescriptorHeap* DXDescriptorHeapGPU::get_desc_heap() const
 {
 	return m_base_main_pool->get_desc_heap();
 }
+
+AllocatorStats DXDescriptorHeapGPU::get_static_stats() const
+{
+	return m_static_part->get_stats();
+}
+
+AllocatorStats DXDescriptorHeapGPU::get_dynamic_stats() const
+{
+	return m_dynamic_part->get_stats();
+}
@@ -1,26 +1,34 @@
 #pragma once
 #include "DXDescriptorPool.h"
+#include "DXDescriptorRingBuffer.h"
 #include <set>
-#include <queue>
+#include <mutex>
 
 /*
 	Handles GPU-visible descriptor heaps
+
+	Allocation and deallocation are thread-safe (locked).
+	Threads recording in parallel should allocate through their own DXDescriptorSlab, which only comes here to refill in bulk.
 */
 class DXDescriptorHeapGPU
 {
 
 public:
-	DXDescriptorHeapGPU(cptr<ID3D12Device> dev, D3D12_DESCRIPTOR_HEAP_TYPE type, uint32_t max_descriptors = 2000);
+	DXDescriptorHeapGPU(cptr<ID3D12Device> dev, D3D12_DESCRIPTOR_HEAP_TYPE type, uint32_t max_descriptors = 2000, uint32_t max_fif = 3);
 
 	void frame_begin(uint32_t frame_idx);
 
 	DXDescriptorAllocation allocate_static(uint32_t num_descriptors);
 	void deallocate_static(DXDescriptorAllocation&& alloc);
 	
+	// Only valid during the current frame (transient, e.g per-draw tables)
 	DXDescriptorAllocation allocate_dynamic(uint32_t num_descriptors);
 	
 	ID3D12DescriptorHeap* get_desc_heap() const;
 
+	AllocatorStats get_static_stats() const;
+	AllocatorStats get_dynamic_stats() const;
+
 
 private:
 	cptr<ID3D12Device> m_dev;
@@ -38,30 +46,10 @@ private:
 	std::set<uint64_t> m_active_static_allocs;
 
 
+	// transient descriptors are discarded a frame at a time, a ring with a stack per frame suffices (single-threaded)
+	uptr<DXDescriptorRingBuffer> m_dynamic_part;
 
-	/*
-		=====================================================================
-		Below are ring buffer vars for the dynamic part (should refactor this into another class)
-
-		Lets analyze how to properly divide the Dynamic Part for management SOME OTHER TIME!
-		For now, lets assume single-thread usage and tackle only FIF.
-
-		=====================================================================
-	*/
-	struct DynamicElement
-	{
-		uint32_t frame_idx;
-		DXDescriptorAllocation alloc;
-	};
-
-	// due to the nature of transient descriptors, we may want to change the allocation strategy for the dynamic part in the future
-	// if we can assume that everything is discarded every frame, we can employ better algorithms (e.g ring)
-	uptr<DXDescriptorPool> m_dynamic_part;						
-	std::set<uint64_t> m_active_dynamic_allocs;
-
-	uint32_t m_frame_idx = 0;
-	std::queue<DynamicElement> m_active_dynamic_allocs2;
-
+	std::mutex m_mutex;
 
 };
 
@@ -6,7 +6,8 @@ DXDescriptorPool::DXDescriptorPool(cptr<ID3D12Device> dev, D3D12_DESCRIPTOR_HEAP
 	m_heap_type(type),
 	m_gpu_visible(gpu_visible),
 	m_max_descriptors(max_descriptors),
-	m_handle_size(dev->GetDescriptorHandleIncrementSize(type))
+	m_handle_size(dev->GetDescriptorHandleIncrementSize(type)),
+	m_ator(max_descriptors)
 {
 	assert(type != D3D12_DESCRIPTOR_HEAP_TYPE_NUM_TYPES);
 
@@ -18,26 +19,11 @@ DXDescriptorPool::DXDescriptorPool(cptr<ID3D12Device> dev, D3D12_DESCRIPTOR_HEAP
 	if (FAILED(hr))
 		assert(false);
 
-	//m_curr_cpu_unallocated_start = m_desc_heap->GetCPUDescriptorHandleForHeapStart();
-	//m_curr_gpu_unallocated_start = m_desc_heap->GetGPUDescriptorHandleForHeapStart();
-
-	DescriptorChunk full_chunk{};
-	full_chunk.cpu_start = m_desc_heap->GetCPUDescriptorHandleForHeapStart();;
-	if (gpu_visible)
-		full_chunk.gpu_start = m_desc_heap->GetGPUDescriptorHandleForHeapStart();
-	full_chunk.num_descriptors = max_descriptors;
-
+	m_cpu_start = m_desc_heap->GetCPUDescriptorHandleForHeapStart();
 	if (gpu_visible)
-		m_base_gpu_start = m_desc_heap->GetGPUDescriptorHandleForHeapStart();
-
-
-	//m_free_chunks.push_front(full_chunk);
+		m_gpu_start = m_desc_heap->GetGPUDescriptorHandleForHeapStart();
 
-
-	// allocate worst case needs (use in place memory instead of list)
-	//	m_used_indices = 1;
-	m_free_chunks2.reserve(max_descriptors);
-	m_free_chunks2.push_back(full_chunk);
+	m_stats.capacity_bytes = (uint64_t)max_descriptors * m_handle_size;
 }
 
 DXDescriptorPool::DXDescriptorPool(cptr<ID3D12Device> dev, DXDescriptorAllocation&& alloc, D3D12_DESCRIPTOR_HEAP_TYPE type) :
@@ -45,157 +31,58 @@ DXDescriptorPool::DXDescriptorPool(cptr<ID3D12Device> dev, DXDescriptorAllocatio
 	m_heap_type(type),
 	m_gpu_visible(alloc.gpu_visible()),
 	m_max_descriptors(alloc.num_descriptors()),
-	m_handle_size(dev->GetDescriptorHandleIncrementSize(type))
+	m_handle_size(dev->GetDescriptorHandleIncrementSize(type)),
+	m_ator(alloc.num_descriptors())
 {
-	// allocate worst case needs to keep memory in place
-	m_free_chunks2.reserve(alloc.num_descriptors());
-
-	DescriptorChunk new_chunk{};
-	new_chunk.cpu_start = alloc.cpu_handle();
-	new_chunk.gpu_start = alloc.gpu_handle();
-	new_chunk.num_descriptors = alloc.num_descriptors();
-	m_free_chunks2.push_back(new_chunk);
+	m_cpu_start = alloc.cpu_handle();
+	if (m_gpu_visible)
+		m_gpu_start = alloc.gpu_handle();
+	m_offset_from_base = alloc.offset_from_base();
 
-	m_base_gpu_start.ptr = alloc.gpu_handle().ptr - dev->GetDescriptorHandleIncrementSize(type) * alloc.offset_from_base();
+	m_stats.capacity_bytes = (uint64_t)m_max_descriptors * m_handle_size;
 }
 
 DXDescriptorAllocation DXDescriptorPool::allocate(uint32_t num_requested_descriptors)
 {
-	for (auto it = m_free_chunks2.begin(); it != m_free_chunks2.end(); ++it)
+	const auto range = m_ator.allocate(num_requested_descriptors);
+	if (!range.valid())
 	{
-		auto& chunk = *it;
-		if (chunk.num_descriptors == num_requested_descriptors)
-		{
-			auto offset = (chunk.gpu_start.ptr - m_base_gpu_start.ptr) / m_handle_size;
-			auto to_ret = DXDescriptorAllocation(chunk.cpu_start, chunk.gpu_start, m_handle_size, num_requested_descriptors, (uint32_t)offset);
-			m_free_chunks2.erase(it);
-			return to_ret;
-		}
-		else if (chunk.num_descriptors > num_requested_descriptors)
-		{
-			auto offset = (chunk.gpu_start.ptr - m_base_gpu_start.ptr) / m_handle_size;
-
-			// grab memory
-			auto to_ret = DXDescriptorAllocation(chunk.cpu_start, chunk.gpu_start, m_handle_size, num_requested_descriptors, (uint32_t)offset);
-
-			// move the free chunk
-			chunk.cpu_start.ptr += num_requested_descriptors * m_handle_size;
-			chunk.gpu_start.ptr += num_requested_descriptors * m_handle_size;
-			chunk.num_descriptors -= num_requested_descriptors;
-
-			return to_ret;
-		}
-		else
-			continue;
+		m_stats.on_failure();
+		return {};
 	}
 
-	return {};
+	D3D12_CPU_DESCRIPTOR_HANDLE cpu_hdl = m_cpu_start;
+	cpu_hdl.ptr += range.offset * m_handle_size;
+	D3D12_GPU_DESCRIPTOR_HANDLE gpu_hdl{};
+	if (m_gpu_visible)
+		gpu_hdl.ptr = m_gpu_start.ptr + range.offset * m_handle_size;
+
+	m_stats.on_allocate((uint64_t)num_requested_descriptors * m_handle_size, num_requested_descriptors);
+	return DXDescriptorAllocation(cpu_hdl, gpu_hdl, m_handle_size, num_requested_descriptors, m_offset_from_base + (uint32_t)range.offset, range.block);
 }
 
 void DXDescriptorPool::deallocate(DXDescriptorAllocation&& alloc)
 {
-	const auto alloc_gpu_start = alloc.gpu_handle().ptr;
-	const auto alloc_gpu_end = alloc.gpu_handle().ptr + alloc.num_descriptors() * m_handle_size;
-	if (m_free_chunks2.size() > 1)
-	{
-		for (auto it = m_free_chunks2.begin() + 1; it != m_free_chunks2.end(); ++it)
-		{
-			const auto left_chunk_it = std::next(it, -1);
-			const auto right_chunk_it = it;
-			auto& left_chunk = *left_chunk_it;
-			auto& right_chunk = *right_chunk_it;
-
-			const auto left_chunk_end = left_chunk.gpu_start.ptr + left_chunk.num_descriptors * m_handle_size;
-			const auto right_chunk_start = right_chunk.gpu_start.ptr;
-
-			const bool merge_left = alloc_gpu_start == left_chunk_end;
-			const bool merge_right = alloc_gpu_end == right_chunk_start;
-
-			if (merge_left && merge_right)
-			{
-				left_chunk.num_descriptors += alloc.num_descriptors() + right_chunk.num_descriptors;
-
-				// right merged with left
-				m_free_chunks2.erase(right_chunk_it);
-				//--m_used_indices;
-				break;
-			}
-			else if (merge_left)
-			{
-				left_chunk.num_descriptors += alloc.num_descriptors();
-				break;
-			}
-			else if (merge_right)
-			{
-				right_chunk.cpu_start = alloc.cpu_handle();
-				right_chunk.gpu_start = alloc.gpu_handle();
-				right_chunk.num_descriptors += alloc.num_descriptors();
-				break;
-			}
-			else
-			{
-				DescriptorChunk chunk{};
-				chunk.cpu_start = alloc.cpu_handle();
-				chunk.gpu_start = alloc.gpu_handle();
-				chunk.num_descriptors = alloc.num_descriptors();
-				m_free_chunks2.push_back(chunk);
-				//++m_used_indices;
-				break;
-			}
-
+	assert(alloc.owner_block() != TLSFAllocator::INVALID_BLOCK);
+	assert(alloc.cpu_handle().ptr >= m_cpu_start.ptr && alloc.cpu_handle().ptr < m_cpu_start.ptr + (uint64_t)m_max_descriptors * m_handle_size);
 
-		}
-	}
-	else if (m_free_chunks2.size() == 1)
-	{
-		auto it = m_free_chunks2.begin();
-		auto& chunk = *it;
-
-		bool merge_left = alloc_gpu_start == chunk.gpu_start.ptr + chunk.num_descriptors * m_handle_size;
-		bool merge_right = alloc_gpu_end == chunk.gpu_start.ptr;
-
-		bool adr_before = alloc.gpu_handle().ptr < chunk.gpu_start.ptr;
-
-		if (merge_left)
-		{
-			chunk.num_descriptors += alloc.num_descriptors();
-		}
-		else if (merge_right)
-		{
-			chunk.num_descriptors += alloc.num_descriptors();
-			chunk.cpu_start = alloc.cpu_handle();
-			chunk.gpu_start = alloc.gpu_handle();
-		}
-		else
-		{
-			DescriptorChunk disjoint_chunk{};
-			disjoint_chunk.cpu_start = alloc.cpu_handle();
-			disjoint_chunk.gpu_start = alloc.gpu_handle();
-			disjoint_chunk.num_descriptors = alloc.num_descriptors();
-
-			if (adr_before)
-			{
-				m_free_chunks2.push_back(std::move(m_free_chunks2[0]));
-				m_free_chunks2[0] = std::move(disjoint_chunk);
-			}
-			else
-				m_free_chunks2.push_back(disjoint_chunk);
-
-			//++m_used_indices;
-		}
-	}
-	else
-	{
-		DescriptorChunk chunk{};
-		chunk.cpu_start = alloc.cpu_handle();
-		chunk.gpu_start = alloc.gpu_handle();
-		chunk.num_descriptors = alloc.num_descriptors();
-		m_free_chunks2.push_back(chunk);
-		//++m_used_indices;
-	}
+	m_ator.deallocate(alloc.owner_block());
+	m_stats.on_deallocate((uint64_t)alloc.num_descriptors() * m_handle_size, alloc.num_descriptors());
 }
 
 ID3D12DescriptorHeap* DXDescriptorPool::get_desc_heap() const
 {
 	return m_desc_heap.Get();
 }
+
+AllocatorStats DXDescriptorPool::get_stats() const
+{
+	AllocatorStats stats = m_stats;
+	stats.largest_free_bytes = m_ator.get_report().largest_free * m_handle_size;
+	return stats;
+}
+
+TLSFAllocator::Report DXDescriptorPool::get_report() const
+{
+	return m_ator.get_report();
+}
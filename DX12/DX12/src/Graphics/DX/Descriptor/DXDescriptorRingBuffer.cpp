@@ -1,2 +1,79 @@
 #include "pch.h"
 #include "DXDescriptorRingBuffer.h"
+
+DXDescriptorRingBuffer::DXDescriptorRingBuffer(DXDescriptorAllocation&& alloc, uint32_t max_fif) :
+	m_cpu_start(alloc.cpu_handle()),
+	m_gpu_start(alloc.gpu_handle()),
+	m_offset_from_base(alloc.offset_from_base()),
+	m_handle_size(alloc.descriptor_size()),
+	m_capacity(alloc.num_descriptors())
+{
+	assert(max_fif > 0);
+	assert(m_capacity > 0);
+
+	m_frame_ends.resize(max_fif);
+	m_stats.capacity_bytes = (uint64_t)m_capacity * m_handle_size;
+}
+
+void DXDescriptorRingBuffer::frame_begin(uint32_t frame_idx)
+{
+	assert(frame_idx < m_frame_ends.size());
+
+	// the previous frame ends here
+	if (m_curr_frame != INVALID_FRAME)
+		m_frame_ends[m_curr_frame] = m_head;
+	m_curr_frame = frame_idx;
+
+	// the application has waited for the frame that last used this index, its stack is no longer in use
+	m_tail = (std::max)(m_tail, m_frame_ends[frame_idx]);
+
+	const auto in_use = m_head - m_tail;
+	m_stats.set_in_use(in_use * m_handle_size, in_use);
+}
+
+DXDescriptorAllocation DXDescriptorRingBuffer::allocate(uint32_t num_descriptors)
+{
+	assert(num_descriptors > 0);
+
+	// tables have to be contiguous, skip the remainder if the allocation would straddle the end
+	uint64_t start = m_head;
+	const uint64_t phys_start = start % m_capacity;
+	if (phys_start + num_descriptors > m_capacity)
+		start += m_capacity - phys_start;
+
+	// out of descriptors: the frames in flight use up the whole ring
+	if (start + num_descriptors - m_tail > m_capacity)
+	{
+		m_stats.on_failure();
+		return {};
+	}
+
+	m_head = start + num_descriptors;
+	++m_stats.total_allocations;
+	const auto in_use = m_head - m_tail;
+	m_stats.set_in_use(in_use * m_handle_size, in_use);
+
+	const uint32_t offset = (uint32_t)(start % m_capacity);
+	D3D12_CPU_DESCRIPTOR_HANDLE cpu_hdl{ m_cpu_start.ptr + (SIZE_T)offset * m_handle_size };
+	D3D12_GPU_DESCRIPTOR_HANDLE gpu_hdl{ m_gpu_start.ptr + (UINT64)offset * m_handle_size };
+	return DXDescriptorAllocation(cpu_hdl, gpu_hdl, m_handle_size, num_descriptors, m_offset_from_base + offset);
+}
+
+AllocatorStats DXDescriptorRingBuffer::get_stats() const
+{
+	AllocatorStats stats = m_stats;
+
+	// free space is contiguous unless it straddles the end of the range
+	const uint64_t used = m_head - m_tail;
+	uint64_t largest_free = 0;
+	if (used == 0)
+		largest_free = m_capacity;
+	else if (used < m_capacity)
+	{
+		const uint64_t head = m_head % m_capacity;
+		const uint64_t tail = m_tail % m_capacity;
+		largest_free = head > tail ? (std::max)(m_capacity - head, tail) : tail - head;
+	}
+	stats.largest_free_bytes = largest_free * m_handle_size;
+	return stats;
+}
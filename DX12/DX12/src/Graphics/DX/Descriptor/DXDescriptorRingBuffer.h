@@ -1,5 +1,7 @@
 #pragma once
 #include "DXDescriptorAllocation.h"
+#include "Profiler/AllocatorStats.h"
+#include <vector>
 
 /*
 	Designed to handle the dynamic part of a GPU descriptor heap.
@@ -12,19 +14,37 @@
 	A ring buffer element is in this case a 'frame'.
 	For each frame, a stack allocator exists.
 
+	The frame stacks are laid out one after another in the ring, so a frame can use as much of the ring as the others leave free.
+	Allocating is a bump of the head (tables are contiguous, the end of the range is skipped if a table would straddle it).
+	On frame_begin, the head is recorded as the end of the previous frame, and the stack of the frame that previously used
+	the same index is retired in one go (up to its recorded end). Descriptors must therefore only be allocated after frame_begin.
 */
 
 class DXDescriptorRingBuffer
 {
 public:
 	// steals existing allocation to manage it in a ring-buffer fashion
-	DXDescriptorRingBuffer(DXDescriptorAllocation&& alloc);
+	DXDescriptorRingBuffer(DXDescriptorAllocation&& alloc, uint32_t max_fif);
 	
 	void frame_begin(uint32_t frame_idx);
 	DXDescriptorAllocation allocate(uint32_t num_descriptors);
 
-private:
-
+	// Elements are descriptors, bytes in use include descriptors skipped on wrap-around
+	AllocatorStats get_stats() const;
 
+private:
+	D3D12_CPU_DESCRIPTOR_HANDLE m_cpu_start{};
+	D3D12_GPU_DESCRIPTOR_HANDLE m_gpu_start{};
+	uint32_t m_offset_from_base = 0;
+	uint32_t m_handle_size = 0;
+	uint32_t m_capacity = 0;
+
+	// Virtual offsets in descriptors, the physical offset being (virtual % capacity)
+	uint64_t m_head = 0;
+	uint64_t m_tail = 0;
+	static constexpr uint32_t INVALID_FRAME = ~0u;
+	std::vector<uint64_t> m_frame_ends;			// Head at the end of each frame in flight
+	uint32_t m_curr_frame = INVALID_FRAME;
+
+	AllocatorStats m_stats;
 };
-
@@ -0,0 +1,61 @@
+#include "pch.h"
+#include "DXDescriptorSlab.h"
+
+DXDescriptorSlab::DXDescriptorSlab(DXDescriptorHeapGPU* heap, Source source, uint32_t slab_size) :
+	m_heap(heap),
+	m_source(source),
+	m_slab_size(slab_size)
+{
+	assert(heap);
+	assert(slab_size > 0);
+}
+
+DXDescriptorAllocation DXDescriptorSlab::allocate(uint32_t num_descriptors)
+{
+	assert(num_descriptors > 0);
+
+	// heap exhausted
+	if (m_used + num_descriptors > m_slab.num_descriptors() && !refill(num_descriptors))
+		return {};
+
+	const uint32_t start = m_used;
+	m_used += num_descriptors;
+	return DXDescriptorAllocation(
+		m_slab.cpu_handle(start),
+		m_slab.gpu_handle(start),
+		m_slab.descriptor_size(),
+		num_descriptors,
+		m_slab.offset_from_base() + start);
+}
+
+void DXDescriptorSlab::reset()
+{
+	if (m_source == Source::eStatic)
+	{
+		for (auto& chunk : m_static_chunks)
+			m_heap->deallocate_static(std::move(chunk));
+		m_static_chunks.clear();
+	}
+
+	// dynamic slabs are retired by the heap along with their frame
+	m_slab = {};
+	m_used = 0;
+}
+
+bool DXDescriptorSlab::refill(uint32_t min_descriptors)
+{
+	const auto size = (std::max)(m_slab_size, min_descriptors);
+	auto slab = m_source == Source::eStatic ? m_heap->allocate_static(size) : m_heap->allocate_dynamic(size);
+	if (slab.num_descriptors() < min_descriptors)
+	{
+		assert(slab.num_descriptors() == 0);
+		return false;
+	}
+
+	// the remainder of the current slab is left unused
+	if (m_source == Source::eStatic)
+		m_static_chunks.push_back(slab);
+	m_slab = slab;
+	m_used = 0;
+	return true;
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include "DXDescriptorHeapGPU.h"
+#include <vector>
+
+/*
+	Thread-owned slab of descriptors carved from the static or dynamic part of a DXDescriptorHeapGPU.
+
+	Allocating from the slab is a pointer bump without any synchronization, so each recording thread should own its own slab.
+	When the slab runs out, a new one is grabbed from the heap in bulk (the only point where the heap lock is taken).
+
+	Dynamic slabs follow the rules of the dynamic part: allocations are only valid during the frame they are made in,
+	call reset() at the start of every frame to stop carving from the previous frame's slab.
+	Static slabs keep their chunks until reset(), which hands them back to the heap (the caller guarantees they are off flight).
+*/
+class DXDescriptorSlab
+{
+public:
+	enum class Source
+	{
+		eStatic,
+		eDynamic
+	};
+
+public:
+	DXDescriptorSlab(DXDescriptorHeapGPU* heap, Source source, uint32_t slab_size = 256);
+	~DXDescriptorSlab() = default;
+
+	// Empty allocation if the heap can't refill the slab
+	DXDescriptorAllocation allocate(uint32_t num_descriptors);
+	void reset();
+
+private:
+	// False if the heap is out of descriptors, the current slab is kept (its remainder still serves smaller requests)
+	bool refill(uint32_t min_descriptors);
+
+private:
+	DXDescriptorHeapGPU* m_heap = nullptr;
+	Source m_source = Source::eDynamic;
+	uint32_t m_slab_size = 0;
+
+	DXDescriptorAllocation m_slab;
+	uint32_t m_used = 0;
+
+	std::vector<DXDescriptorAllocation> m_static_chunks;
+};
@@ -0,0 +1,92 @@
+#include "pch.h"
+#include "DXDescriptorStager.h"
+#include <algorithm>
+
+DXDescriptorStager::DXDescriptorStager(cptr<ID3D12Device> dev, D3D12_DESCRIPTOR_HEAP_TYPE type, uint32_t block_size, uint32_t max_blocks) :
+	m_dev(dev),
+	m_type(type),
+	m_handle_size(dev->GetDescriptorHandleIncrementSize(type)),
+	m_block_size(block_size),
+	m_max_blocks(max_blocks),
+	m_staging_heap(dev, type)
+{
+	assert(block_size > 0 && max_blocks > 0);
+}
+
+DXDescriptorStager::~DXDescriptorStager()
+{
+	for (auto& block : m_blocks)
+		m_staging_heap.deallocate(std::move(block));
+}
+
+D3D12_CPU_DESCRIPTOR_HANDLE DXDescriptorStager::stage(D3D12_CPU_DESCRIPTOR_HANDLE dst)
+{
+	// move on to the next block
+	if (m_block_used == m_block_size || m_blocks.empty())
+	{
+		if (!m_blocks.empty())
+			++m_curr_block;
+		m_block_used = 0;
+
+		if (m_curr_block == m_max_blocks)
+			flush();
+		else if (m_curr_block == m_blocks.size())
+			m_blocks.push_back(m_staging_heap.allocate(m_block_size));
+	}
+
+	const auto src = m_blocks[m_curr_block].cpu_handle(m_block_used++);
+	m_writes.push_back({ dst.ptr, src.ptr });
+	return src;
+}
+
+uint32_t DXDescriptorStager::flush()
+{
+	if (!m_writes.empty())
+	{
+		// group by destination, on duplicates only the last write survives
+		std::stable_sort(m_writes.begin(), m_writes.end(), [](const StagedWrite& a, const StagedWrite& b) { return a.dst < b.dst; });
+		auto last = std::unique(m_writes.rbegin(), m_writes.rend(), [](const StagedWrite& a, const StagedWrite& b) { return a.dst == b.dst; });
+		m_writes.erase(m_writes.begin(), last.base());
+
+		m_dst_starts.clear();
+		m_dst_sizes.clear();
+		m_src_starts.clear();
+		m_src_sizes.clear();
+
+		// destination and source ranges are merged independently, only the total counts have to match
+		auto push_range = [this](std::vector<D3D12_CPU_DESCRIPTOR_HANDLE>& starts, std::vector<UINT>& sizes, SIZE_T ptr)
+		{
+			if (!starts.empty() && starts.back().ptr + (SIZE_T)sizes.back() * m_handle_size == ptr)
+			{
+				++sizes.back();
+				return;
+			}
+			starts.push_back({ ptr });
+			sizes.push_back(1);
+		};
+
+		for (const auto& write : m_writes)
+		{
+			push_range(m_dst_starts, m_dst_sizes, write.dst);
+			push_range(m_src_starts, m_src_sizes, write.src);
+		}
+
+		m_dev->CopyDescriptors(
+			(UINT)m_dst_starts.size(), m_dst_starts.data(), m_dst_sizes.data(),
+			(UINT)m_src_starts.size(), m_src_starts.data(), m_src_sizes.data(),
+			m_type);
+	}
+
+	// copies are done on the CPU timeline, staging is free again
+	const auto num_copied = (uint32_t)m_writes.size();
+	m_writes.clear();
+	m_curr_block = 0;
+	m_block_used = 0;
+
+	return num_copied;
+}
+
+uint32_t DXDescriptorStager::num_pending() const
+{
+	return (uint32_t)m_writes.size();
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include "DXDescriptorHeapCPU.h"
+#include <vector>
+
+/*
+	Stages descriptor writes in non-shader visible memory and copies them to their destination in bulk.
+
+	Shader visible heaps are write-combined, so views are created in CPU-only blocks (DXDescriptorHeapCPU) instead
+	and flush() moves them with a single CopyDescriptors call, destinations merged into contiguous ranges.
+	Call flush() once per frame before recording work that uses the destinations (e.g after bulk material/texture registration).
+
+	Staging blocks are kept and re-used between flushes, running out of blocks flushes early.
+*/
+class DXDescriptorStager
+{
+public:
+	DXDescriptorStager(cptr<ID3D12Device> dev, D3D12_DESCRIPTOR_HEAP_TYPE type, uint32_t block_size = 128, uint32_t max_blocks = 8);
+	~DXDescriptorStager();
+
+	// Returns a CPU-only descriptor to write the view into, it is copied to dst on flush (a later stage to the same dst wins)
+	D3D12_CPU_DESCRIPTOR_HANDLE stage(D3D12_CPU_DESCRIPTOR_HANDLE dst);
+
+	// Returns the number of descriptors copied
+	uint32_t flush();
+
+	uint32_t num_pending() const;
+
+private:
+	struct StagedWrite
+	{
+		SIZE_T dst = 0;
+		SIZE_T src = 0;
+	};
+
+private:
+	cptr<ID3D12Device> m_dev;
+	D3D12_DESCRIPTOR_HEAP_TYPE m_type;
+	uint32_t m_handle_size = 0;
+	uint32_t m_block_size = 0;
+	uint32_t m_max_blocks = 0;
+
+	DXDescriptorHeapCPU m_staging_heap;
+	std::vector<DXDescriptorAllocation> m_blocks;
+	uint32_t m_curr_block = 0;
+	uint32_t m_block_used = 0;
+
+	std::vector<StagedWrite> m_writes;
+
+	// Scratch for building the copy ranges
+	std::vector<D3D12_CPU_DESCRIPTOR_HANDLE> m_dst_starts, m_src_starts;
+	std::vector<UINT> m_dst_sizes, m_src_sizes;
+};
@@ -0,0 +1,169 @@
+#include "pch.h"
+#include "DXViewCache.h"
+#include <cstring>
+
+DXViewCache::DXViewCache(cptr<ID3D12Device> dev, DXDescriptorAllocation&& range, DXRetirementService* retirement, DXDescriptorStager* stager) :
+	m_dev(dev),
+	m_retirement(retirement),
+	m_stager(stager),
+	m_gpu_start(range.gpu_handle()),
+	m_cpu_start(range.cpu_handle()),
+	m_offset_from_base(range.offset_from_base()),
+	m_handle_size(range.descriptor_size())
+{
+	m_pool = std::make_unique<DXDescriptorPool>(dev, std::move(range), D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+}
+
+void DXViewCache::frame_begin()
+{
+	m_retired.release_completed(m_retirement->completed_fence_value(), [this](const RetiredView& record) { release(record); });
+}
+
+uint32_t DXViewCache::get_srv(ID3D12Resource* resource, const D3D12_SHADER_RESOURCE_VIEW_DESC& desc)
+{
+	// copy field by field into zeroed memory so that padding never takes part in the comparison
+	D3D12_SHADER_RESOURCE_VIEW_DESC key_desc;
+	std::memset(&key_desc, 0, sizeof(key_desc));
+	key_desc.Format = desc.Format;
+	key_desc.ViewDimension = desc.ViewDimension;
+	key_desc.Shader4ComponentMapping = desc.Shader4ComponentMapping;
+	std::memcpy(&key_desc.Buffer, &desc.Buffer, sizeof(desc.Buffer));		// whole union
+
+	ViewKey key{};
+	key.type = ViewType::eSRV;
+	key.resource = resource;
+	std::memcpy(key.desc, &key_desc, sizeof(key_desc));
+
+	return get_view(key, [&](D3D12_CPU_DESCRIPTOR_HANDLE descriptor) { m_dev->CreateShaderResourceView(resource, &desc, descriptor); });
+}
+
+uint32_t DXViewCache::get_cbv(const D3D12_CONSTANT_BUFFER_VIEW_DESC& desc)
+{
+	D3D12_CONSTANT_BUFFER_VIEW_DESC key_desc;
+	std::memset(&key_desc, 0, sizeof(key_desc));
+	key_desc.BufferLocation = desc.BufferLocation;
+	key_desc.SizeInBytes = desc.SizeInBytes;
+
+	ViewKey key{};
+	key.type = ViewType::eCBV;
+	std::memcpy(key.desc, &key_desc, sizeof(key_desc));
+
+	return get_view(key, [&](D3D12_CPU_DESCRIPTOR_HANDLE descriptor) { m_dev->CreateConstantBufferView(&desc, descriptor); });
+}
+
+template <typename CreateFunc>
+uint32_t DXViewCache::get_view(const ViewKey& key, CreateFunc&& create_view)
+{
+	auto it = m_key_to_index.find(key);
+	if (it != m_key_to_index.cend())
+	{
+		// may be waiting for retirement, the descriptor is still intact
+		auto& entry = m_entries[it->second];
+		if (entry.ref_count++ == 0)
+			++m_stats.views_in_use;
+		++m_stats.hits;
+		return it->second;
+	}
+
+	auto alloc = m_pool->allocate(1);
+	if (alloc.num_descriptors() == 0)
+	{
+		assert(false);		// out of descriptors
+		return INVALID_INDEX;
+	}
+
+	const auto index = alloc.offset_from_base() - m_offset_from_base;
+	create_view(m_stager ? m_stager->stage(alloc.cpu_handle()) : alloc.cpu_handle());
+
+	Entry entry{};
+	entry.alloc = std::move(alloc);
+	entry.key = key;
+	entry.resource = key.resource;
+	entry.ref_count = 1;
+	m_entries.insert({ index, std::move(entry) });
+	m_key_to_index.insert({ key, index });
+
+	++m_stats.misses;
+	++m_stats.views_in_use;
+	return index;
+}
+
+void DXViewCache::release(uint32_t index)
+{
+	auto it = m_entries.find(index);
+	assert(it != m_entries.end());
+	assert(it->second.ref_count > 0);
+
+	if (--it->second.ref_count > 0)
+		return;
+
+	--m_stats.views_in_use;
+	const auto fence_value = m_retirement->current_fence_value();
+	it->second.retire_fence_value = fence_value;
+	m_retired.retire(fence_value, { index, fence_value });
+}
+
+void DXViewCache::release(const RetiredView& record)
+{
+	// revived after being retired (possibly released again, in which case the latest record frees it)
+	auto it = m_entries.find(record.index);
+	if (it == m_entries.end() || it->second.ref_count > 0 || it->second.retire_fence_value != record.fence_value)
+		return;
+
+	m_key_to_index.erase(it->second.key);
+	m_pool->deallocate(std::move(it->second.alloc));
+	m_entries.erase(it);
+}
+
+D3D12_GPU_DESCRIPTOR_HANDLE DXViewCache::get_start() const
+{
+	return m_gpu_start;
+}
+
+D3D12_CPU_DESCRIPTOR_HANDLE DXViewCache::cpu_handle(uint32_t index) const
+{
+	D3D12_CPU_DESCRIPTOR_HANDLE hdl = m_cpu_start;
+	hdl.ptr += (uint64_t)index * m_handle_size;
+	return hdl;
+}
+
+D3D12_GPU_DESCRIPTOR_HANDLE DXViewCache::gpu_handle(uint32_t index) const
+{
+	D3D12_GPU_DESCRIPTOR_HANDLE hdl = m_gpu_start;
+	hdl.ptr += (uint64_t)index * m_handle_size;
+	return hdl;
+}
+
+const DXViewCache::Stats& DXViewCache::get_stats() const
+{
+	return m_stats;
+}
+
+AllocatorStats DXViewCache::get_allocator_stats() const
+{
+	return m_pool->get_stats();
+}
+
+bool DXViewCache::ViewKey::operator==(const ViewKey& other) const
+{
+	return type == other.type && resource == other.resource && std::memcmp(desc, other.desc, sizeof(desc)) == 0;
+}
+
+size_t DXViewCache::ViewKeyHasher::operator()(const ViewKey& key) const
+{
+	// FNV-1a
+	uint64_t hash = 14695981039346656037ull;
+	auto mix = [&hash](const void* data, size_t size)
+	{
+		const auto bytes = (const uint8_t*)data;
+		for (size_t i = 0; i < size; ++i)
+		{
+			hash ^= bytes[i];
+			hash *= 1099511628211ull;
+		}
+	};
+	mix(&key.type, sizeof(key.type));
+	mix(&key.resource, sizeof(key.resource));
+	mix(key.desc, sizeof(key.desc));
+	return (size_t)hash;
+}
@@ -0,0 +1,116 @@
+#pragma once
+#include "Graphics/DX/DXCommon.h"
+#include "Graphics/DX/DXRetirementService.h"
+
+#include "DXDescriptorPool.h"
+#include "DXDescriptorStager.h"
+#include "Utilities/RetirementQueue.h"
+
+#include <unordered_map>
+
+/*
+	Deduplicates CBV/SRV views over a range of shader visible descriptors.
+
+	Views are keyed on (resource, view desc): requesting a view which already exists returns the existing index and adds a reference,
+	so the same view is never written twice. Indices are relative to the start of the range (bindless table style).
+	When the last reference is released the descriptor is retired and only handed back to the pool once the GPU is past the current frame,
+	a view requested again before that is revived without rewriting it.
+	Views hold a reference to their resource until the descriptor is recycled.
+
+	With a stager, new views are written to CPU-only staging and only land in the range on the stager's flush.
+
+	View descs are compared bytewise (padding excluded), union bytes unused by the view dimension are expected to be zero ({} initialized).
+*/
+class DXViewCache
+{
+public:
+	static constexpr uint32_t INVALID_INDEX = ~0u;
+
+	struct Stats
+	{
+		uint64_t hits = 0;				// requests served by an existing view
+		uint64_t misses = 0;			// views written
+		uint32_t views_in_use = 0;
+	};
+
+public:
+	DXViewCache(cptr<ID3D12Device> dev, DXDescriptorAllocation&& range, DXRetirementService* retirement, DXDescriptorStager* stager = nullptr);
+	~DXViewCache() = default;
+
+	void frame_begin();
+
+	uint32_t get_srv(ID3D12Resource* resource, const D3D12_SHADER_RESOURCE_VIEW_DESC& desc);
+	uint32_t get_cbv(const D3D12_CONSTANT_BUFFER_VIEW_DESC& desc);
+
+	// Drops a reference to a view
+	void release(uint32_t index);
+
+	D3D12_GPU_DESCRIPTOR_HANDLE get_start() const;
+	D3D12_CPU_DESCRIPTOR_HANDLE cpu_handle(uint32_t index) const;
+	D3D12_GPU_DESCRIPTOR_HANDLE gpu_handle(uint32_t index) const;
+
+	const Stats& get_stats() const;
+	AllocatorStats get_allocator_stats() const;
+
+private:
+	enum class ViewType : uint8_t
+	{
+		eCBV,
+		eSRV
+	};
+
+	struct ViewKey
+	{
+		ViewType type = ViewType::eCBV;
+		ID3D12Resource* resource = nullptr;
+		uint8_t desc[sizeof(D3D12_SHADER_RESOURCE_VIEW_DESC)]{};		// largest of the supported descs
+
+		bool operator==(const ViewKey& other) const;
+	};
+
+	struct ViewKeyHasher
+	{
+		size_t operator()(const ViewKey& key) const;
+	};
+
+	struct Entry
+	{
+		DXDescriptorAllocation alloc;
+		ViewKey key;
+		cptr<ID3D12Resource> resource;			// held until the descriptor is recycled, so no new resource can take the key's address
+		uint32_t ref_count = 0;
+		uint64_t retire_fence_value = 0;		// latest retirement, earlier records are stale
+	};
+
+	struct RetiredView
+	{
+		uint32_t index = INVALID_INDEX;
+		uint64_t fence_value = 0;
+	};
+
+private:
+	// Returns the index of the cached view or writes a new one with create_view
+	template <typename CreateFunc>
+	uint32_t get_view(const ViewKey& key, CreateFunc&& create_view);
+
+	void release(const RetiredView& record);
+
+private:
+	cptr<ID3D12Device> m_dev;
+	uptr<DXDescriptorPool> m_pool;
+	DXRetirementService* m_retirement = nullptr;
+	DXDescriptorStager* m_stager = nullptr;
+
+	D3D12_GPU_DESCRIPTOR_HANDLE m_gpu_start{};
+	D3D12_CPU_DESCRIPTOR_HANDLE m_cpu_start{};
+	uint32_t m_offset_from_base = 0;
+	uint32_t m_handle_size = 0;
+
+	std::unordered_map<ViewKey, uint32_t, ViewKeyHasher> m_key_to_index;
+	std::unordered_map<uint32_t, Entry> m_entries;
+
+	RetirementQueue<RetiredView> m_retired;
+
+	Stats m_stats;
+};
+
@@ -1,9 +1,8 @@
 #include "pch.h"
 #include "MeshManager.h"
 
-MeshManager::MeshManager(cptr<ID3D12Device> dev, DXBufferManager* buf_mgr, uint32_t max_FIF) :
-	m_buf_mgr(buf_mgr),
-	m_max_FIF(max_FIF)
+MeshManager::MeshManager(cptr<ID3D12Device> dev, DXBufferManager* buf_mgr) :
+	m_buf_mgr(buf_mgr)
 {
 
 	auto hr = dev.As(&m_dxr_dev);
@@ -84,14 +83,9 @@ const Mesh* MeshManager::get_mesh(MeshHandle handle)
 
 void MeshManager::create_RT_accel_structure_v3(const std::vector<RTMeshDesc>& descs, RTBuildSetting setting, UINT submesh_per_BLAS)
 {
-	if (m_frames_until_del > 0)		// forbid recreation for a bit to simplify resource handling
-		return;
-
+	// buffers are retired by the buffer manager until the GPU is done with them, so the old structure can be dropped right away
 	if (m_tlas_element)
-	{
-		m_tlas_to_delete = std::move(m_tlas_element);
-		m_frames_until_del = m_max_FIF;			// wait until full loop to guarantee all res off flight before clearing the GPU mem
-	}
+		m_tlas_element->clear_resources(m_buf_mgr);
 
 	m_tlas_element = std::make_unique<TLASElement>();
 
@@ -380,13 +374,4 @@ const MeshManager::RTSceneData* MeshManager::get_RT_scene_data()
 
 void MeshManager::frame_begin(uint32_t frame_idx)
 {
-	if (m_frames_until_del > 0)
-	{
-		--m_frames_until_del;
-		if (m_frames_until_del == 0)
-		{
-			m_tlas_to_delete->clear_resources(m_buf_mgr);
-			m_tlas_to_delete.reset();
-		}
-	}
 }
@@ -79,7 +79,7 @@ public:
 	};
 
 public:
-	MeshManager(cptr<ID3D12Device> dev, DXBufferManager* buf_mgr, uint32_t max_FIF);
+	MeshManager(cptr<ID3D12Device> dev, DXBufferManager* buf_mgr);
 	~MeshManager() = default;
 
 	MeshHandle create_mesh(const MeshDesc& desc);
@@ -101,11 +101,6 @@ private:
 	DXBufferManager* m_buf_mgr = nullptr;
 
 
-	uint64_t m_frames_until_del = 0;
-
-	uint32_t m_max_FIF;
-
-
 	RTAccelStructure m_rt_bufs;
 	RTSceneData m_rt_scene;
 
@@ -151,6 +146,5 @@ private:
 	};
 
 	std::unique_ptr<TLASElement> m_tlas_element;
-	std::unique_ptr<TLASElement> m_tlas_to_delete;
 };
 
@@ -2,11 +2,31 @@
 #include "ModelManager.h"
 
 #include "Utilities/AssimpLoader.h"
+#include "Utilities/MeshCache.h"
+#include "Utilities/Stopwatch.h"
 
-ModelManager::ModelManager(MeshManager* mesh_mgr, DXTextureManager* tex_mgr, DXBindlessManager* bindless_mgr) :
+namespace
+{
+	MeshCacheContents get_contents(AssimpLoader& loader)
+	{
+		MeshCacheContents contents{};
+		contents.positions = utils::MemBlob((void*)loader.get_positions().data(), loader.get_positions().size(), sizeof(loader.get_positions()[0]));
+		contents.uvs = utils::MemBlob((void*)loader.get_uvs().data(), loader.get_uvs().size(), sizeof(loader.get_uvs()[0]));
+		contents.normals = utils::MemBlob((void*)loader.get_normals().data(), loader.get_normals().size(), sizeof(loader.get_normals()[0]));
+		contents.tangents = utils::MemBlob((void*)loader.get_tangents().data(), loader.get_tangents().size(), sizeof(loader.get_tangents()[0]));
+		contents.bitangents = utils::MemBlob((void*)loader.get_bitangents().data(), loader.get_bitangents().size(), sizeof(loader.get_bitangents()[0]));
+		contents.indices = utils::MemBlob((void*)loader.get_indices().data(), loader.get_indices().size(), sizeof(loader.get_indices()[0]));
+		contents.meshes = loader.get_meshes();
+		contents.materials = loader.get_materials();
+		return contents;
+	}
+}
+
+ModelManager::ModelManager(MeshManager* mesh_mgr, DXTextureManager* tex_mgr, DXBindlessManager* bindless_mgr, ThreadPool* workers) :
 	m_mesh_mgr(mesh_mgr),
 	m_tex_mgr(tex_mgr),
-	m_bindless_mgr(bindless_mgr)
+	m_bindless_mgr(bindless_mgr),
+	m_workers(workers)
 {
 }
 
@@ -14,55 +34,75 @@ ModelHandle ModelManager::load_model(const ModelDesc& desc)
 {
 	auto [handle, res] = m_handles.get_next_free_handle();
 
-	AssimpLoader loader(desc.rel_path);
+	ModelLoadStats stats{};
+	stats.rel_path = desc.rel_path;
+	Stopwatch load_time;
+	load_time.start();
+
+	// Imported data comes from the mesh cache, Assimp only runs on a cold start or a changed source
+	const auto source_hash = MeshCache::hash_source(desc.rel_path);
+	const auto cache_path = MeshCache::get_cache_path(desc.rel_path, source_hash);
+	MeshCache cache;
+	uptr<AssimpLoader> loader;
+	MeshCacheContents imported{};
+	stats.from_cache = cache.open(cache_path, source_hash);
+	if (!stats.from_cache)
+	{
+		loader = std::make_unique<AssimpLoader>(desc.rel_path, m_workers);
+		imported = get_contents(*loader);
+
+		const auto& timings = loader->get_timings();
+		stats.import_ms = timings.import_ms;
+		stats.extract_ms = timings.extract_ms;
+		stats.extract_threads = timings.extract_threads;
+
+		// read back through the mapping like a warm start, the loader is only kept if the cache can't be written
+		if (MeshCache::write(cache_path, source_hash, imported) && cache.open(cache_path, source_hash))
+		{
+			loader.reset();
+			MeshCache::remove_superseded(desc.rel_path, cache_path);
+		}
+	}
+	const MeshCacheContents& contents = loader ? imported : cache.get_contents();
+
+	load_time.stop();
+	stats.total_ms = load_time.elapsed(Stopwatch::Unit::eMillisecond);
+	m_load_stats.push_back(stats);
 
 	// Load mesh
 	{
 		MeshDesc md{};
-		md.pos = utils::MemBlob(
-			(void*)loader.get_positions().data(),
-			loader.get_positions().size(),
-			sizeof(loader.get_positions()[0]));
-
-		md.uv = utils::MemBlob(
-			(void*)loader.get_uvs().data(),
-			loader.get_uvs().size(),
-			sizeof(loader.get_uvs()[0]));
-
-		md.indices = utils::MemBlob(
-			(void*)loader.get_indices().data(),
-			loader.get_indices().size(),
-			sizeof(loader.get_indices()[0]));
-
-		md.normals = utils::MemBlob(
-			(void*)loader.get_normals().data(),
-			loader.get_normals().size(),
-			sizeof(loader.get_normals()[0]));
-
-		md.tangents = utils::MemBlob(
-			(void*)loader.get_tangents().data(),
-			loader.get_tangents().size(),
-			sizeof(loader.get_tangents()[0]));
-
-		md.bitangents = utils::MemBlob(
-			(void*)loader.get_bitangents().data(),
-			loader.get_bitangents().size(),
-			sizeof(loader.get_bitangents()[0]));
-
-		for (const auto& loaded_part : loader.get_meshes())
+		md.pos = contents.positions;
+		md.uv = contents.uvs;
+		md.indices = contents.indices;
+		md.normals = contents.normals;
+		md.tangents = contents.tangents;
+		md.bitangents = contents.bitangents;
+
+		const auto& loaded_parts = contents.meshes;
+		for (size_t i = 0; i < loaded_parts.size(); ++i)
 		{
+			const auto& loaded_part = loaded_parts[i];
 			MeshPart part{};
 			part.index_count = loaded_part.index_count;
 			part.index_start = loaded_part.index_start;
 			part.vertex_start = loaded_part.vertex_start;
 			md.subsets.push_back(part);
+
+			// parts own contiguous vertex ranges
+			const size_t vertex_end = i + 1 < loaded_parts.size() ? loaded_parts[i + 1].vertex_start : contents.positions.count;
+			DirectX::BoundingSphere bounds;
+			DirectX::BoundingSphere::CreateFromPoints(bounds, vertex_end - loaded_part.vertex_start,
+				(const DirectX::XMFLOAT3*)((const uint8_t*)contents.positions.data + (size_t)loaded_part.vertex_start * contents.positions.stride),
+				contents.positions.stride);
+			res->part_bounds.push_back(bounds);
 		}
 		res->mesh = m_mesh_mgr->create_mesh(md);
 	}
 
 	// Load Bindless Element
 	{
-		const auto& loaded_mats = loader.get_materials();
+		const auto& loaded_mats = contents.materials;
 		for (const auto& loaded_mat : loaded_mats)
 		{
 			// load textures
@@ -79,19 +119,19 @@ ModelHandle ModelManager::load_model(const ModelDesc& desc)
 			td.flag = TextureFlag::eSRGB;
 			td.usage_cpu = UsageIntentCPU::eUpdateNever;
 			td.usage_gpu = UsageIntentGPU::eReadMultipleTimesPerFrame;
-			auto diffuse = m_tex_mgr->create_texture(td);
+			auto diffuse = m_tex_mgr->create_texture_async(td);
 
 			td.flag = TextureFlag::eNonSRGB;
 			td.filepath = paths.normal;
-			auto normal = m_tex_mgr->create_texture(td);
+			auto normal = m_tex_mgr->create_texture_async(td);
 
 			td.flag = TextureFlag::eNonSRGB;
 			td.filepath = paths.specular;
-			auto specular = m_tex_mgr->create_texture(td);
+			auto specular = m_tex_mgr->create_texture_async(td);
 
 			td.flag = TextureFlag::eNonSRGB;
 			td.filepath = paths.opacity;
-			auto opacity = m_tex_mgr->create_texture(td);
+			auto opacity = m_tex_mgr->create_texture_async(td);
 
 			// tex handles lost after this, we simply dont handle it since we are not handling dynamic removal
 			// internal textures are cleaned up upon destruction
@@ -105,6 +145,7 @@ ModelHandle ModelManager::load_model(const ModelDesc& desc)
 
 			Material mat{};
 			mat.resource = m_bindless_mgr->create_bindless(bd);
+			mat.textures = bd;
 			mat.pso = desc.pso;
 			res->mats.push_back(mat);
 		}
@@ -122,3 +163,8 @@ const Model* ModelManager::get_model(ModelHandle handle)
 {
 	return m_handles.get_resource(handle.handle);
 }
+
+const std::vector<ModelLoadStats>& ModelManager::get_load_stats() const
+{
+	return m_load_stats;
+}
@@ -3,17 +3,20 @@
 #include "Graphics/MeshManager.h"
 #include "DX/DXTextureManager.h"
 #include "DX/DXBindlessManager.h"
+#include <DirectXCollision.h>
 
 struct Material
 {
 	cptr<ID3D12PipelineState> pso;
 	BindlessHandle resource;
+	DXBindlessDesc textures;
 };
 
 struct Model
 {
 	MeshHandle mesh;
 	std::vector<Material> mats;
+	std::vector<DirectX::BoundingSphere> part_bounds;		// object space, per mesh part
 
 	uint64_t handle = 0;
 	void destroy() { };
@@ -35,10 +38,23 @@ private:
 	uint64_t handle = 0;
 };
 
+// Where the mesh data of a model came from and how long it took (mesh data only, textures load asynchronously)
+struct ModelLoadStats
+{
+	std::filesystem::path rel_path;
+	bool from_cache = false;
+	double total_ms = 0.0;			// hashing the source, import or cache read, cache write
+
+	// Assimp, on a cache miss
+	double import_ms = 0.0;			// ReadFile and its post-processing, serial
+	double extract_ms = 0.0;		// copying the scene into the streams, parallel across meshes
+	uint32_t extract_threads = 1;
+};
+
 class ModelManager
 {
 public:
-	ModelManager(MeshManager* mesh_mgr, DXTextureManager* tex_mgr, DXBindlessManager* bindless_mgr);
+	ModelManager(MeshManager* mesh_mgr, DXTextureManager* tex_mgr, DXBindlessManager* bindless_mgr, ThreadPool* workers = nullptr);
 	~ModelManager() = default;
 
 	// Rasterized model
@@ -46,6 +62,8 @@ public:
 	void destroy_model(ModelHandle handle);
 	const Model* get_model(ModelHandle handle);
 
+	const std::vector<ModelLoadStats>& get_load_stats() const;
+
 
 private:
 	HandlePool<Model> m_handles;
@@ -53,6 +71,9 @@ private:
 	MeshManager* m_mesh_mgr = nullptr;
 	DXTextureManager* m_tex_mgr = nullptr;
 	DXBindlessManager* m_bindless_mgr = nullptr;
+	ThreadPool* m_workers = nullptr;
+
+	std::vector<ModelLoadStats> m_load_stats;
 
 
 };
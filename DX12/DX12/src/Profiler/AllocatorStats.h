@@ -0,0 +1,41 @@
+#pragma once
+#include <stdint.h>
+#include <string>
+#include <utility>
+
+/*
+	Uniform usage statistics reported by the buffer and descriptor allocators.
+
+	Elements are in the allocators own unit (pool elements, allocations or descriptors).
+	Allocation counts are cumulative, per frame rates are derived by AllocatorTelemetry when sampling.
+*/
+struct AllocatorStats
+{
+	uint64_t capacity_bytes = 0;
+	uint64_t bytes_in_use = 0;
+	uint64_t bytes_high_water = 0;
+	uint64_t elements_in_use = 0;
+	uint64_t elements_high_water = 0;
+	uint64_t largest_free_bytes = 0;			// Largest contiguous free block (filled on query)
+	uint64_t total_allocations = 0;
+	uint64_t allocation_failures = 0;
+
+	uint64_t free_bytes() const { return capacity_bytes > bytes_in_use ? capacity_bytes - bytes_in_use : 0; }
+
+	// 0 if all free memory is in one contiguous block, approaching 1 the more scattered the free memory is
+	float fragmentation() const { return free_bytes() == 0 ? 0.f : 1.f - (float)((double)largest_free_bytes / (double)free_bytes()); }
+
+	void set_in_use(uint64_t bytes, uint64_t elements)
+	{
+		bytes_in_use = bytes;
+		elements_in_use = elements;
+		bytes_high_water = bytes > bytes_high_water ? bytes : bytes_high_water;
+		elements_high_water = elements > elements_high_water ? elements : elements_high_water;
+	}
+
+	void on_allocate(uint64_t bytes, uint64_t elements = 1) { set_in_use(bytes_in_use + bytes, elements_in_use + elements); ++total_allocations; }
+	void on_deallocate(uint64_t bytes, uint64_t elements = 1) { set_in_use(bytes_in_use - bytes, elements_in_use - elements); }
+	void on_failure() { ++allocation_failures; }
+};
+
+using NamedAllocatorStats = std::pair<std::string, AllocatorStats>;
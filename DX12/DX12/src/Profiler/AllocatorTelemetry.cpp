@@ -0,0 +1,85 @@
+#include "pch.h"
+#include "AllocatorTelemetry.h"
+#include <algorithm>
+
+void AllocatorTelemetry::add_source(const std::string& group, Source source)
+{
+	m_sources.push_back({ group, std::move(source) });
+}
+
+void AllocatorTelemetry::frame_end()
+{
+	++m_frames;
+
+	for (const auto& [group, source] : m_sources)
+	{
+		for (const auto& [name, stats] : source())
+		{
+			const auto full_name = group + "/" + name;
+
+			auto it = m_name_to_entry.find(full_name);
+			if (it == m_name_to_entry.cend())
+			{
+				// first sample only sets the baseline
+				Entry entry{};
+				entry.name = full_name;
+				entry.stats = stats;
+				m_name_to_entry.insert({ full_name, m_entries.size() });
+				m_entries.push_back(std::move(entry));
+				continue;
+			}
+
+			auto& entry = m_entries[it->second];
+			entry.allocs_last_frame = stats.total_allocations - entry.stats.total_allocations;
+			entry.allocs_peak_frame = (std::max)(entry.allocs_peak_frame, entry.allocs_last_frame);
+			++entry.frames_sampled;
+			entry.allocs_avg_frame += ((double)entry.allocs_last_frame - entry.allocs_avg_frame) / (double)entry.frames_sampled;
+			entry.stats = stats;
+		}
+	}
+}
+
+const AllocatorTelemetry::Entry* AllocatorTelemetry::find(const std::string& name) const
+{
+	auto it = m_name_to_entry.find(name);
+	if (it == m_name_to_entry.cend())
+		return nullptr;
+	return &m_entries[it->second];
+}
+
+void AllocatorTelemetry::dump_json(const std::filesystem::path& path) const
+{
+	std::ofstream file(path);
+	if (!file.is_open())
+	{
+		assert(false);
+		return;
+	}
+
+	file << "{\n";
+	file << fmt::format("\t\"frames\": {},\n", m_frames);
+	file << "\t\"allocators\": [\n";
+	for (size_t i = 0; i < m_entries.size(); ++i)
+	{
+		const auto& entry = m_entries[i];
+		const auto& stats = entry.stats;
+
+		file << "\t\t{\n";
+		file << fmt::format("\t\t\t\"name\": \"{}\",\n", entry.name);
+		file << fmt::format("\t\t\t\"capacity_bytes\": {},\n", stats.capacity_bytes);
+		file << fmt::format("\t\t\t\"bytes_in_use\": {},\n", stats.bytes_in_use);
+		file << fmt::format("\t\t\t\"bytes_high_water\": {},\n", stats.bytes_high_water);
+		file << fmt::format("\t\t\t\"elements_in_use\": {},\n", stats.elements_in_use);
+		file << fmt::format("\t\t\t\"elements_high_water\": {},\n", stats.elements_high_water);
+		file << fmt::format("\t\t\t\"largest_free_bytes\": {},\n", stats.largest_free_bytes);
+		file << fmt::format("\t\t\t\"fragmentation\": {:.4f},\n", stats.fragmentation());
+		file << fmt::format("\t\t\t\"total_allocations\": {},\n", stats.total_allocations);
+		file << fmt::format("\t\t\t\"allocation_failures\": {},\n", stats.allocation_failures);
+		file << fmt::format("\t\t\t\"allocs_last_frame\": {},\n", entry.allocs_last_frame);
+		file << fmt::format("\t\t\t\"allocs_avg_frame\": {:.2f},\n", entry.allocs_avg_frame);
+		file << fmt::format("\t\t\t\"allocs_peak_frame\": {}\n", entry.allocs_peak_frame);
+		file << (i + 1 < m_entries.size() ? "\t\t},\n" : "\t\t}\n");
+	}
+	file << "\t]\n";
+	file << "}\n";
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include "AllocatorStats.h"
+#include <vector>
+#include <functional>
+#include <unordered_map>
+#include <filesystem>
+
+/*
+	Collects AllocatorStats from registered sources once per frame.
+
+	Derives allocations per frame (last/average/peak) from the cumulative allocation counts.
+	Results can be queried by name ("<group>/<allocator>"), drawn by the application and dumped to JSON (e.g at shutdown to size pools from real data).
+*/
+class AllocatorTelemetry
+{
+public:
+	using Source = std::function<std::vector<NamedAllocatorStats>()>;
+
+	struct Entry
+	{
+		std::string name;
+		AllocatorStats stats;
+
+		uint64_t allocs_last_frame = 0;
+		uint64_t allocs_peak_frame = 0;
+		double allocs_avg_frame = 0.0;
+
+	private:
+		friend class AllocatorTelemetry;
+		uint64_t frames_sampled = 0;
+	};
+
+public:
+	AllocatorTelemetry() = default;
+	~AllocatorTelemetry() = default;
+
+	void add_source(const std::string& group, Source source);
+
+	// Samples all sources
+	void frame_end();
+
+	const std::vector<Entry>& get_entries() const { return m_entries; }
+	const Entry* find(const std::string& name) const;
+
+	void dump_json(const std::filesystem::path& path) const;
+
+private:
+	std::vector<std::pair<std::string, Source>> m_sources;
+
+	std::vector<Entry> m_entries;
+	std::unordered_map<std::string, size_t> m_name_to_entry;
+	uint64_t m_frames = 0;
+};
@@ -1,13 +1,18 @@
 #include "pch.h"
 #include "AssimpLoader.h"
 #include "DXTK/SimpleMath.h"
+#include "Stopwatch.h"
+#include <algorithm>
+#include <atomic>
 
 using namespace DirectX::SimpleMath;
 
-AssimpLoader::AssimpLoader(const std::filesystem::path& fpath) :
+AssimpLoader::AssimpLoader(const std::filesystem::path& fpath, ThreadPool* workers) :
 	m_directory(std::filesystem::path(fpath.parent_path().string() + "/"))
 {
-	// Load assimp scene
+	// Load assimp scene (serial, the post-processing below dominates the load)
+	Stopwatch import_time;
+	import_time.start();
 	Assimp::Importer importer;
 	const aiScene* scene = importer.ReadFile(
 		fpath.relative_path().string().c_str(),
@@ -28,25 +33,85 @@ AssimpLoader::AssimpLoader(const std::filesystem::path& fpath) :
 
 	if (!scene)
 		assert(false);
+	import_time.stop();
+	m_timings.import_ms = import_time.elapsed(Stopwatch::Unit::eMillisecond);
 
-	// Get total amount of vertices and pre-allocate memory
-	unsigned int total_verts = 0;
-	for (unsigned int i = 0; i < scene->mNumMeshes; ++i)
-		total_verts += scene->mMeshes[i]->mNumVertices;
-
-	m_positions.reserve(total_verts);
-	m_uvs.reserve(total_verts);
-	m_normals.reserve(total_verts);
-	m_indices.reserve(total_verts);
-	m_tangents.reserve(total_verts);
-	m_bitangents.reserve(total_verts);
+	Stopwatch extract_time;
+	extract_time.start();
+
+	// First pass: lay out every mesh in the joint buffers
+	std::vector<const aiMesh*> meshes;
+	meshes.reserve(scene->mNumMeshes);
 	m_meshes.reserve(scene->mNumMeshes);
+	m_materials.reserve(scene->mNumMeshes);
+	process_node(scene->mRootNode, scene, meshes);
+
+	size_t total_verts = 0;
+	size_t total_indices = 0;
+	if (!meshes.empty())
+	{
+		total_verts = m_meshes.back().vertex_start + meshes.back()->mNumVertices;
+		total_indices = m_meshes.back().index_start + m_meshes.back().index_count;
+	}
+
+	// Zero initialized, meshes without some stream keep the streams aligned
+	m_positions.resize(total_verts);
+	m_uvs.resize(total_verts);
+	m_normals.resize(total_verts);
+	m_tangents.resize(total_verts);
+	m_bitangents.resize(total_verts);
+	m_indices.resize(total_indices);
+
+	// Second pass: fill the ranges
+	extract_meshes(meshes, workers);
+
+	extract_time.stop();
+	m_timings.extract_ms = extract_time.elapsed(Stopwatch::Unit::eMillisecond);
+}
+
+void AssimpLoader::extract_meshes(const std::vector<const aiMesh*>& meshes, ThreadPool* workers)
+{
+	if (!workers || meshes.size() < 2)
+	{
+		for (size_t i = 0; i < meshes.size(); ++i)
+			process_mesh(meshes[i], m_meshes[i]);
+		return;
+	}
 
-	// Reserve memory for materials
-	m_materials.reserve(scene->mNumMaterials);
+	// Shared with the jobs: one that starts after every mesh is taken only touches this
+	struct Extraction
+	{
+		size_t count = 0;
+		std::atomic<size_t> next{ 0 };
+		std::atomic<size_t> done{ 0 };
+		std::mutex mutex;
+		std::condition_variable all_done;
+	};
+	auto extraction = std::make_shared<Extraction>();
+	extraction->count = meshes.size();
+
+	auto extract = [this, extraction, meshes = meshes.data()]()
+	{
+		for (size_t i = extraction->next++; i < extraction->count; i = extraction->next++)
+		{
+			process_mesh(meshes[i], m_meshes[i]);
+			if (++extraction->done == extraction->count)
+			{
+				std::lock_guard<std::mutex> lock(extraction->mutex);
+				extraction->all_done.notify_one();
+			}
+		}
+	};
 
-	// Start processing scene
-	process_node(scene->mRootNode, scene);
+	// Meshes are taken one at a time so large ones don't leave a worker behind, the loading thread helps out
+	const size_t num_jobs = (std::min)((size_t)workers->num_threads(), meshes.size() - 1);
+	m_timings.extract_threads = (uint32_t)num_jobs + 1;
+	for (size_t i = 0; i < num_jobs; ++i)
+		workers->submit(extract);
+	extract();
+
+	std::unique_lock<std::mutex> lock(extraction->mutex);
+	extraction->all_done.wait(lock, [&extraction]() { return extraction->done == extraction->count; });
 }
 
 void AssimpLoader::process_material(aiMaterial* material, const aiScene* scene)
@@ -86,75 +151,74 @@ void AssimpLoader::process_material(aiMaterial* material, const aiScene* scene)
 	m_materials.push_back(data);
 }
 
-void AssimpLoader::process_mesh(aiMesh* mesh, const aiScene* scene)
+void AssimpLoader::process_mesh(const aiMesh* mesh, const AssimpMeshData& range)
 {
 	/*
 		Get all the the relevant vertex data from this mesh
 	*/
-	UINT vertex_start = (UINT)m_positions.size();
-	for (unsigned int i = 0; i < mesh->mNumVertices; ++i)
-	{
-		m_positions.push_back(mesh->mVertices[i]);
-		m_normals.push_back(mesh->mNormals[i]);
+	const unsigned int num_verts = mesh->mNumVertices;
+	std::copy_n(mesh->mVertices, num_verts, m_positions.data() + range.vertex_start);
 
-		if (mesh->mTextureCoords[0])
-			m_uvs.push_back({ mesh->mTextureCoords[0][i].x, mesh->mTextureCoords[0][i].y });
+	if (mesh->mNormals)
+		std::copy_n(mesh->mNormals, num_verts, m_normals.data() + range.vertex_start);
 
-		if (mesh->mTangents)
-			m_tangents.push_back(mesh->mTangents[i]);
-
-		if (mesh->mBitangents)
-			m_bitangents.push_back(mesh->mBitangents[i]);
+	if (mesh->mTextureCoords[0])
+	{
+		auto uvs = m_uvs.data() + range.vertex_start;
+		for (unsigned int i = 0; i < num_verts; ++i)
+			uvs[i] = { mesh->mTextureCoords[0][i].x, mesh->mTextureCoords[0][i].y };
 	}
 
-	/*
-		Save where this mesh starts in the index buffer
-	*/
-	//size_t index_start = (std::max)((int64_t)m_indices.size() - 1, (int64_t)0);
-	auto index_start = (UINT)m_indices.size();
+	if (mesh->mTangents)
+		std::copy_n(mesh->mTangents, num_verts, m_tangents.data() + range.vertex_start);
+
+	if (mesh->mBitangents)
+		std::copy_n(mesh->mBitangents, num_verts, m_bitangents.data() + range.vertex_start);
 
 	/*
-		Go over this meshes faces and extract indices.
+		Go over this meshes faces and copy their indices.
 		If triangulation is enabled, each face should have 3 vertices.
 	*/
-	unsigned int index_count = 0;
+	auto indices = m_indices.data() + range.index_start;
 	for (unsigned int i = 0; i < mesh->mNumFaces; ++i)
-	{
-		aiFace face = mesh->mFaces[i];
-		for (unsigned int j = 0; j < face.mNumIndices; ++j)
-		{
-			m_indices.push_back(face.mIndices[j]);
-			++index_count;
-		}
-	}
-
-	AssimpMeshData amd;
-	amd.index_start = index_start;
-	amd.index_count = index_count;
-
-	/*
-		Indices are local to the mesh!
-		Thus requiring the offset to this mesh in the joint vertex buffer
-	*/
-	amd.vertex_start = vertex_start;
-	m_meshes.push_back(amd);
+		indices = std::copy_n(mesh->mFaces[i].mIndices, mesh->mFaces[i].mNumIndices, indices);
 }
 
-void AssimpLoader::process_node(aiNode* node, const aiScene* scene)
+void AssimpLoader::process_node(aiNode* node, const aiScene* scene, std::vector<const aiMesh*>& meshes)
 {
 	// Process all meshes in this node
 	for (unsigned int i = 0; i < node->mNumMeshes; ++i)
 	{
-		aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
+		const aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
 
 		// Get material for this mesh
 		aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
 
-		process_mesh(mesh, scene);
+		/*
+			Ranges follow the previous mesh.
+			Indices are local to the mesh!
+			Thus requiring the offset to this mesh in the joint vertex buffer
+		*/
+		AssimpMeshData amd;
+		if (!meshes.empty())
+		{
+			amd.vertex_start = m_meshes.back().vertex_start + meshes.back()->mNumVertices;
+			amd.index_start = m_meshes.back().index_start + m_meshes.back().index_count;
+		}
+
+		// triangulated meshes only have triangles, anything else counts face by face
+		if (mesh->mPrimitiveTypes == aiPrimitiveType_TRIANGLE)
+			amd.index_count = mesh->mNumFaces * 3;
+		else
+			for (unsigned int face = 0; face < mesh->mNumFaces; ++face)
+				amd.index_count += mesh->mFaces[face].mNumIndices;
+
+		meshes.push_back(mesh);
+		m_meshes.push_back(amd);
 		process_material(material, scene);
 	}
 
 	// Recursively process all child nodes and process meshes in them.
 	for (unsigned int i = 0; i < node->mNumChildren; ++i)
-		process_node(node->mChildren[i], scene);
+		process_node(node->mChildren[i], scene, meshes);
 }
@@ -1,5 +1,6 @@
 #pragma once
 #include "AssimpTypes.h"
+#include "ThreadPool.h"
 
 /*
 	NOMINMAX preprocessor definition has to be set. windows.h min clashes with C++ headers
@@ -11,15 +12,27 @@
 
 class AssimpLoader
 {
-private:
+public:
+	/*
+		Import is ReadFile with its post-processing (joining vertices, tangents, cache optimization), serial within Assimp.
+		Extraction is copying the scene into the streams, parallel across meshes.
+	*/
+	struct Timings
+	{
+		double import_ms = 0.0;
+		double extract_ms = 0.0;
+		uint32_t extract_threads = 1;
+	};
 
 public:
 	AssimpLoader() = delete;
-	AssimpLoader(const std::filesystem::path& fpath);
+	// Meshes are extracted in parallel on workers if given
+	AssimpLoader(const std::filesystem::path& fpath, ThreadPool* workers = nullptr);
 
 	/*
 		Vertex data are returned in non-interleaved form
 		Packing to interleaved form is up to the end user
+		Every stream has an element per vertex, missing uvs/tangents/bitangents are zero
 	*/
 	const std::vector<aiVector3D>& get_positions() { return m_positions; }
 	const std::vector<aiVector2D>& get_uvs() { return m_uvs; }
@@ -32,10 +45,17 @@ public:
 	const std::vector<AssimpMeshData>& get_meshes() { return m_meshes; }
 	const std::vector<AssimpMaterialData>& get_materials() { return m_materials; }
 
+	const Timings& get_timings() const { return m_timings; }
+
 private:
 	void process_material(aiMaterial* material, const aiScene* scene);
-	void process_mesh(aiMesh* mesh, const aiScene* scene);
-	void process_node(aiNode* node, const aiScene* scene);
+
+	// First pass: meshes in node order with their ranges in the joint buffers
+	void process_node(aiNode* node, const aiScene* scene, std::vector<const aiMesh*>& meshes);
+
+	// Second pass: copies a mesh into its preallocated ranges, meshes don't overlap
+	void process_mesh(const aiMesh* mesh, const AssimpMeshData& range);
+	void extract_meshes(const std::vector<const aiMesh*>& meshes, ThreadPool* workers);
 
 private:
 	std::filesystem::path m_directory;
@@ -52,6 +72,8 @@ private:
 	std::vector<AssimpMeshData> m_meshes;
 	std::vector<AssimpMaterialData> m_materials;
 
+	Timings m_timings;
+
 
 };
 
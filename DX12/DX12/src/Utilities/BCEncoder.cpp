@@ -0,0 +1,407 @@
+#include "pch.h"
+#include "BCEncoder.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+
+namespace bc
+{
+	namespace
+	{
+		template <size_t C>
+		using Color = std::array<float, C>;
+
+		template <size_t C>
+		float distance_sq(const Color<C>& a, const Color<C>& b)
+		{
+			float d = 0.f;
+			for (uint32_t c = 0; c < C; ++c)
+				d += (a[c] - b[c]) * (a[c] - b[c]);
+			return d;
+		}
+
+		// Endpoints of the block's extent along its principal axis
+		template <size_t C>
+		void fit_principal_axis(const Color<C>* texels, Color<C>& e0, Color<C>& e1)
+		{
+			Color<C> mean{};
+			for (uint32_t i = 0; i < 16; ++i)
+				for (uint32_t c = 0; c < C; ++c)
+					mean[c] += texels[i][c] / 16.f;
+
+			float cov[C][C]{};
+			for (uint32_t i = 0; i < 16; ++i)
+				for (uint32_t r = 0; r < C; ++r)
+					for (uint32_t c = 0; c < C; ++c)
+						cov[r][c] += (texels[i][r] - mean[r]) * (texels[i][c] - mean[c]);
+
+			// power iteration, starting along the largest extent of the bounding box
+			Color<C> lo = texels[0], hi = texels[0];
+			for (uint32_t i = 1; i < 16; ++i)
+				for (uint32_t c = 0; c < C; ++c)
+				{
+					lo[c] = (std::min)(lo[c], texels[i][c]);
+					hi[c] = (std::max)(hi[c], texels[i][c]);
+				}
+			Color<C> axis{};
+			for (uint32_t c = 0; c < C; ++c)
+				axis[c] = hi[c] - lo[c];
+
+			for (uint32_t iter = 0; iter < 8; ++iter)
+			{
+				Color<C> next{};
+				for (uint32_t r = 0; r < C; ++r)
+					for (uint32_t c = 0; c < C; ++c)
+						next[r] += cov[r][c] * axis[c];
+
+				float len = 0.f;
+				for (uint32_t c = 0; c < C; ++c)
+					len = (std::max)(len, std::fabs(next[c]));
+				if (len < 1e-6f)
+					break;
+				for (uint32_t c = 0; c < C; ++c)
+					axis[c] = next[c] / len;
+			}
+
+			float min_t = 0.f, max_t = 0.f;
+			float axis_len_sq = 0.f;
+			for (uint32_t c = 0; c < C; ++c)
+				axis_len_sq += axis[c] * axis[c];
+
+			if (axis_len_sq < 1e-12f)
+			{
+				e0 = e1 = mean;
+				return;
+			}
+
+			for (uint32_t i = 0; i < 16; ++i)
+			{
+				float t = 0.f;
+				for (uint32_t c = 0; c < C; ++c)
+					t += (texels[i][c] - mean[c]) * axis[c];
+				t /= axis_len_sq;
+				if (i == 0 || t < min_t)
+					min_t = t;
+				if (i == 0 || t > max_t)
+					max_t = t;
+			}
+
+			for (uint32_t c = 0; c < C; ++c)
+			{
+				e0[c] = std::clamp(mean[c] + axis[c] * max_t, 0.f, 255.f);
+				e1[c] = std::clamp(mean[c] + axis[c] * min_t, 0.f, 255.f);
+			}
+		}
+
+		// Least squares endpoints for fixed interpolation weights (weight of e1 per texel), returns false if degenerate
+		template <size_t C>
+		bool refine_endpoints(const Color<C>* texels, const float* weights, Color<C>& e0, Color<C>& e1)
+		{
+			float aa = 0.f, ab = 0.f, bb = 0.f;
+			Color<C> ax{}, bx{};
+			for (uint32_t i = 0; i < 16; ++i)
+			{
+				const float b = weights[i];
+				const float a = 1.f - b;
+				aa += a * a;
+				ab += a * b;
+				bb += b * b;
+				for (uint32_t c = 0; c < C; ++c)
+				{
+					ax[c] += a * texels[i][c];
+					bx[c] += b * texels[i][c];
+				}
+			}
+
+			const float det = aa * bb - ab * ab;
+			if (std::fabs(det) < 1e-6f)
+				return false;
+
+			for (uint32_t c = 0; c < C; ++c)
+			{
+				e0[c] = std::clamp((ax[c] * bb - bx[c] * ab) / det, 0.f, 255.f);
+				e1[c] = std::clamp((bx[c] * aa - ax[c] * ab) / det, 0.f, 255.f);
+			}
+			return true;
+		}
+
+		// LSB first bit packing into a 128 bit block
+		class BitWriter
+		{
+		public:
+			BitWriter(uint8_t* out) : m_out(out) { std::memset(out, 0, 16); }
+
+			void write(uint32_t value, uint32_t num_bits)
+			{
+				for (uint32_t i = 0; i < num_bits; ++i, ++m_pos)
+					m_out[m_pos >> 3] |= (uint8_t)(((value >> i) & 1) << (m_pos & 7));
+			}
+
+		private:
+			uint8_t* m_out = nullptr;
+			uint32_t m_pos = 0;
+		};
+
+		// --- BC1 ---
+
+		uint16_t to_565(const Color<3>& c)
+		{
+			const auto r = (uint16_t)std::lround(c[0] * 31.f / 255.f);
+			const auto g = (uint16_t)std::lround(c[1] * 63.f / 255.f);
+			const auto b = (uint16_t)std::lround(c[2] * 31.f / 255.f);
+			return (uint16_t)((r << 11) | (g << 5) | b);
+		}
+
+		Color<3> from_565(uint16_t v)
+		{
+			const uint32_t r = (v >> 11) & 31, g = (v >> 5) & 63, b = v & 31;
+			return { (float)((r << 3) | (r >> 2)), (float)((g << 2) | (g >> 4)), (float)((b << 3) | (b >> 2)) };
+		}
+
+		struct BC1Fit
+		{
+			uint16_t c0 = 0, c1 = 0;
+			uint32_t indices = 0;
+			float error = 0.f;
+			float weights[16]{};
+		};
+
+		BC1Fit quantize_bc1(const Color<3>* texels, const Color<3>& e0, const Color<3>& e1)
+		{
+			BC1Fit fit{};
+			fit.c0 = to_565(e0);
+			fit.c1 = to_565(e1);
+
+			// 4 color mode requires c0 > c1
+			if (fit.c0 < fit.c1)
+				std::swap(fit.c0, fit.c1);
+
+			const auto p0 = from_565(fit.c0), p1 = from_565(fit.c1);
+			std::array<Color<3>, 4> palette{};
+			palette[0] = p0;
+			palette[1] = p1;
+			for (uint32_t c = 0; c < 3; ++c)
+			{
+				palette[2][c] = (2.f * p0[c] + p1[c]) / 3.f;
+				palette[3][c] = (p0[c] + 2.f * p1[c]) / 3.f;
+			}
+			constexpr float palette_weights[4] = { 0.f, 1.f, 1.f / 3.f, 2.f / 3.f };
+
+			for (uint32_t i = 0; i < 16; ++i)
+			{
+				uint32_t best = 0;
+				float best_err = distance_sq(texels[i], palette[0]);
+				// equal endpoints only have a single color
+				for (uint32_t p = 1; p < 4 && fit.c0 != fit.c1; ++p)
+				{
+					const float err = distance_sq(texels[i], palette[p]);
+					if (err < best_err)
+					{
+						best_err = err;
+						best = p;
+					}
+				}
+				fit.indices |= best << (2 * i);
+				fit.error += best_err;
+				fit.weights[i] = palette_weights[best];
+			}
+			return fit;
+		}
+
+		void encode_bc1_color(const uint8_t* rgba, uint8_t* out)
+		{
+			Color<3> texels[16];
+			for (uint32_t i = 0; i < 16; ++i)
+				texels[i] = { (float)rgba[i * 4 + 0], (float)rgba[i * 4 + 1], (float)rgba[i * 4 + 2] };
+
+			Color<3> e0, e1;
+			fit_principal_axis(texels, e0, e1);
+			auto fit = quantize_bc1(texels, e0, e1);
+
+			if (refine_endpoints(texels, fit.weights, e0, e1))
+			{
+				const auto refined = quantize_bc1(texels, e0, e1);
+				if (refined.error < fit.error)
+					fit = refined;
+			}
+
+			std::memcpy(out + 0, &fit.c0, 2);
+			std::memcpy(out + 2, &fit.c1, 2);
+			std::memcpy(out + 4, &fit.indices, 4);
+		}
+
+		// --- BC7 mode 6 ---
+
+		constexpr uint32_t BC7_WEIGHTS_4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+		struct BC7Fit
+		{
+			uint32_t endpoints[2][4]{};		// 7 bit
+			uint32_t pbits[2]{};
+			uint32_t indices[16]{};
+			float error = 0.f;
+			float weights[16]{};
+		};
+
+		// Picks the p-bit with the least error for an endpoint, returns the 7 bit channels
+		void quantize_bc7_endpoint(const Color<4>& e, uint32_t* channels, uint32_t& pbit)
+		{
+			float best_err = 0.f;
+			for (uint32_t p = 0; p < 2; ++p)
+			{
+				uint32_t q[4];
+				float err = 0.f;
+				for (uint32_t c = 0; c < 4; ++c)
+				{
+					q[c] = (uint32_t)std::clamp((int)std::lround((e[c] - (float)p) / 2.f), 0, 127);
+					const float v = (float)((q[c] << 1) | p);
+					err += (v - e[c]) * (v - e[c]);
+				}
+				if (p == 0 || err < best_err)
+				{
+					best_err = err;
+					pbit = p;
+					std::memcpy(channels, q, sizeof(q));
+				}
+			}
+		}
+
+		BC7Fit quantize_bc7(const Color<4>* texels, const Color<4>& e0, const Color<4>& e1)
+		{
+			BC7Fit fit{};
+			quantize_bc7_endpoint(e0, fit.endpoints[0], fit.pbits[0]);
+			quantize_bc7_endpoint(e1, fit.endpoints[1], fit.pbits[1]);
+
+			uint32_t p0[4], p1[4];
+			for (uint32_t c = 0; c < 4; ++c)
+			{
+				p0[c] = (fit.endpoints[0][c] << 1) | fit.pbits[0];
+				p1[c] = (fit.endpoints[1][c] << 1) | fit.pbits[1];
+			}
+
+			std::array<Color<4>, 16> palette{};
+			for (uint32_t i = 0; i < 16; ++i)
+				for (uint32_t c = 0; c < 4; ++c)
+					palette[i][c] = (float)(((64 - BC7_WEIGHTS_4[i]) * p0[c] + BC7_WEIGHTS_4[i] * p1[c] + 32) >> 6);
+
+			for (uint32_t i = 0; i < 16; ++i)
+			{
+				uint32_t best = 0;
+				float best_err = distance_sq(texels[i], palette[0]);
+				for (uint32_t p = 1; p < 16; ++p)
+				{
+					const float err = distance_sq(texels[i], palette[p]);
+					if (err < best_err)
+					{
+						best_err = err;
+						best = p;
+					}
+				}
+				fit.indices[i] = best;
+				fit.error += best_err;
+				fit.weights[i] = (float)BC7_WEIGHTS_4[best] / 64.f;
+			}
+			return fit;
+		}
+	}
+
+	void encode_bc1(const uint8_t* rgba, uint8_t* out)
+	{
+		encode_bc1_color(rgba, out);
+	}
+
+	void encode_bc3(const uint8_t* rgba, uint8_t* out)
+	{
+		encode_bc4(rgba + 3, 4, out);
+		encode_bc1_color(rgba, out + 8);
+	}
+
+	void encode_bc4(const uint8_t* values, uint32_t stride, uint8_t* out)
+	{
+		uint8_t v[16];
+		uint8_t lo = 255, hi = 0;
+		for (uint32_t i = 0; i < 16; ++i)
+		{
+			v[i] = values[i * stride];
+			lo = (std::min)(lo, v[i]);
+			hi = (std::max)(hi, v[i]);
+		}
+
+		// 8 value mode (e0 > e1), equal endpoints only use index 0
+		out[0] = hi;
+		out[1] = lo;
+
+		float palette[8];
+		palette[0] = hi;
+		palette[1] = lo;
+		for (uint32_t p = 2; p < 8; ++p)
+			palette[p] = ((8 - p) * (float)hi + (p - 1) * (float)lo) / 7.f;
+
+		uint64_t indices = 0;
+		for (uint32_t i = 0; i < 16; ++i)
+		{
+			uint64_t best = 0;
+			float best_err = std::fabs(v[i] - palette[0]);
+			for (uint32_t p = 1; p < 8 && hi != lo; ++p)
+			{
+				const float err = std::fabs(v[i] - palette[p]);
+				if (err < best_err)
+				{
+					best_err = err;
+					best = p;
+				}
+			}
+			indices |= best << (3 * i);
+		}
+
+		for (uint32_t b = 0; b < 6; ++b)
+			out[2 + b] = (uint8_t)(indices >> (8 * b));
+	}
+
+	void encode_bc5(const uint8_t* rgba, uint8_t* out)
+	{
+		encode_bc4(rgba + 0, 4, out);
+		encode_bc4(rgba + 1, 4, out + 8);
+	}
+
+	void encode_bc7(const uint8_t* rgba, uint8_t* out)
+	{
+		Color<4> texels[16];
+		for (uint32_t i = 0; i < 16; ++i)
+			texels[i] = { (float)rgba[i * 4 + 0], (float)rgba[i * 4 + 1], (float)rgba[i * 4 + 2], (float)rgba[i * 4 + 3] };
+
+		Color<4> e0, e1;
+		fit_principal_axis(texels, e0, e1);
+		auto fit = quantize_bc7(texels, e0, e1);
+
+		if (refine_endpoints(texels, fit.weights, e0, e1))
+		{
+			const auto refined = quantize_bc7(texels, e0, e1);
+			if (refined.error < fit.error)
+				fit = refined;
+		}
+
+		// anchor index (texel 0) has an implicit 0 msb, flip the endpoints if needed
+		if (fit.indices[0] & 8)
+		{
+			std::swap(fit.endpoints[0], fit.endpoints[1]);
+			std::swap(fit.pbits[0], fit.pbits[1]);
+			for (auto& idx : fit.indices)
+				idx = 15 - idx;
+		}
+
+		BitWriter bits(out);
+		bits.write(1 << 6, 7);			// mode 6
+		for (uint32_t c = 0; c < 4; ++c)
+		{
+			bits.write(fit.endpoints[0][c], 7);
+			bits.write(fit.endpoints[1][c], 7);
+		}
+		bits.write(fit.pbits[0], 1);
+		bits.write(fit.pbits[1], 1);
+		bits.write(fit.indices[0], 3);
+		for (uint32_t i = 1; i < 16; ++i)
+			bits.write(fit.indices[i], 4);
+	}
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include <stdint.h>
+
+/*
+	CPU block compression encoders (std only, also built into the offline cooker).
+
+	Every function encodes a single 4x4 block, texels are row-major.
+	Endpoints are fit along the principal axis of the block, then refined once with least squares on the chosen indices.
+
+		BC1: RGB, 4 color mode only (no punch-through alpha)
+		BC3: BC4 alpha + BC1 color
+		BC4: single channel
+		BC5: two BC4 channels (e.g normal XY)
+		BC7: mode 6 only (single subset RGBA, 7.7.7.7 endpoints with p-bit, 4-bit indices)
+*/
+namespace bc
+{
+	constexpr uint32_t BC1_BLOCK_BYTES = 8;
+	constexpr uint32_t BC3_BLOCK_BYTES = 16;
+	constexpr uint32_t BC4_BLOCK_BYTES = 8;
+	constexpr uint32_t BC5_BLOCK_BYTES = 16;
+	constexpr uint32_t BC7_BLOCK_BYTES = 16;
+
+	// rgba: 16 RGBA8 texels
+	void encode_bc1(const uint8_t* rgba, uint8_t* out);
+	void encode_bc3(const uint8_t* rgba, uint8_t* out);
+	void encode_bc7(const uint8_t* rgba, uint8_t* out);
+
+	// values: 16 texels with a byte stride between them (e.g 4 to read one channel of RGBA8)
+	void encode_bc4(const uint8_t* values, uint32_t stride, uint8_t* out);
+
+	// rgba: 16 RGBA8 texels, R and G are encoded
+	void encode_bc5(const uint8_t* rgba, uint8_t* out);
+}
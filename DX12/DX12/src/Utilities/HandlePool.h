@@ -38,6 +38,9 @@ public:
 	void free_handle(full_key key);
 	ResourceT* get_resource(full_key key);
 
+	// False once the handle has been freed (the slot may have been reused since)
+	bool is_valid(full_key key) const;
+
 private:
 	static constexpr full_key INDEX_SHIFT = std::numeric_limits<half_key>::digits;
 	static constexpr full_key SLOT_MASK = ((full_key)1 << INDEX_SHIFT) - 1;
@@ -226,3 +229,11 @@ inline ResourceT* HandlePool<ResourceT, MAX_ELEMENTS>::get_resource(full_key han
 
 	return &m_resources[key];
 }
+
+template<typename ResourceT, uint32_t MAX_ELEMENTS>
+inline bool HandlePool<ResourceT, MAX_ELEMENTS>::is_valid(full_key handle) const
+{
+	const half_key key = (half_key)(handle & SLOT_MASK);
+	const half_key gen = (half_key)((handle & GENERATION_MASK) >> INDEX_SHIFT);
+	return key != INVALID_HANDLE && key < m_generational_counters.size() && m_generational_counters[key] == gen;
+}
@@ -0,0 +1,9 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+	Non-cryptographic hashing of large blobs (std only).
+	xxhash64: XXH64 (xxHash by Yann Collet), matches the reference output for the same seed.
+*/
+uint64_t xxhash64(const void* data, size_t size, uint64_t seed = 0);
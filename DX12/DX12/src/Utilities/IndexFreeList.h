@@ -0,0 +1,60 @@
+#pragma once
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+/*
+	Intrusive index free list over a fixed number of elements: each free element stores the index of the next free element (4 bytes per element).
+	Elements are handed out in ascending order initially, freed elements are reused first (LIFO).
+
+	Std-only, the device side (what an index refers to) is up to the owner (e.g DXBufferMemPool).
+*/
+class IndexFreeList
+{
+public:
+	static constexpr uint32_t INVALID_INDEX = (uint32_t)-1;
+
+public:
+	IndexFreeList() = default;
+	IndexFreeList(uint32_t num_elements) :
+		m_num_free(num_elements)
+	{
+		m_next_free.resize(num_elements);
+		for (uint32_t i = 0; i < num_elements; ++i)
+			m_next_free[i] = i + 1 < num_elements ? i + 1 : INVALID_INDEX;
+		m_head = num_elements > 0 ? 0 : INVALID_INDEX;
+	}
+
+	// INVALID_INDEX if there are no free elements
+	uint32_t allocate()
+	{
+		if (m_head == INVALID_INDEX)
+			return INVALID_INDEX;
+
+		const uint32_t index = m_head;
+		m_head = m_next_free[index];
+		m_next_free[index] = INVALID_INDEX;
+		--m_num_free;
+		return index;
+	}
+
+	void deallocate(uint32_t index)
+	{
+		assert(index < m_next_free.size());
+		assert(m_next_free[index] == INVALID_INDEX && index != m_head);		// double free (best effort)
+
+		m_next_free[index] = m_head;
+		m_head = index;
+		++m_num_free;
+	}
+
+	uint32_t num_elements() const { return (uint32_t)m_next_free.size(); }
+	uint32_t num_free() const { return m_num_free; }
+	size_t bookkeeping_bytes() const { return m_next_free.size() * sizeof(uint32_t); }
+
+private:
+	std::vector<uint32_t> m_next_free;
+	uint32_t m_head = INVALID_INDEX;
+	uint32_t m_num_free = 0;
+};
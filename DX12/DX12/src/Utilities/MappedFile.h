@@ -0,0 +1,36 @@
+#pragma once
+#include <stdint.h>
+#include <filesystem>
+
+/*
+	Read-only memory mapped file (Win32 file mapping or POSIX mmap).
+	The view stays valid until the object is closed or destroyed, move-only.
+*/
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	~MappedFile();
+
+	MappedFile(MappedFile&& other) noexcept;
+	MappedFile& operator=(MappedFile&& other) noexcept;
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	// Returns false if the file does not exist or can't be mapped
+	bool open(const std::filesystem::path& path);
+	void close();
+
+	bool is_open() const { return m_data != nullptr; }
+	const uint8_t* data() const { return m_data; }
+	size_t size() const { return m_size; }
+
+private:
+	const uint8_t* m_data = nullptr;
+	size_t m_size = 0;
+
+#ifdef _WIN32
+	void* m_file = nullptr;
+	void* m_mapping = nullptr;
+#endif
+};
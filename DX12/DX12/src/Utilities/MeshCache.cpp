@@ -0,0 +1,309 @@
+#include "pch.h"
+#include "MeshCache.h"
+#include "Hash.h"
+#include <cstring>
+#include <string_view>
+#include <fstream>
+
+namespace
+{
+	constexpr uint64_t DATA_ALIGNMENT = 16;
+
+	uint64_t align_up(uint64_t value, uint64_t alignment)
+	{
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
+
+	struct SectionData
+	{
+		const void* data = nullptr;
+		uint64_t size = 0;
+		uint32_t count = 0;
+		uint32_t stride = 0;
+	};
+
+	SectionData from_blob(const utils::MemBlob& blob)
+	{
+		if (blob.empty())
+			return {};
+		return { blob.data, (uint64_t)blob.count * blob.stride, blob.count, blob.stride };
+	}
+
+	utils::MemBlob to_blob(const uint8_t* file, const MeshCacheHeader::Section& section)
+	{
+		if (section.count == 0)
+			return {};
+		return utils::MemBlob((void*)(file + section.offset), section.count, section.stride);
+	}
+
+	void push_path(std::vector<uint8_t>& out, const std::filesystem::path& path)
+	{
+		const auto str = path.generic_u8string();
+		const auto len = (uint32_t)str.size();
+		out.insert(out.end(), (const uint8_t*)&len, (const uint8_t*)&len + sizeof(len));
+		out.insert(out.end(), (const uint8_t*)str.data(), (const uint8_t*)str.data() + len);
+	}
+
+	bool read_path(const uint8_t*& curr, const uint8_t* end, std::filesystem::path& path)
+	{
+		uint32_t len = 0;
+		if ((size_t)(end - curr) < sizeof(len))
+			return false;
+		std::memcpy(&len, curr, sizeof(len));
+		curr += sizeof(len);
+
+		if ((size_t)(end - curr) < len)
+			return false;
+		path = std::filesystem::u8path(std::string((const char*)curr, len));
+		curr += len;
+		return true;
+	}
+
+	std::string_view trim(std::string_view str)
+	{
+		const auto first = str.find_first_not_of(" \t\r");
+		if (first == std::string_view::npos)
+			return {};
+		return str.substr(first, str.find_last_not_of(" \t\r") - first + 1);
+	}
+
+	// Files referenced by the model which Assimp reads along with it: glTF buffers and OBJ material libraries
+	std::vector<std::filesystem::path> find_companions(const std::filesystem::path& source, std::string_view text)
+	{
+		std::vector<std::string_view> names;
+		if (source.extension() == ".gltf")
+		{
+			// "uri": "<name>.bin" (images are textures, data: uris are embedded)
+			constexpr std::string_view key = "\"uri\"";
+			for (size_t pos = text.find(key); pos != std::string_view::npos; pos = text.find(key, pos + key.size()))
+			{
+				const auto open = text.find('"', pos + key.size());
+				const auto close = open == std::string_view::npos ? open : text.find('"', open + 1);
+				if (close == std::string_view::npos)
+					break;
+				const auto name = text.substr(open + 1, close - open - 1);
+				if (name.size() > 4 && name.substr(name.size() - 4) == ".bin")
+					names.push_back(name);
+			}
+		}
+		else if (source.extension() == ".obj")
+		{
+			// mtllib <name>
+			constexpr std::string_view key = "mtllib";
+			for (size_t pos = text.find(key); pos != std::string_view::npos; pos = text.find(key, pos + key.size()))
+			{
+				if (pos != 0 && text[pos - 1] != '\n')
+					continue;
+				const auto end = text.find('\n', pos);
+				const auto name = trim(text.substr(pos + key.size(), end == std::string_view::npos ? end : end - pos - key.size()));
+				if (!name.empty())
+					names.push_back(name);
+			}
+		}
+
+		std::vector<std::filesystem::path> companions;
+		for (const auto& name : names)
+			companions.push_back(source.parent_path() / std::filesystem::u8path(std::string(name)));
+		return companions;
+	}
+
+	// Cache files of a model start with this, followed by the source hash
+	std::string get_cache_prefix(const std::filesystem::path& source)
+	{
+		const auto source_path = source.generic_u8string();
+		return fmt::format("{}.{:08x}.", source.stem().string(), (uint32_t)xxhash64(source_path.data(), source_path.size()));
+	}
+}
+
+uint64_t MeshCache::hash_source(const std::filesystem::path& source)
+{
+	MappedFile file;
+	if (!file.open(source))
+		return 0;
+	uint64_t hash = xxhash64(file.data(), file.size(), MeshCacheHeader::VERSION);
+
+	// in the order the model references them
+	for (const auto& companion : find_companions(source, std::string_view((const char*)file.data(), file.size())))
+	{
+		MappedFile companion_file;
+		if (companion_file.open(companion))
+			hash = xxhash64(companion_file.data(), companion_file.size(), hash);
+	}
+	return hash;
+}
+
+std::filesystem::path MeshCache::get_cache_path(const std::filesystem::path& source, uint64_t source_hash)
+{
+	// the source path is part of the name, models with the same name in different places don't share files
+	return std::filesystem::path("cache") / fmt::format("{}{:016x}.mcache", get_cache_prefix(source), source_hash);
+}
+
+bool MeshCache::write(const std::filesystem::path& path, uint64_t source_hash, const MeshCacheContents& contents)
+{
+	std::vector<uint8_t> materials;
+	for (const auto& material : contents.materials)
+	{
+		const auto& paths = std::get<AssimpMaterialData::PhongPaths>(material.file_paths);
+		push_path(materials, paths.diffuse);
+		push_path(materials, paths.normal);
+		push_path(materials, paths.specular);
+		push_path(materials, paths.opacity);
+	}
+
+	const SectionData sections[] =
+	{
+		from_blob(contents.positions),
+		from_blob(contents.uvs),
+		from_blob(contents.normals),
+		from_blob(contents.tangents),
+		from_blob(contents.bitangents),
+		from_blob(contents.indices),
+		{ contents.meshes.data(), contents.meshes.size() * sizeof(AssimpMeshData), (uint32_t)contents.meshes.size(), sizeof(AssimpMeshData) },
+		{ materials.data(), materials.size(), (uint32_t)contents.materials.size(), 0 },
+	};
+	static_assert(std::size(sections) == (size_t)MeshCacheSection::eCount);
+
+	MeshCacheHeader header{};
+	header.source_hash = source_hash;
+	uint64_t offset = sizeof(MeshCacheHeader);
+	for (uint32_t i = 0; i < (uint32_t)MeshCacheSection::eCount; ++i)
+	{
+		offset = align_up(offset, DATA_ALIGNMENT);
+		header.sections[i] = { offset, sections[i].size, sections[i].count, sections[i].stride };
+		offset += sections[i].size;
+	}
+
+	// written aside and moved in place, a cache is either complete or missing
+	std::error_code ec;
+	if (path.has_parent_path())
+		std::filesystem::create_directories(path.parent_path(), ec);
+	auto tmp_path = path;
+	tmp_path += ".tmp";
+	{
+		std::ofstream file(tmp_path, std::ios::binary | std::ios::trunc);
+		if (!file.is_open())
+			return false;
+
+		file.write((const char*)&header, sizeof(header));
+		uint64_t written = sizeof(header);
+		const char padding[DATA_ALIGNMENT]{};
+		for (uint32_t i = 0; i < (uint32_t)MeshCacheSection::eCount; ++i)
+		{
+			file.write(padding, header.sections[i].offset - written);
+			file.write((const char*)sections[i].data, sections[i].size);
+			written = header.sections[i].offset + header.sections[i].size;
+		}
+
+		if (!file.good())
+			return false;
+	}
+
+	std::filesystem::rename(tmp_path, path, ec);
+	return !ec;
+}
+
+void MeshCache::remove_superseded(const std::filesystem::path& source, const std::filesystem::path& current)
+{
+	const auto prefix = get_cache_prefix(source);
+	std::error_code ec;
+	for (const auto& entry : std::filesystem::directory_iterator(current.parent_path(), ec))
+	{
+		const auto name = entry.path().filename().string();
+		if (entry.path().extension() == ".mcache" && name.compare(0, prefix.size(), prefix) == 0 && entry.path().filename() != current.filename())
+			std::filesystem::remove(entry.path(), ec);
+	}
+}
+
+bool MeshCache::open(const std::filesystem::path& path, uint64_t source_hash)
+{
+	m_file.close();
+	m_contents = {};
+
+	if (!std::filesystem::exists(path) || !m_file.open(path) || m_file.size() < sizeof(MeshCacheHeader))
+		return false;
+
+	const auto data = m_file.data();
+	const auto header = (const MeshCacheHeader*)data;
+	if (header->magic != MeshCacheHeader::MAGIC || header->version != MeshCacheHeader::VERSION || header->source_hash != source_hash)
+	{
+		m_file.close();
+		return false;
+	}
+
+	for (const auto& section : header->sections)
+	{
+		// written without sums so that crafted offsets and sizes can't wrap around
+		const bool in_bounds = section.offset >= sizeof(MeshCacheHeader) && section.offset <= m_file.size() && section.size <= m_file.size() - section.offset;
+		const bool sized = section.stride == 0 || section.size == (uint64_t)section.count * section.stride;
+		if (!in_bounds || !sized)
+		{
+			m_file.close();
+			return false;
+		}
+	}
+
+	auto section = [header](MeshCacheSection type) -> const MeshCacheHeader::Section& { return header->sections[(uint32_t)type]; };
+
+	m_contents.positions = to_blob(data, section(MeshCacheSection::ePositions));
+	m_contents.uvs = to_blob(data, section(MeshCacheSection::eUVs));
+	m_contents.normals = to_blob(data, section(MeshCacheSection::eNormals));
+	m_contents.tangents = to_blob(data, section(MeshCacheSection::eTangents));
+	m_contents.bitangents = to_blob(data, section(MeshCacheSection::eBitangents));
+	m_contents.indices = to_blob(data, section(MeshCacheSection::eIndices));
+
+	const auto& meshes = section(MeshCacheSection::eMeshes);
+	if (meshes.stride != sizeof(AssimpMeshData))
+	{
+		m_file.close();
+		m_contents = {};
+		return false;
+	}
+	m_contents.meshes.resize(meshes.count);
+	if (!m_contents.meshes.empty())
+		std::memcpy(m_contents.meshes.data(), data + meshes.offset, meshes.size);
+
+	// streams are per vertex, and meshes own contiguous ranges in them
+	const uint64_t num_verts = m_contents.positions.count;
+	bool consistent = true;
+	for (const auto* stream : { &m_contents.uvs, &m_contents.normals, &m_contents.tangents, &m_contents.bitangents })
+		consistent &= stream->count == 0 || stream->count == num_verts;
+	for (size_t i = 0; i < m_contents.meshes.size(); ++i)
+	{
+		const auto& mesh = m_contents.meshes[i];
+		const uint64_t vertex_end = i + 1 < m_contents.meshes.size() ? m_contents.meshes[i + 1].vertex_start : num_verts;
+		consistent &= mesh.vertex_start <= vertex_end && vertex_end <= num_verts;
+		consistent &= (uint64_t)mesh.index_start + mesh.index_count <= m_contents.indices.count;
+	}
+	if (!consistent)
+	{
+		m_file.close();
+		m_contents = {};
+		return false;
+	}
+
+	// every material has at least its 4 path lengths
+	const auto& materials = section(MeshCacheSection::eMaterials);
+	if (materials.count > materials.size / (4 * sizeof(uint32_t)))
+	{
+		m_file.close();
+		m_contents = {};
+		return false;
+	}
+	const uint8_t* curr = data + materials.offset;
+	const uint8_t* end = curr + materials.size;
+	m_contents.materials.resize(materials.count);
+	for (auto& material : m_contents.materials)
+	{
+		AssimpMaterialData::PhongPaths paths;
+		if (!read_path(curr, end, paths.diffuse) || !read_path(curr, end, paths.normal) ||
+			!read_path(curr, end, paths.specular) || !read_path(curr, end, paths.opacity))
+		{
+			m_file.close();
+			m_contents = {};
+			return false;
+		}
+		material.file_paths = paths;
+	}
+
+	return true;
+}
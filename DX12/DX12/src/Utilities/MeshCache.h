@@ -0,0 +1,80 @@
+#pragma once
+#include "AssimpTypes.h"
+#include "MappedFile.h"
+
+/*
+	Binary cache of imported models (AssimpLoader output), memory mapped on load so the mesh streams can be used in place.
+
+	Files are keyed by a hash of the source (the model file and the .bin buffers / .mtl libraries it references) and live in cache/,
+	a changed source gets a new file and the superseded ones are removed. Bump VERSION whenever the import flags or the loader output change.
+
+	Layout (little endian):
+		MeshCacheHeader
+		sections, each starting at a 16 byte aligned offset:
+			vertex streams and indices		tightly packed elements (count * stride)
+			meshes							AssimpMeshData
+			materials						4 paths per material (diffuse, normal, specular, opacity), u32 length + UTF-8 bytes
+*/
+
+enum class MeshCacheSection : uint32_t
+{
+	ePositions,
+	eUVs,
+	eNormals,
+	eTangents,
+	eBitangents,
+	eIndices,
+	eMeshes,
+	eMaterials,
+	eCount
+};
+
+struct MeshCacheHeader
+{
+	static constexpr uint32_t MAGIC = 0x4348534D;		// 'MSHC'
+	static constexpr uint32_t VERSION = 1;
+
+	struct Section
+	{
+		uint64_t offset = 0;
+		uint64_t size = 0;
+		uint32_t count = 0;
+		uint32_t stride = 0;		// 0 for variable sized elements
+	};
+
+	uint32_t magic = MAGIC;
+	uint32_t version = VERSION;
+	uint64_t source_hash = 0;
+	Section sections[(uint32_t)MeshCacheSection::eCount];
+};
+
+// Model data to write, or read back with the streams pointing into the mapping
+struct MeshCacheContents
+{
+	utils::MemBlob positions, uvs, normals, tangents, bitangents;
+	utils::MemBlob indices;
+	std::vector<AssimpMeshData> meshes;
+	std::vector<AssimpMaterialData> materials;
+};
+
+class MeshCache
+{
+public:
+	static uint64_t hash_source(const std::filesystem::path& source);
+	static std::filesystem::path get_cache_path(const std::filesystem::path& source, uint64_t source_hash);
+
+	static bool write(const std::filesystem::path& path, uint64_t source_hash, const MeshCacheContents& contents);
+
+	// Removes the cache files of older versions of source next to current
+	static void remove_superseded(const std::filesystem::path& source, const std::filesystem::path& current);
+
+	// Returns false if there is no valid cache for this hash (or its contents are inconsistent)
+	bool open(const std::filesystem::path& path, uint64_t source_hash);
+
+	// Streams are valid while the cache is open
+	const MeshCacheContents& get_contents() const { return m_contents; }
+
+private:
+	MappedFile m_file;
+	MeshCacheContents m_contents;
+};
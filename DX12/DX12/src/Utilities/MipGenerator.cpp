@@ -0,0 +1,398 @@
+#include "pch.h"
+#include "MipGenerator.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define MIP_SIMD_AVX2
+#define MIP_SIMD_SSE2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MIP_SIMD_SSE2
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define MIP_SIMD_NEON
+#endif
+
+namespace
+{
+	struct FloatImage
+	{
+		uint32_t width = 0;
+		uint32_t height = 0;
+		std::vector<float> texels;		// RGBA
+	};
+
+	// 2:1 separable kernel, tap i reads source texel 2 * dst + first + i
+	struct Kernel
+	{
+		int32_t first = 0;
+		std::vector<float> weights;
+	};
+
+	constexpr uint32_t MAX_TAPS = 8;
+
+	double bessel_i0(double x)
+	{
+		// power series, converges quickly for the small arguments used here
+		double sum = 1.0, term = 1.0;
+		for (int32_t k = 1; k < 32; ++k)
+		{
+			const double f = x * 0.5 / k;
+			term *= f * f;
+			sum += term;
+		}
+		return sum;
+	}
+
+	Kernel make_kaiser_kernel()
+	{
+		// sinc at half the source rate, windowed over 3 source texels. Taps sit at -2.5 .. 2.5 texels from the destination center
+		constexpr double pi = 3.14159265358979323846;
+		constexpr double radius = 3.0, beta = 4.0;
+
+		Kernel kernel{ -2, {} };
+		std::array<double, 6> weights{};
+		double sum = 0.0;
+		for (uint32_t tap = 0; tap < weights.size(); ++tap)
+		{
+			const double d = kernel.first + (int32_t)tap - 0.5;
+			const double r = d / radius;
+			const double sinc = std::sin(pi * d * 0.5) / (pi * d * 0.5);
+			weights[tap] = sinc * bessel_i0(beta * std::sqrt(1.0 - r * r)) / bessel_i0(beta);
+			sum += weights[tap];
+		}
+		for (const auto w : weights)
+			kernel.weights.push_back((float)(w / sum));
+		return kernel;
+	}
+
+	const Kernel& get_kernel(MipFilter filter)
+	{
+		static const Kernel box{ 0, { 0.5f, 0.5f } };
+		static const Kernel kaiser = make_kaiser_kernel();
+		return filter == MipFilter::eKaiser ? kaiser : box;
+	}
+
+	uint32_t clamp_index(int64_t idx, uint32_t size)
+	{
+		return (uint32_t)std::clamp<int64_t>(idx, 0, (int64_t)size - 1);
+	}
+
+	float srgb_to_linear(float c)
+	{
+		return c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+	}
+
+	const std::array<float, 256>& get_srgb_to_linear()
+	{
+		static const auto lut = []()
+		{
+			std::array<float, 256> lut{};
+			for (uint32_t i = 0; i < lut.size(); ++i)
+				lut[i] = srgb_to_linear(i / 255.f);
+			return lut;
+		}();
+		return lut;
+	}
+
+	// Linear -> sRGB byte without pow per texel, exact: a coarse table gives the first candidate byte,
+	// the thresholds (linear value at which each byte starts) settle it in at most a couple of steps
+	class SRGBEncoder
+	{
+	public:
+		SRGBEncoder()
+		{
+			for (uint32_t i = 0; i < m_thresholds.size(); ++i)
+				m_thresholds[i] = srgb_to_linear((i + 0.5f) / 255.f);
+
+			for (uint32_t i = 0; i < m_start.size(); ++i)
+				m_start[i] = (uint8_t)(std::upper_bound(m_thresholds.cbegin(), m_thresholds.cend(), (float)i / COARSE_STEPS) - m_thresholds.cbegin());
+		}
+
+		uint8_t encode(float v) const
+		{
+			v = std::clamp(v, 0.f, 1.f);
+			uint32_t byte = m_start[(uint32_t)(v * COARSE_STEPS)];
+			while (byte < m_thresholds.size() && m_thresholds[byte] <= v)
+				++byte;
+			return (uint8_t)byte;
+		}
+
+	private:
+		static constexpr uint32_t COARSE_STEPS = 4096;		// finer than the smallest byte step (1 / (255 * 12.92))
+		std::array<float, 255> m_thresholds{};
+		std::array<uint8_t, COARSE_STEPS + 1> m_start{};
+	};
+
+	FloatImage to_float(const uint8_t* rgba, uint32_t width, uint32_t height, const MipGenDesc& desc)
+	{
+		const auto& to_linear = get_srgb_to_linear();
+
+		FloatImage img{ width, height, {} };
+		img.texels.resize((size_t)width * height * 4);
+		for (size_t i = 0; i < img.texels.size(); ++i)
+		{
+			const bool color = (i & 3) != 3;		// alpha is always linear
+			if (desc.normal_map && color)
+				img.texels[i] = rgba[i] * (2.f / 255.f) - 1.f;
+			else if (desc.srgb && color)
+				img.texels[i] = to_linear[rgba[i]];
+			else
+				img.texels[i] = rgba[i] * (1.f / 255.f);
+		}
+		return img;
+	}
+
+	uint8_t quantize(float v)
+	{
+		return (uint8_t)std::lround(std::clamp(v, 0.f, 1.f) * 255.f);
+	}
+
+	void to_bytes(const FloatImage& img, const MipGenDesc& desc, MipLevel& out)
+	{
+		static const SRGBEncoder srgb_encoder;
+
+		out.width = img.width;
+		out.height = img.height;
+		out.rgba.resize(img.texels.size());
+		for (size_t i = 0; i < img.texels.size(); i += 4)
+		{
+			const float* texel = &img.texels[i];
+			uint8_t* dst = &out.rgba[i];
+			if (desc.normal_map)
+			{
+				float n[3] = { texel[0], texel[1], texel[2] };
+				const float len = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+				if (len > 1e-6f)
+				{
+					for (auto& c : n)
+						c /= len;
+				}
+				else
+				{
+					// opposing normals cancelled out
+					n[0] = 0.f;
+					n[1] = 0.f;
+					n[2] = 1.f;
+				}
+
+				for (uint32_t c = 0; c < 3; ++c)
+					dst[c] = quantize(n[c] * 0.5f + 0.5f);
+			}
+			else if (desc.srgb)
+			{
+				for (uint32_t c = 0; c < 3; ++c)
+					dst[c] = srgb_encoder.encode(texel[c]);
+			}
+			else
+			{
+				for (uint32_t c = 0; c < 3; ++c)
+					dst[c] = quantize(texel[c]);
+			}
+			dst[3] = quantize(texel[3]);
+		}
+	}
+
+	void filter_rows_scalar(const FloatImage& src, const Kernel& kernel, FloatImage& dst)
+	{
+		for (uint32_t y = 0; y < dst.height; ++y)
+		{
+			const float* row = &src.texels[(size_t)y * src.width * 4];
+			float* out = &dst.texels[(size_t)y * dst.width * 4];
+			for (uint32_t x = 0; x < dst.width; ++x)
+			{
+				float acc[4] = {};
+				for (uint32_t tap = 0; tap < kernel.weights.size(); ++tap)
+				{
+					const float* texel = row + clamp_index(2ll * x + kernel.first + tap, src.width) * 4;
+					for (uint32_t c = 0; c < 4; ++c)
+						acc[c] += kernel.weights[tap] * texel[c];
+				}
+				std::copy_n(acc, 4, out + (size_t)x * 4);
+			}
+		}
+	}
+
+	void filter_columns_scalar(const FloatImage& src, const Kernel& kernel, FloatImage& dst)
+	{
+		const size_t row_floats = (size_t)src.width * 4;
+		for (uint32_t y = 0; y < dst.height; ++y)
+		{
+			std::array<const float*, MAX_TAPS> rows{};
+			for (uint32_t tap = 0; tap < kernel.weights.size(); ++tap)
+				rows[tap] = &src.texels[clamp_index(2ll * y + kernel.first + tap, src.height) * row_floats];
+
+			float* out = &dst.texels[y * row_floats];
+			for (size_t i = 0; i < row_floats; ++i)
+			{
+				float acc = 0.f;
+				for (uint32_t tap = 0; tap < kernel.weights.size(); ++tap)
+					acc += kernel.weights[tap] * rows[tap][i];
+				out[i] = acc;
+			}
+		}
+	}
+
+#if defined(MIP_SIMD_SSE2) || defined(MIP_SIMD_NEON)
+	// One RGBA texel per register, multiply and add are kept separate so results match the scalar reference
+#if defined(MIP_SIMD_SSE2)
+	using f32x4 = __m128;
+	inline f32x4 zero4() { return _mm_setzero_ps(); }
+	inline f32x4 load4(const float* p) { return _mm_loadu_ps(p); }
+	inline void store4(float* p, f32x4 v) { _mm_storeu_ps(p, v); }
+	inline f32x4 madd4(f32x4 acc, float w, f32x4 v) { return _mm_add_ps(acc, _mm_mul_ps(_mm_set1_ps(w), v)); }
+#else
+	using f32x4 = float32x4_t;
+	inline f32x4 zero4() { return vdupq_n_f32(0.f); }
+	inline f32x4 load4(const float* p) { return vld1q_f32(p); }
+	inline void store4(float* p, f32x4 v) { vst1q_f32(p, v); }
+	inline f32x4 madd4(f32x4 acc, float w, f32x4 v) { return vaddq_f32(acc, vmulq_n_f32(v, w)); }
+#endif
+
+	void filter_rows_simd(const FloatImage& src, const Kernel& kernel, FloatImage& dst)
+	{
+		const uint32_t num_taps = (uint32_t)kernel.weights.size();
+		for (uint32_t y = 0; y < dst.height; ++y)
+		{
+			const float* row = &src.texels[(size_t)y * src.width * 4];
+			float* out = &dst.texels[(size_t)y * dst.width * 4];
+			uint32_t x = 0;
+
+#if defined(MIP_SIMD_AVX2)
+			// two destination texels per register
+			for (; x + 1 < dst.width; x += 2)
+			{
+				__m256 acc = _mm256_setzero_ps();
+				for (uint32_t tap = 0; tap < num_taps; ++tap)
+				{
+					const float* lo = row + clamp_index(2ll * x + kernel.first + tap, src.width) * 4;
+					const float* hi = row + clamp_index(2ll * x + 2 + kernel.first + tap, src.width) * 4;
+					const __m256 v = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(lo)), _mm_loadu_ps(hi), 1);
+					acc = _mm256_add_ps(acc, _mm256_mul_ps(_mm256_set1_ps(kernel.weights[tap]), v));
+				}
+				_mm256_storeu_ps(out + (size_t)x * 4, acc);
+			}
+#endif
+
+			for (; x < dst.width; ++x)
+			{
+				f32x4 acc = zero4();
+				for (uint32_t tap = 0; tap < num_taps; ++tap)
+					acc = madd4(acc, kernel.weights[tap], load4(row + clamp_index(2ll * x + kernel.first + tap, src.width) * 4));
+				store4(out + (size_t)x * 4, acc);
+			}
+		}
+	}
+
+	void filter_columns_simd(const FloatImage& src, const Kernel& kernel, FloatImage& dst)
+	{
+		const uint32_t num_taps = (uint32_t)kernel.weights.size();
+		const size_t row_floats = (size_t)src.width * 4;
+		for (uint32_t y = 0; y < dst.height; ++y)
+		{
+			std::array<const float*, MAX_TAPS> rows{};
+			for (uint32_t tap = 0; tap < num_taps; ++tap)
+				rows[tap] = &src.texels[clamp_index(2ll * y + kernel.first + tap, src.height) * row_floats];
+
+			float* out = &dst.texels[y * row_floats];
+			size_t i = 0;
+
+#if defined(MIP_SIMD_AVX2)
+			for (; i + 8 <= row_floats; i += 8)
+			{
+				__m256 acc = _mm256_setzero_ps();
+				for (uint32_t tap = 0; tap < num_taps; ++tap)
+					acc = _mm256_add_ps(acc, _mm256_mul_ps(_mm256_set1_ps(kernel.weights[tap]), _mm256_loadu_ps(rows[tap] + i)));
+				_mm256_storeu_ps(out + i, acc);
+			}
+#endif
+
+			// rows are whole RGBA texels
+			for (; i < row_floats; i += 4)
+			{
+				f32x4 acc = zero4();
+				for (uint32_t tap = 0; tap < num_taps; ++tap)
+					acc = madd4(acc, kernel.weights[tap], load4(rows[tap] + i));
+				store4(out + i, acc);
+			}
+		}
+	}
+#else
+	void filter_rows_simd(const FloatImage& src, const Kernel& kernel, FloatImage& dst) { filter_rows_scalar(src, kernel, dst); }
+	void filter_columns_simd(const FloatImage& src, const Kernel& kernel, FloatImage& dst) { filter_columns_scalar(src, kernel, dst); }
+#endif
+
+	// A dimension of 1 is passed through
+	void filter_rows(const FloatImage& src, const Kernel& kernel, MipKernel impl, FloatImage& dst)
+	{
+		if (src.width == 1)
+		{
+			dst = src;
+			return;
+		}
+
+		dst.width = src.width / 2;
+		dst.height = src.height;
+		dst.texels.resize((size_t)dst.width * dst.height * 4);
+		if (impl == MipKernel::eSIMD)
+			filter_rows_simd(src, kernel, dst);
+		else
+			filter_rows_scalar(src, kernel, dst);
+	}
+
+	void filter_columns(const FloatImage& src, const Kernel& kernel, MipKernel impl, FloatImage& dst)
+	{
+		if (src.height == 1)
+		{
+			dst = src;
+			return;
+		}
+
+		dst.width = src.width;
+		dst.height = src.height / 2;
+		dst.texels.resize((size_t)dst.width * dst.height * 4);
+		if (impl == MipKernel::eSIMD)
+			filter_columns_simd(src, kernel, dst);
+		else
+			filter_columns_scalar(src, kernel, dst);
+	}
+}
+
+std::vector<MipLevel> generate_mip_chain(const uint8_t* rgba, uint32_t width, uint32_t height, const MipGenDesc& desc)
+{
+	assert(rgba && width > 0 && height > 0);
+
+	const auto& kernel = get_kernel(desc.filter);
+	assert(kernel.weights.size() <= MAX_TAPS);
+
+	std::vector<MipLevel> levels;
+	levels.push_back({ width, height, std::vector<uint8_t>(rgba, rgba + (size_t)width * height * 4) });
+
+	FloatImage curr = to_float(rgba, width, height, desc), filtered, next;
+	while (curr.width > 1 || curr.height > 1)
+	{
+		filter_rows(curr, kernel, desc.kernel, filtered);
+		filter_columns(filtered, kernel, desc.kernel, next);
+		std::swap(curr, next);
+
+		levels.emplace_back();
+		to_bytes(curr, desc, levels.back());
+	}
+	return levels;
+}
+
+const char* mip_simd_isa()
+{
+#if defined(MIP_SIMD_AVX2)
+	return "AVX2";
+#elif defined(MIP_SIMD_SSE2)
+	return "SSE2";
+#elif defined(MIP_SIMD_NEON)
+	return "NEON";
+#else
+	return "none";
+#endif
+}
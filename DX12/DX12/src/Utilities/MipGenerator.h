@@ -0,0 +1,48 @@
+#pragma once
+#include <stdint.h>
+#include <vector>
+
+/*
+	CPU mip chain generation for RGBA8 images (std only, also built into the offline cooker).
+
+	Levels are filtered in float from the level above (no 8-bit round trip between levels) with separable 2:1 passes:
+		eBox:		2 taps, plain average
+		eKaiser:	6 taps, Kaiser windowed sinc (sharper with less aliasing, the slight overshoot is clamped)
+
+	sRGB images are linearized before filtering (alpha stays linear), normal maps are renormalized on output.
+	Dimensions follow D3D (max(1, dim >> level)), odd dimensions drop the last row/column.
+
+	eSIMD uses whichever of AVX2/SSE2/NEON the compiler targets (mip_simd_isa()), eScalar is the reference implementation.
+*/
+
+enum class MipFilter
+{
+	eBox,
+	eKaiser
+};
+
+enum class MipKernel
+{
+	eScalar,
+	eSIMD
+};
+
+struct MipGenDesc
+{
+	MipFilter filter = MipFilter::eBox;
+	bool srgb = false;
+	bool normal_map = false;		// XYZ in [0, 1] is treated as a [-1, 1] vector
+	MipKernel kernel = MipKernel::eSIMD;
+};
+
+struct MipLevel
+{
+	uint32_t width = 0;
+	uint32_t height = 0;
+	std::vector<uint8_t> rgba;
+};
+
+// rgba: width * height RGBA8 texels, row-major and tightly packed. Returns every level down to 1x1, level 0 is a copy of the input
+std::vector<MipLevel> generate_mip_chain(const uint8_t* rgba, uint32_t width, uint32_t height, const MipGenDesc& desc);
+
+const char* mip_simd_isa();
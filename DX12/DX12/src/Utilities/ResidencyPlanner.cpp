@@ -0,0 +1,157 @@
+#include "pch.h"
+#include "ResidencyPlanner.h"
+#include <algorithm>
+#include <cmath>
+
+ResidencyPlanner::ResidencyPlanner(uint32_t hold_frames) :
+	m_hold_frames(hold_frames)
+{
+}
+
+uint32_t ResidencyPlanner::add_texture(const ResidencyTextureDesc& desc)
+{
+	assert(!desc.mip_bytes.empty());
+	assert(desc.tail_mip < desc.mip_bytes.size() && desc.resident_mip <= desc.tail_mip);
+
+	uint32_t id = 0;
+	if (!m_free_ids.empty())
+	{
+		id = m_free_ids.back();
+		m_free_ids.pop_back();
+	}
+	else
+	{
+		id = (uint32_t)m_textures.size();
+		m_textures.emplace_back();
+	}
+
+	auto& tex = m_textures[id];
+	tex = Texture{};
+	tex.alive = true;
+	tex.tail_mip = desc.tail_mip;
+	tex.bytes_from.resize(desc.mip_bytes.size() + 1);
+	for (size_t mip = desc.mip_bytes.size(); mip-- > 0;)
+		tex.bytes_from[mip] = tex.bytes_from[mip + 1] + desc.mip_bytes[mip];
+	tex.held = desc.resident_mip;
+	tex.held_frame = m_frame;
+	tex.target = desc.resident_mip;
+
+	return id;
+}
+
+void ResidencyPlanner::remove_texture(uint32_t id)
+{
+	assert(m_textures[id].alive);
+	m_textures[id] = Texture{};
+	m_free_ids.push_back(id);
+}
+
+void ResidencyPlanner::request(uint32_t id, uint32_t mip)
+{
+	auto& tex = m_textures[id];
+	assert(tex.alive);
+	tex.requested = (std::min)(tex.requested, mip);
+}
+
+const std::vector<ResidencyPlanner::Change>& ResidencyPlanner::plan(uint64_t budget_bytes, uint64_t frame)
+{
+	assert(frame >= m_frame);
+	m_frame = frame;
+
+	m_changes.clear();
+	m_upgrade_heap.clear();
+	m_prev_targets.resize(m_textures.size());
+	m_stats = {};
+
+	for (uint32_t id = 0; id < m_textures.size(); ++id)
+	{
+		auto& tex = m_textures[id];
+		if (!tex.alive)
+			continue;
+
+		// most detailed request of the last hold_frames (unrequested textures fall back to their tail)
+		const uint32_t requested = (std::min)(tex.requested, tex.tail_mip);
+		if (requested <= tex.held || frame - tex.held_frame > m_hold_frames)
+		{
+			tex.held = requested;
+			tex.held_frame = frame;
+		}
+		tex.requested = INVALID_ID;
+
+		m_prev_targets[id] = tex.target;
+		tex.target = tex.tail_mip;
+
+		m_stats.bytes_resident += tex.bytes_from[tex.target];
+		m_stats.bytes_requested += tex.bytes_from[tex.held];
+		++m_stats.num_textures;
+
+		if (tex.target > tex.held)
+			m_upgrade_heap.push_back(make_upgrade(id));
+	}
+
+	// max-heap on the distance to the request, cheaper next mip first on ties
+	auto lower_priority = [](const Upgrade& a, const Upgrade& b)
+	{
+		if (a.missing != b.missing)
+			return a.missing < b.missing;
+		if (a.cost != b.cost)
+			return a.cost > b.cost;
+		return a.id > b.id;		// deterministic order
+	};
+	std::make_heap(m_upgrade_heap.begin(), m_upgrade_heap.end(), lower_priority);
+
+	while (!m_upgrade_heap.empty())
+	{
+		std::pop_heap(m_upgrade_heap.begin(), m_upgrade_heap.end(), lower_priority);
+		const auto upgrade = m_upgrade_heap.back();
+		m_upgrade_heap.pop_back();
+
+		if (m_stats.bytes_resident + upgrade.cost > budget_bytes)
+		{
+			// doesn't fit, others might
+			++m_stats.num_over_budget;
+			continue;
+		}
+
+		auto& tex = m_textures[upgrade.id];
+		--tex.target;
+		m_stats.bytes_resident += upgrade.cost;
+		if (tex.target > tex.held)
+		{
+			m_upgrade_heap.push_back(make_upgrade(upgrade.id));
+			std::push_heap(m_upgrade_heap.begin(), m_upgrade_heap.end(), lower_priority);
+		}
+	}
+
+	for (uint32_t id = 0; id < m_textures.size(); ++id)
+	{
+		const auto& tex = m_textures[id];
+		if (tex.alive && tex.target != m_prev_targets[id])
+			m_changes.push_back({ id, m_prev_targets[id], tex.target });
+	}
+
+	return m_changes;
+}
+
+ResidencyPlanner::Upgrade ResidencyPlanner::make_upgrade(uint32_t id) const
+{
+	const auto& tex = m_textures[id];
+	return { tex.target - tex.held, tex.bytes_from[tex.target - 1] - tex.bytes_from[tex.target], id };
+}
+
+uint32_t ResidencyPlanner::get_target_mip(uint32_t id) const
+{
+	assert(m_textures[id].alive);
+	return m_textures[id].target;
+}
+
+float ResidencyPlanner::mip_for_screen_size(const ResidencyView& view, float distance, float radius, uint32_t texture_size)
+{
+	// inside the bounds anything may be right in front of the camera
+	if (distance <= radius || radius <= 0.f)
+		return 0.f;
+
+	const float pixels_per_unit = view.proj_scale_y * view.viewport_height * 0.5f / distance;
+	const float texels_per_unit = texture_size / (2.f * radius);
+	return (std::max)(std::log2(texels_per_unit / pixels_per_unit), 0.f);
+}
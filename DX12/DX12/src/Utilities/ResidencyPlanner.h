@@ -0,0 +1,107 @@
+#pragma once
+#include <stdint.h>
+#include <vector>
+
+/*
+	Texture mip residency planning (std only, unaware of any device): which mips of which textures to keep in memory.
+
+	Every frame the visible users of a texture request the most detailed mip they need (see mip_for_screen_size),
+	requests to the same texture are combined (most detailed wins). plan() then picks a target mip per texture within the budget:
+		- every texture starts at its tail (the least detailed top level allowed, its mips are always resident)
+		- mips are added one at a time to the texture furthest from its request (cheapest first on ties)
+		  until every request is met or nothing else fits
+
+	A request is held for hold_frames before the texture may drop detail (also when it is no longer requested at all),
+	so textures close to a mip transition or briefly out of view don't thrash. Frames are counted by the frame number
+	passed to plan(), callers may skip planning (e.g while uploads are in flight), requests accumulate until the next plan().
+	plan() returns the textures whose target changed, the caller streams them (e.g DXTextureManager).
+*/
+
+struct ResidencyTextureDesc
+{
+	std::vector<uint64_t> mip_bytes;		// every mip, most detailed first
+	uint32_t tail_mip = 0;					// least detailed mip allowed as the top level
+	uint32_t resident_mip = 0;				// top level currently resident
+};
+
+struct ResidencyView
+{
+	float proj_scale_y = 1.f;				// projection [1][1], 1 / tan(fov_y / 2)
+	float viewport_height = 1.f;			// pixels
+};
+
+class ResidencyPlanner
+{
+public:
+	static constexpr uint32_t INVALID_ID = ~0u;
+
+	struct Change
+	{
+		uint32_t id = INVALID_ID;
+		uint32_t from_mip = 0;
+		uint32_t to_mip = 0;
+	};
+
+	struct Stats
+	{
+		uint64_t bytes_resident = 0;		// planned
+		uint64_t bytes_requested = 0;		// with every request met
+		uint32_t num_over_budget = 0;		// textures less detailed than requested
+		uint32_t num_textures = 0;
+	};
+
+public:
+	ResidencyPlanner(uint32_t hold_frames = 30);
+
+	uint32_t add_texture(const ResidencyTextureDesc& desc);
+	void remove_texture(uint32_t id);
+
+	void request(uint32_t id, uint32_t mip);
+
+	// Ends the requests since the last plan (which are cleared), frame is monotonic and counts every frame
+	const std::vector<Change>& plan(uint64_t budget_bytes, uint64_t frame);
+
+	uint32_t get_target_mip(uint32_t id) const;
+	const Stats& get_stats() const { return m_stats; }
+
+	// Fractional mip at which a texel covers about a pixel, for a texture of texture_size texels mapped once across a sphere
+	static float mip_for_screen_size(const ResidencyView& view, float distance, float radius, uint32_t texture_size);
+
+private:
+	struct Texture
+	{
+		bool alive = false;
+		std::vector<uint64_t> bytes_from;		// bytes resident with the top level at mip i (suffix sums of mip_bytes)
+		uint32_t tail_mip = 0;
+
+		uint32_t requested = INVALID_ID;		// since the last plan
+		uint32_t held = 0;
+		uint64_t held_frame = 0;				// last frame the held mip was requested
+		uint32_t target = 0;
+	};
+
+	// Next mip of a texture, compared without touching the textures
+	struct Upgrade
+	{
+		uint32_t missing = 0;		// mips away from the request
+		uint64_t cost = 0;
+		uint32_t id = INVALID_ID;
+	};
+
+private:
+	Upgrade make_upgrade(uint32_t id) const;
+
+private:
+	uint32_t m_hold_frames = 0;
+	uint64_t m_frame = 0;					// of the last plan
+
+	std::vector<Texture> m_textures;
+	std::vector<uint32_t> m_free_ids;
+
+	// Scratch
+	std::vector<uint32_t> m_prev_targets;
+	std::vector<Upgrade> m_upgrade_heap;
+	std::vector<Change> m_changes;
+
+	Stats m_stats;
+};
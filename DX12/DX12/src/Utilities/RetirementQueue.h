@@ -0,0 +1,62 @@
+#pragma once
+#include <stdint.h>
+#include <deque>
+#include <iterator>
+#include <utility>
+
+/*
+	Queue of typed release records keyed on 64-bit fence values.
+
+	A record is retired against the fence value that, once reached, guarantees that nothing in flight uses it anymore.
+	release_completed() hands every record whose fence value has been reached to the supplied release function, in fence order.
+	Records are kept sorted on the fence value, retiring in increasing order (the common case) is a push to the back.
+
+	The queue is unaware of any device, the completed value can come from an ID3D12Fence or any simulated counter.
+	Records may be move-only (e.g holding a unique_ptr).
+*/
+template <typename RecordT>
+class RetirementQueue
+{
+public:
+	void retire(uint64_t fence_value, RecordT&& record)
+	{
+		auto it = m_records.end();
+		while (it != m_records.begin() && std::prev(it)->fence_value > fence_value)
+			--it;
+		m_records.insert(it, Entry{ fence_value, std::move(record) });
+	}
+
+	// Returns the number of records released
+	template <typename ReleaseFunc>
+	uint32_t release_completed(uint64_t completed_fence_value, ReleaseFunc&& release)
+	{
+		uint32_t num_released = 0;
+		while (!m_records.empty() && m_records.front().fence_value <= completed_fence_value)
+		{
+			// pop before releasing in case the release function retires new records
+			auto entry = std::move(m_records.front());
+			m_records.pop_front();
+			release(entry.record);
+			++num_released;
+		}
+		return num_released;
+	}
+
+	template <typename ReleaseFunc>
+	uint32_t release_all(ReleaseFunc&& release)
+	{
+		return release_completed(~0ull, std::forward<ReleaseFunc>(release));
+	}
+
+	size_t size() const { return m_records.size(); }
+	bool empty() const { return m_records.empty(); }
+
+private:
+	struct Entry
+	{
+		uint64_t fence_value = 0;
+		RecordT record;
+	};
+
+	std::deque<Entry> m_records;
+};
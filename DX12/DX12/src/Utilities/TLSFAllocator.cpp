@@ -0,0 +1,295 @@
+#include "pch.h"
+#include "TLSFAllocator.h"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace
+{
+	// index of most significant set bit (v != 0)
+	uint32_t bit_msb(uint64_t v)
+	{
+#if defined(_MSC_VER)
+		unsigned long idx = 0;
+		_BitScanReverse64(&idx, v);
+		return (uint32_t)idx;
+#else
+		return 63 - (uint32_t)__builtin_clzll(v);
+#endif
+	}
+
+	// index of least significant set bit (v != 0)
+	uint32_t bit_lsb(uint64_t v)
+	{
+#if defined(_MSC_VER)
+		unsigned long idx = 0;
+		_BitScanForward64(&idx, v);
+		return (uint32_t)idx;
+#else
+		return (uint32_t)__builtin_ctzll(v);
+#endif
+	}
+}
+
+TLSFAllocator::TLSFAllocator(uint64_t capacity, uint64_t granularity) :
+	m_capacity(capacity),
+	m_granularity(granularity)
+{
+	assert(granularity > 0 && (granularity & (granularity - 1)) == 0);
+	assert(capacity >= granularity);
+
+	for (auto& fl_heads : m_heads)
+		for (auto& head : fl_heads)
+			head = INVALID_BLOCK;
+
+	// whole range starts out as one free block
+	const uint32_t block = new_block();
+	m_blocks[block].offset = 0;
+	m_blocks[block].size = capacity / granularity;
+	insert_free(block);
+}
+
+TLSFAllocator::Allocation TLSFAllocator::allocate(uint64_t size, uint64_t alignment)
+{
+	assert(alignment == 0 || ((alignment & (alignment - 1)) == 0 && alignment % m_granularity == 0));
+
+	uint64_t units = (size + m_granularity - 1) / m_granularity;
+	if (units == 0)
+		units = 1;
+	const uint64_t align_units = alignment > m_granularity ? alignment / m_granularity : 1;
+
+	// worst case padding is included in the search so that any block found is guaranteed to fit
+	uint32_t fl = 0, sl = 0;
+	mapping_search(units + align_units - 1, fl, sl);
+
+	uint32_t block = find_suitable_block(fl, sl);
+	if (block == INVALID_BLOCK)
+		return {};
+	remove_free(block);
+
+	// leading padding for alignment is given back as a free block
+	const uint64_t aligned_offset = (m_blocks[block].offset + align_units - 1) & ~(align_units - 1);
+	const uint64_t padding = aligned_offset - m_blocks[block].offset;
+	if (padding > 0)
+	{
+		const uint32_t aligned_block = split(block, padding);
+		insert_free(block);
+		block = aligned_block;
+	}
+
+	// trailing remainder
+	if (m_blocks[block].size > units)
+		insert_free(split(block, units));
+
+	m_blocks[block].is_free = false;
+	m_used += units;
+	++m_num_allocations;
+
+	Allocation alloc{};
+	alloc.offset = m_blocks[block].offset * m_granularity;
+	alloc.size = units * m_granularity;
+	alloc.block = block;
+	return alloc;
+}
+
+void TLSFAllocator::deallocate(uint32_t block)
+{
+	assert(block < m_blocks.size() && !m_blocks[block].is_free);
+
+	m_used -= m_blocks[block].size;
+	--m_num_allocations;
+
+	// coalesce with physical neighbours
+	const uint32_t prev = m_blocks[block].prev_phys;
+	if (prev != INVALID_BLOCK && m_blocks[prev].is_free)
+	{
+		remove_free(prev);
+		absorb(prev, block);
+		block = prev;
+	}
+
+	const uint32_t next = m_blocks[block].next_phys;
+	if (next != INVALID_BLOCK && m_blocks[next].is_free)
+	{
+		remove_free(next);
+		absorb(block, next);
+	}
+
+	insert_free(block);
+}
+
+TLSFAllocator::Report TLSFAllocator::get_report() const
+{
+	Report report{};
+	report.capacity = m_capacity;
+	report.used = m_used * m_granularity;
+	report.free = m_capacity - report.used;
+	report.allocations = m_num_allocations;
+	report.free_blocks = m_num_free_blocks;
+
+	// largest free block lives in the highest non-empty bin
+	if (m_fl_bitmap != 0)
+	{
+		const uint32_t fl = bit_msb(m_fl_bitmap);
+		const uint32_t sl = bit_msb(m_sl_bitmap[fl]);
+		uint64_t largest = 0;
+		for (uint32_t block = m_heads[fl][sl]; block != INVALID_BLOCK; block = m_blocks[block].next_free)
+			largest = m_blocks[block].size > largest ? m_blocks[block].size : largest;
+		report.largest_free = largest * m_granularity;
+	}
+
+	return report;
+}
+
+void TLSFAllocator::mapping_insert(uint64_t size, uint32_t& fl, uint32_t& sl)
+{
+	if (size < SL_COUNT)
+	{
+		fl = 0;
+		sl = (uint32_t)size;
+	}
+	else
+	{
+		const uint32_t msb = bit_msb(size);
+		fl = msb - SL_LOG2 + 1;
+		sl = (uint32_t)(size >> (msb - SL_LOG2)) ^ SL_COUNT;
+	}
+}
+
+void TLSFAllocator::mapping_search(uint64_t size, uint32_t& fl, uint32_t& sl)
+{
+	// round up to the next bin so that every block in the bin found is large enough
+	if (size >= SL_COUNT)
+	{
+		const uint64_t round = ((uint64_t)1 << (bit_msb(size) - SL_LOG2)) - 1;
+		size = size + round < size ? size : size + round;
+	}
+	mapping_insert(size, fl, sl);
+}
+
+uint32_t TLSFAllocator::find_suitable_block(uint32_t fl, uint32_t sl) const
+{
+	if (fl >= FL_COUNT)
+		return INVALID_BLOCK;
+
+	// search the current first level for a bin at least as big
+	uint32_t sl_map = m_sl_bitmap[fl] & (~0u << sl);
+	if (sl_map == 0)
+	{
+		// search the bigger first levels
+		const uint64_t fl_map = fl + 1 < 64 ? m_fl_bitmap & (~0ull << (fl + 1)) : 0;
+		if (fl_map == 0)
+			return INVALID_BLOCK;
+
+		fl = bit_lsb(fl_map);
+		sl_map = m_sl_bitmap[fl];
+	}
+	sl = bit_lsb(sl_map);
+
+	return m_heads[fl][sl];
+}
+
+void TLSFAllocator::insert_free(uint32_t block)
+{
+	uint32_t fl = 0, sl = 0;
+	mapping_insert(m_blocks[block].size, fl, sl);
+
+	auto& b = m_blocks[block];
+	b.is_free = true;
+	b.prev_free = INVALID_BLOCK;
+	b.next_free = m_heads[fl][sl];
+	if (b.next_free != INVALID_BLOCK)
+		m_blocks[b.next_free].prev_free = block;
+	m_heads[fl][sl] = block;
+
+	m_fl_bitmap |= (uint64_t)1 << fl;
+	m_sl_bitmap[fl] |= 1u << sl;
+	++m_num_free_blocks;
+}
+
+void TLSFAllocator::remove_free(uint32_t block)
+{
+	uint32_t fl = 0, sl = 0;
+	mapping_insert(m_blocks[block].size, fl, sl);
+
+	auto& b = m_blocks[block];
+	if (b.prev_free != INVALID_BLOCK)
+		m_blocks[b.prev_free].next_free = b.next_free;
+	else
+		m_heads[fl][sl] = b.next_free;
+	if (b.next_free != INVALID_BLOCK)
+		m_blocks[b.next_free].prev_free = b.prev_free;
+
+	// clear bits for emptied bins
+	if (m_heads[fl][sl] == INVALID_BLOCK)
+	{
+		m_sl_bitmap[fl] &= ~(1u << sl);
+		if (m_sl_bitmap[fl] == 0)
+			m_fl_bitmap &= ~((uint64_t)1 << fl);
+	}
+
+	b.is_free = false;
+	b.prev_free = b.next_free = INVALID_BLOCK;
+	--m_num_free_blocks;
+}
+
+uint32_t TLSFAllocator::split(uint32_t block, uint64_t size)
+{
+	assert(m_blocks[block].size > size);
+
+	// new_block may grow the container
+	const uint32_t remainder = new_block();
+	auto& b = m_blocks[block];
+	auto& r = m_blocks[remainder];
+
+	r.offset = b.offset + size;
+	r.size = b.size - size;
+	r.prev_phys = block;
+	r.next_phys = b.next_phys;
+	if (r.next_phys != INVALID_BLOCK)
+		m_blocks[r.next_phys].prev_phys = remainder;
+
+	b.size = size;
+	b.next_phys = remainder;
+
+	return remainder;
+}
+
+void TLSFAllocator::absorb(uint32_t block, uint32_t next)
+{
+	auto& b = m_blocks[block];
+	auto& n = m_blocks[next];
+	assert(b.next_phys == next);
+
+	b.size += n.size;
+	b.next_phys = n.next_phys;
+	if (b.next_phys != INVALID_BLOCK)
+		m_blocks[b.next_phys].prev_phys = block;
+
+	release_block(next);
+}
+
+uint32_t TLSFAllocator::new_block()
+{
+	uint32_t block = 0;
+	if (!m_unused_blocks.empty())
+	{
+		block = m_unused_blocks.back();
+		m_unused_blocks.pop_back();
+	}
+	else
+	{
+		block = (uint32_t)m_blocks.size();
+		m_blocks.emplace_back();
+	}
+
+	m_blocks[block] = Block{};
+	return block;
+}
+
+void TLSFAllocator::release_block(uint32_t block)
+{
+	m_blocks[block] = Block{};
+	m_unused_blocks.push_back(block);
+}
@@ -0,0 +1,105 @@
+#pragma once
+#include <stdint.h>
+#include <vector>
+
+/*
+	Two-Level Segregated Fit allocator over an abstract range of offsets [0, capacity)
+	http://www.gii.upv.es/tlsf/files/papers/ecrts04_tlsf.pdf
+
+	Allocation and deallocation are O(1):
+		- Free blocks are binned by size into a first level (power of two) and a second level (linear subdivision of the power of two)
+		- Bitmaps over both levels make finding a suitable non-empty bin a couple of bit scans
+		- Freed blocks are immediately coalesced with their free physical neighbours
+
+	The allocator does not touch any memory, it only hands out offsets, which makes it usable for anything range based
+	(placed resources in a heap, suballocations in a buffer, descriptor ranges, ...).
+	All sizes and offsets are multiples of the granularity supplied on construction.
+*/
+class TLSFAllocator
+{
+public:
+	static constexpr uint32_t INVALID_BLOCK = ~0u;
+
+	struct Allocation
+	{
+		uint64_t offset = 0;
+		uint64_t size = 0;
+		uint32_t block = INVALID_BLOCK;			// Required for deallocation
+
+		bool valid() const { return block != INVALID_BLOCK; }
+	};
+
+	struct Report
+	{
+		uint64_t capacity = 0;
+		uint64_t used = 0;
+		uint64_t free = 0;
+		uint64_t largest_free = 0;
+		uint32_t allocations = 0;
+		uint32_t free_blocks = 0;
+
+		// 0 if all free memory is in one contiguous block, approaching 1 the more scattered the free memory is
+		float fragmentation() const { return free == 0 ? 0.f : 1.f - (float)((double)largest_free / (double)free); }
+	};
+
+public:
+	TLSFAllocator(uint64_t capacity, uint64_t granularity = 1);
+	~TLSFAllocator() = default;
+
+	// Alignment must be a power of two multiple of the granularity (0 for no additional alignment)
+	Allocation allocate(uint64_t size, uint64_t alignment = 0);
+	void deallocate(uint32_t block);
+
+	Report get_report() const;
+
+	uint64_t get_capacity() const { return m_capacity; }
+	uint64_t get_used() const { return m_used * m_granularity; }
+	uint64_t get_block_size(uint32_t block) const { return m_blocks[block].size * m_granularity; }
+	bool empty() const { return m_num_allocations == 0; }
+
+private:
+	// Sizes below (1 << SL_LOG2) units are binned linearly into the first row
+	static constexpr uint32_t SL_LOG2 = 4;
+	static constexpr uint32_t SL_COUNT = 1 << SL_LOG2;
+	static constexpr uint32_t FL_COUNT = 64 - SL_LOG2 + 1;
+
+	// All sizes and offsets below are in units of granularity
+	struct Block
+	{
+		uint64_t offset = 0;
+		uint64_t size = 0;
+		uint32_t prev_phys = INVALID_BLOCK;
+		uint32_t next_phys = INVALID_BLOCK;
+		uint32_t prev_free = INVALID_BLOCK;
+		uint32_t next_free = INVALID_BLOCK;
+		bool is_free = false;
+	};
+
+private:
+	static void mapping_insert(uint64_t size, uint32_t& fl, uint32_t& sl);
+	static void mapping_search(uint64_t size, uint32_t& fl, uint32_t& sl);
+	uint32_t find_suitable_block(uint32_t fl, uint32_t sl) const;
+
+	void insert_free(uint32_t block);
+	void remove_free(uint32_t block);
+	uint32_t split(uint32_t block, uint64_t size);		// Returns the new block holding the remainder
+	void absorb(uint32_t block, uint32_t next);			// Merges next into block (physical neighbours)
+
+	uint32_t new_block();
+	void release_block(uint32_t block);
+
+private:
+	uint64_t m_capacity = 0;
+	uint64_t m_granularity = 1;
+
+	std::vector<Block> m_blocks;
+	std::vector<uint32_t> m_unused_blocks;				// Block slots which can be re-used
+
+	uint64_t m_fl_bitmap = 0;
+	uint32_t m_sl_bitmap[FL_COUNT]{};
+	uint32_t m_heads[FL_COUNT][SL_COUNT];
+
+	uint64_t m_used = 0;
+	uint32_t m_num_allocations = 0;
+	uint32_t m_num_free_blocks = 0;
+};
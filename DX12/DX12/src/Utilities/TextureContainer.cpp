@@ -0,0 +1,140 @@
+#include "pch.h"
+#include "TextureContainer.h"
+#include <algorithm>
+#include <fstream>
+
+namespace
+{
+	constexpr uint64_t DATA_ALIGNMENT = 16;
+
+	// D3D12_REQ_TEXTURE2D_U_OR_V_DIMENSION
+	constexpr uint32_t MAX_DIMENSION = 16384;
+
+	uint64_t align_up(uint64_t value, uint64_t alignment)
+	{
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
+
+	// Bytes per 4x4 block, 0 for unknown formats
+	uint32_t block_bytes(TextureContainerFormat format)
+	{
+		switch (format)
+		{
+		case TextureContainerFormat::eBC1:
+		case TextureContainerFormat::eBC4:
+			return 8;
+		case TextureContainerFormat::eBC3:
+		case TextureContainerFormat::eBC5:
+		case TextureContainerFormat::eBC7:
+			return 16;
+		default:
+			return 0;
+		}
+	}
+
+	uint32_t full_mip_count(uint32_t width, uint32_t height)
+	{
+		uint32_t count = 1;
+		while (width > 1 || height > 1)
+		{
+			width = (std::max)(width / 2, 1u);
+			height = (std::max)(height / 2, 1u);
+			++count;
+		}
+		return count;
+	}
+}
+
+bool write_texture_container(const std::filesystem::path& path, const CookedTexture& texture)
+{
+	if (texture.mips.empty() || texture.format == TextureContainerFormat::eInvalid)
+		return false;
+
+	TextureContainerHeader header{};
+	header.format = texture.format;
+	header.srgb = texture.srgb ? 1 : 0;
+	header.width = texture.mips[0].width;
+	header.height = texture.mips[0].height;
+	header.mip_count = (uint32_t)texture.mips.size();
+
+	std::vector<TextureContainerMip> mips(texture.mips.size());
+	uint64_t offset = sizeof(TextureContainerHeader) + sizeof(TextureContainerMip) * mips.size();
+	for (size_t i = 0; i < mips.size(); ++i)
+	{
+		const auto& src = texture.mips[i];
+		assert(src.data.size() == (size_t)src.row_pitch * src.num_rows);
+
+		offset = align_up(offset, DATA_ALIGNMENT);
+		mips[i].offset = offset;
+		mips[i].size = src.data.size();
+		mips[i].width = src.width;
+		mips[i].height = src.height;
+		mips[i].row_pitch = src.row_pitch;
+		mips[i].num_rows = src.num_rows;
+		offset += src.data.size();
+	}
+
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	if (!file.is_open())
+		return false;
+
+	file.write((const char*)&header, sizeof(header));
+	file.write((const char*)mips.data(), sizeof(TextureContainerMip) * mips.size());
+
+	uint64_t written = sizeof(TextureContainerHeader) + sizeof(TextureContainerMip) * mips.size();
+	const char padding[DATA_ALIGNMENT]{};
+	for (size_t i = 0; i < mips.size(); ++i)
+	{
+		file.write(padding, mips[i].offset - written);
+		file.write((const char*)texture.mips[i].data.data(), texture.mips[i].data.size());
+		written = mips[i].offset + mips[i].size;
+	}
+
+	return file.good();
+}
+
+bool TextureContainerView::parse(const uint8_t* data, size_t size)
+{
+	m_data = nullptr;
+	m_header = nullptr;
+	m_mips = nullptr;
+
+	if (!data || size < sizeof(TextureContainerHeader))
+		return false;
+
+	const auto header = (const TextureContainerHeader*)data;
+	if (header->magic != TextureContainerHeader::MAGIC || header->version != TextureContainerHeader::VERSION || header->mip_count == 0)
+		return false;
+
+	// the texture is created from the header, the mips have to describe exactly its subresources
+	const uint32_t block_size = block_bytes(header->format);
+	if (block_size == 0 || header->width == 0 || header->height == 0 || header->width > MAX_DIMENSION || header->height > MAX_DIMENSION ||
+		header->mip_count > full_mip_count(header->width, header->height))
+		return false;
+
+	const uint64_t table_end = sizeof(TextureContainerHeader) + sizeof(TextureContainerMip) * (uint64_t)header->mip_count;
+	if (table_end > size)
+		return false;
+
+	const auto mips = (const TextureContainerMip*)(data + sizeof(TextureContainerHeader));
+	for (uint32_t i = 0; i < header->mip_count; ++i)
+	{
+		const auto& mip = mips[i];
+
+		// written without sums so that crafted offsets and sizes can't wrap around
+		if (mip.offset < table_end || mip.offset > size || mip.size > size - mip.offset)
+			return false;
+
+		const uint32_t width = (std::max)(header->width >> i, 1u);
+		const uint32_t height = (std::max)(header->height >> i, 1u);
+		if (mip.width != width || mip.height != height ||
+			mip.num_rows != (height + 3) / 4 || mip.row_pitch != (width + 3) / 4 * block_size ||
+			mip.size != (uint64_t)mip.row_pitch * mip.num_rows)
+			return false;
+	}
+
+	m_data = data;
+	m_header = header;
+	m_mips = mips;
+	return true;
+}
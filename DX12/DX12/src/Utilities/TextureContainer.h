@@ -0,0 +1,87 @@
+#pragma once
+#include <stdint.h>
+#include <vector>
+#include <filesystem>
+
+/*
+	Container for cooked (pre-mipped, block compressed) textures, read straight from a memory mapped file.
+
+	Layout (little endian):
+		TextureContainerHeader
+		TextureContainerMip[mip_count]
+		mip data, each mip starting at a 16 byte aligned offset (offsets are from the start of the file)
+
+	Mip data is stored the way it is uploaded: rows of 4x4 blocks, tightly packed (row_pitch bytes per row of blocks).
+*/
+
+enum class TextureContainerFormat : uint32_t
+{
+	eInvalid,
+	eBC1,
+	eBC3,
+	eBC4,
+	eBC5,
+	eBC7
+};
+
+struct TextureContainerHeader
+{
+	static constexpr uint32_t MAGIC = 0x58455443;		// 'CTEX'
+	static constexpr uint32_t VERSION = 1;
+
+	uint32_t magic = MAGIC;
+	uint32_t version = VERSION;
+	TextureContainerFormat format = TextureContainerFormat::eInvalid;
+	uint32_t srgb = 0;
+	uint32_t width = 0;
+	uint32_t height = 0;
+	uint32_t mip_count = 0;
+	uint32_t reserved = 0;
+};
+
+struct TextureContainerMip
+{
+	uint64_t offset = 0;
+	uint64_t size = 0;
+	uint32_t width = 0;
+	uint32_t height = 0;
+	uint32_t row_pitch = 0;
+	uint32_t num_rows = 0;
+};
+
+// In-memory texture ready to be written to a container
+struct CookedTexture
+{
+	struct Mip
+	{
+		uint32_t width = 0;
+		uint32_t height = 0;
+		uint32_t row_pitch = 0;
+		uint32_t num_rows = 0;
+		std::vector<uint8_t> data;
+	};
+
+	TextureContainerFormat format = TextureContainerFormat::eInvalid;
+	bool srgb = false;
+	std::vector<Mip> mips;
+};
+
+bool write_texture_container(const std::filesystem::path& path, const CookedTexture& texture);
+
+/*
+	Non-owning view over container bytes (e.g a MappedFile), validates the header and mip table on parse.
+*/
+class TextureContainerView
+{
+public:
+	bool parse(const uint8_t* data, size_t size);
+
+	const TextureContainerHeader& header() const { return *m_header; }
+	const TextureContainerMip& mip(uint32_t idx) const { return m_mips[idx]; }
+	const uint8_t* mip_data(uint32_t idx) const { return m_data + m_mips[idx].offset; }
+
+private:
+	const uint8_t* m_data = nullptr;
+	const TextureContainerHeader* m_header = nullptr;
+	const TextureContainerMip* m_mips = nullptr;
+};
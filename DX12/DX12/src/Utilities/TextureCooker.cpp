@@ -0,0 +1,116 @@
+#include "pch.h"
+#include "TextureCooker.h"
+#include "BCEncoder.h"
+#include "MipGenerator.h"
+#include <algorithm>
+
+namespace
+{
+	MipLevel pad_to_blocks(const uint8_t* rgba, uint32_t width, uint32_t height)
+	{
+		MipLevel img{};
+		img.width = (width + 3) & ~3u;
+		img.height = (height + 3) & ~3u;
+		img.rgba.resize((size_t)img.width * img.height * 4);
+		for (uint32_t y = 0; y < img.height; ++y)
+			for (uint32_t x = 0; x < img.width; ++x)
+			{
+				const size_t src = ((size_t)(std::min)(y, height - 1) * width + (std::min)(x, width - 1)) * 4;
+				std::copy_n(rgba + src, 4, &img.rgba[((size_t)y * img.width + x) * 4]);
+			}
+		return img;
+	}
+
+	TextureContainerFormat pick_format(const uint8_t* rgba, size_t num_texels, const TextureCookDesc& desc)
+	{
+		switch (desc.role)
+		{
+		case TextureRole::eNormal:
+			return TextureContainerFormat::eBC5;
+		case TextureRole::eMask:
+			return TextureContainerFormat::eBC4;
+		default:
+			break;
+		}
+
+		if (!desc.fast)
+			return TextureContainerFormat::eBC7;
+
+		for (size_t i = 0; i < num_texels; ++i)
+			if (rgba[i * 4 + 3] != 255)
+				return TextureContainerFormat::eBC3;
+		return TextureContainerFormat::eBC1;
+	}
+
+	uint32_t block_bytes(TextureContainerFormat format)
+	{
+		switch (format)
+		{
+		case TextureContainerFormat::eBC1: return bc::BC1_BLOCK_BYTES;
+		case TextureContainerFormat::eBC3: return bc::BC3_BLOCK_BYTES;
+		case TextureContainerFormat::eBC4: return bc::BC4_BLOCK_BYTES;
+		case TextureContainerFormat::eBC5: return bc::BC5_BLOCK_BYTES;
+		case TextureContainerFormat::eBC7: return bc::BC7_BLOCK_BYTES;
+		default:
+			assert(false);
+			return 0;
+		}
+	}
+
+	CookedTexture::Mip encode(const MipLevel& img, TextureContainerFormat format)
+	{
+		CookedTexture::Mip mip{};
+		mip.width = img.width;
+		mip.height = img.height;
+		const uint32_t blocks_x = (img.width + 3) / 4, blocks_y = (img.height + 3) / 4;
+		mip.row_pitch = blocks_x * block_bytes(format);
+		mip.num_rows = blocks_y;
+		mip.data.resize((size_t)mip.row_pitch * mip.num_rows);
+
+		uint8_t block[16 * 4];
+		for (uint32_t by = 0; by < blocks_y; ++by)
+		{
+			for (uint32_t bx = 0; bx < blocks_x; ++bx)
+			{
+				// mips smaller than a block repeat the edge
+				for (uint32_t y = 0; y < 4; ++y)
+					for (uint32_t x = 0; x < 4; ++x)
+					{
+						const uint32_t sx = (std::min)(bx * 4 + x, img.width - 1), sy = (std::min)(by * 4 + y, img.height - 1);
+						std::copy_n(&img.rgba[((size_t)sy * img.width + sx) * 4], 4, &block[(y * 4 + x) * 4]);
+					}
+
+				uint8_t* out = &mip.data[(size_t)by * mip.row_pitch + (size_t)bx * block_bytes(format)];
+				switch (format)
+				{
+				case TextureContainerFormat::eBC1: bc::encode_bc1(block, out); break;
+				case TextureContainerFormat::eBC3: bc::encode_bc3(block, out); break;
+				case TextureContainerFormat::eBC4: bc::encode_bc4(block, 4, out); break;
+				case TextureContainerFormat::eBC5: bc::encode_bc5(block, out); break;
+				case TextureContainerFormat::eBC7: bc::encode_bc7(block, out); break;
+				default: assert(false);
+				}
+			}
+		}
+		return mip;
+	}
+}
+
+CookedTexture cook_texture(const uint8_t* rgba, uint32_t width, uint32_t height, const TextureCookDesc& desc)
+{
+	assert(rgba && width > 0 && height > 0);
+
+	CookedTexture cooked{};
+	cooked.format = pick_format(rgba, (size_t)width * height, desc);
+	cooked.srgb = desc.srgb && (cooked.format == TextureContainerFormat::eBC1 || cooked.format == TextureContainerFormat::eBC3 || cooked.format == TextureContainerFormat::eBC7);
+
+	MipGenDesc mip_desc{};
+	mip_desc.filter = desc.mip_filter;
+	mip_desc.srgb = cooked.srgb;
+	mip_desc.normal_map = desc.role == TextureRole::eNormal;
+
+	const auto img = pad_to_blocks(rgba, width, height);
+	for (const auto& level : generate_mip_chain(img.rgba.data(), img.width, img.height, mip_desc))
+		cooked.mips.push_back(encode(level, cooked.format));
+	return cooked;
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include "TextureContainer.h"
+#include "MipGenerator.h"
+
+/*
+	Offline texture cooking (std only, runs on the build machines): full mip chain + block compression.
+
+	The block format is picked from the role of the map:
+		eColor:		BC7 (BC1 if opaque / BC3 with alpha when fast)
+		eNormal:	BC5 (XY, Z is reconstructed in the shader)
+		eMask:		BC4 (R only, e.g opacity/specular)
+
+	Mips are generated on the CPU (MipGenerator), normal maps are renormalized per level.
+	Top level dimensions are padded to a multiple of 4 (edge texels repeated) as required for block compressed resources.
+*/
+
+enum class TextureRole
+{
+	eColor,
+	eNormal,
+	eMask
+};
+
+struct TextureCookDesc
+{
+	TextureRole role = TextureRole::eColor;
+	bool srgb = false;			// matches TextureFlag::eSRGB, mips are filtered in linear space
+	bool fast = false;			// BC1/BC3 instead of BC7 for color maps
+	MipFilter mip_filter = MipFilter::eKaiser;
+};
+
+// rgba: width * height RGBA8 texels, row-major and tightly packed
+CookedTexture cook_texture(const uint8_t* rgba, uint32_t width, uint32_t height, const TextureCookDesc& desc);
@@ -0,0 +1,70 @@
+#include "pch.h"
+#include "TextureSlotState.h"
+
+void TextureSlotState::acquire(const std::string& path, uint64_t content_hash_)
+{
+	refs = 1;
+	content_hash = content_hash_;
+	paths.assign(1, { path, 1 });
+
+	// left over from the previous texture in this slot
+	uploads_in_flight = 0;
+	destroyed = false;
+}
+
+void TextureSlotState::add_ref(const std::string& path)
+{
+	++refs;
+	for (auto& loaded : paths)
+		if (loaded.path == path)
+			++loaded.refs;
+}
+
+void TextureSlotState::add_path(const std::string& path)
+{
+	++refs;
+	paths.push_back({ path, 1 });
+}
+
+bool TextureSlotState::release(std::vector<std::string>& unreferenced)
+{
+	assert(refs > 0);
+	if (--refs == 0)
+	{
+		for (auto& loaded : paths)
+			unreferenced.push_back(std::move(loaded.path));
+		paths.clear();
+		return true;
+	}
+
+	uint32_t path_refs = 0;
+	for (const auto& loaded : paths)
+		path_refs += loaded.refs;
+	if (path_refs > refs && --paths.back().refs == 0)
+	{
+		unreferenced.push_back(std::move(paths.back().path));
+		paths.pop_back();
+	}
+	return false;
+}
+
+bool TextureSlotState::retire()
+{
+	assert(refs == 0);
+	if (uploads_in_flight == 0)
+		return true;
+
+	destroyed = true;
+	return false;
+}
+
+void TextureSlotState::begin_upload()
+{
+	++uploads_in_flight;
+}
+
+bool TextureSlotState::end_upload()
+{
+	assert(uploads_in_flight > 0);
+	return --uploads_in_flight == 0 && destroyed;
+}
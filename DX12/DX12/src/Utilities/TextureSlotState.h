@@ -0,0 +1,53 @@
+#pragma once
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/*
+	Lifetime bookkeeping of a loaded texture (std only), DXTextureManager keeps one per texture handle.
+
+	A texture is referenced by every create_* which resolved to it, counted per path (the path it was loaded from and
+	any other path with the same contents). Uploads in flight (async decodes, streaming re-uploads) hold it as well:
+	a texture whose last reference is released while uploads are in flight is marked destroyed and freed with the last upload.
+
+	The handle pool reuses slots without reconstructing them, acquire resets all of it.
+*/
+struct TextureSlotState
+{
+	struct LoadedPath
+	{
+		std::string path;
+		uint32_t refs = 0;				// handed out for this path
+	};
+
+	uint32_t refs = 0;					// including references handed out without a path (e.g the default texture)
+	uint64_t content_hash = 0;
+	std::vector<LoadedPath> paths;		// resolving to this texture in load order, the first is the one loaded
+
+	uint32_t uploads_in_flight = 0;		// decodes and (re-)uploads which will swap in a new resource
+	bool destroyed = false;				// freed once the last upload lands
+
+	// Newly loaded from path (slot just taken from the handle pool), holds one reference
+	void acquire(const std::string& path, uint64_t content_hash);
+
+	// Another reference through a path resolving to this texture (or without a path if empty)
+	void add_ref(const std::string& path);
+
+	// A reference through another path with the same contents
+	void add_path(const std::string& path);
+
+	/*
+		Releases a reference, returns true if it was the last one.
+		Paths left without references are appended to unreferenced (every path on the last reference).
+		Handles don't carry their path: references without one go first, then the most recently added path.
+	*/
+	bool release(std::vector<std::string>& unreferenced);
+
+	// After the last reference: true if the texture can be freed now, otherwise it is marked destroyed
+	bool retire();
+
+	void begin_upload();
+
+	// True if this was the last upload of a destroyed texture, which can be freed now
+	bool end_upload();
+};
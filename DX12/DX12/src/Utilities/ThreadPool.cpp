@@ -0,0 +1,74 @@
+#include "pch.h"
+#include "ThreadPool.h"
+
+ThreadPool::ThreadPool(uint32_t num_threads)
+{
+	if (num_threads == 0)
+		num_threads = (std::max)(std::thread::hardware_concurrency(), 2u) - 1;
+
+	m_threads.reserve(num_threads);
+	for (uint32_t i = 0; i < num_threads; ++i)
+		m_threads.emplace_back([this]() { worker_loop(); });
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+	m_job_available.notify_all();
+
+	for (auto& thread : m_threads)
+		thread.join();
+}
+
+void ThreadPool::submit(std::function<void()>&& job)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		assert(!m_stop);
+		m_jobs.push(std::move(job));
+	}
+	m_job_available.notify_one();
+}
+
+void ThreadPool::wait_idle()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_idle.wait(lock, [this]() { return m_jobs.empty() && m_num_running == 0; });
+}
+
+uint32_t ThreadPool::num_threads() const
+{
+	return (uint32_t)m_threads.size();
+}
+
+void ThreadPool::worker_loop()
+{
+	while (true)
+	{
+		std::function<void()> job;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_job_available.wait(lock, [this]() { return m_stop || !m_jobs.empty(); });
+
+			// drain the queue before stopping
+			if (m_jobs.empty())
+				return;
+
+			job = std::move(m_jobs.front());
+			m_jobs.pop();
+			++m_num_running;
+		}
+
+		job();
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			--m_num_running;
+			if (m_jobs.empty() && m_num_running == 0)
+				m_idle.notify_all();
+		}
+	}
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include <stdint.h>
+#include <vector>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+/*
+	Fixed set of worker threads consuming a shared FIFO of jobs.
+
+	Jobs must not throw. The pool finishes all queued jobs before joining on destruction,
+	anything a job references must outlive the pool or be waited for with wait_idle().
+*/
+class ThreadPool
+{
+public:
+	// 0 threads uses all hardware threads but one (the calling thread)
+	ThreadPool(uint32_t num_threads = 0);
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	void submit(std::function<void()>&& job);
+
+	// Blocks until the queue is empty and no job is running
+	void wait_idle();
+
+	uint32_t num_threads() const;
+
+private:
+	void worker_loop();
+
+private:
+	std::vector<std::thread> m_threads;
+
+	std::mutex m_mutex;
+	std::condition_variable m_job_available;
+	std::condition_variable m_idle;
+	std::queue<std::function<void()>> m_jobs;
+	uint32_t m_num_running = 0;
+	bool m_stop = false;
+};
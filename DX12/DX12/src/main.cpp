@@ -18,6 +18,7 @@ extern "C" { __declspec(dllexport) extern const char* D3D12SDKPath = u8"..\\..\\
 #include "WinPixEventRuntime/pix3.h"
 #include "Profiler/GPUProfiler.h"
 #include "Profiler/CPUProfiler.h"
+#include "Profiler/AllocatorTelemetry.h"
 
 #include "DXTK/SimpleMath.h"
 
@@ -28,6 +29,7 @@ extern "C" { __declspec(dllexport) extern const char* D3D12SDKPath = u8"..\\..\\
 #include "Utilities/Input.h"
 #include "Utilities/AssimpLoader.h"
 #include "Utilities/HandlePool.h"
+#include "Utilities/ThreadPool.h"
 
 #include "Graphics/DX/DXBufferManager.h"
 
@@ -35,6 +37,9 @@ extern "C" { __declspec(dllexport) extern const char* D3D12SDKPath = u8"..\\..\\
 
 #include "Graphics/DX/Descriptor/DXDescriptorHeapCPU.h"
 #include "Graphics/DX/Descriptor/DXDescriptorHeapGPU.h"
+#include "Graphics/DX/Descriptor/DXDescriptorSlab.h"
+#include "Graphics/DX/Descriptor/DXViewCache.h"
+#include "Graphics/DX/Descriptor/DXDescriptorStager.h"
 
 #include "Graphics/DX/DXUploadContext.h"
 
@@ -49,6 +54,7 @@ extern "C" { __declspec(dllexport) extern const char* D3D12SDKPath = u8"..\\..\\
 #include "Camera/FPPCamera.h"
 
 #include <numeric>
+#include <algorithm>
 
 
 
@@ -152,8 +158,8 @@ int main()
 
 		DXDescriptorHeapCPU cpu_rtv_dheap(dev, D3D12_DESCRIPTOR_HEAP_TYPE_RTV);
 		DXDescriptorHeapCPU cpu_dsv_dheap(dev, D3D12_DESCRIPTOR_HEAP_TYPE_DSV);
-		DXDescriptorHeapGPU gpu_dheap(dev, D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, 50000);
-		DXDescriptorHeapGPU gpu_dheap_sampler(dev, D3D12_DESCRIPTOR_HEAP_TYPE_SAMPLER, 2040);
+		DXDescriptorHeapGPU gpu_dheap(dev, D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, 50000, max_FIF);
+		DXDescriptorHeapGPU gpu_dheap_sampler(dev, D3D12_DESCRIPTOR_HEAP_TYPE_SAMPLER, 2040, max_FIF);
 
 		// setup profiler
 		dev->SetStablePowerState(true);
@@ -182,12 +188,18 @@ int main()
 		auto bindless_part = gpu_dheap.allocate_static(5000);
 
 		// setup various managers
-		DXBufferManager buf_mgr(dev, max_FIF);
+		DXRetirementService retirement(dev);
+
+		DXBufferManager buf_mgr(dev, max_FIF, &retirement);
+
 		DXUploadContext up_ctx(dev, &buf_mgr, max_FIF, &gpu_pf_copy);
-		DXTextureManager tex_mgr(dev, dq);
-		DXBindlessManager bindless_mgr(dev, std::move(bindless_part), &buf_mgr, &tex_mgr);
-		MeshManager mesh_mgr(dev, &buf_mgr, MAX_FIF);
-		ModelManager model_mgr(&mesh_mgr, &tex_mgr, &bindless_mgr);
+		ThreadPool workers;
+		DXTextureManager tex_mgr(dev, dq, &workers, &retirement);
+		DXDescriptorStager view_stager(dev, D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+		DXViewCache view_cache(dev, std::move(bindless_part), &retirement, &view_stager);
+		DXBindlessManager bindless_mgr(dev, &view_cache, &buf_mgr, &up_ctx, &tex_mgr, &retirement);
+		MeshManager mesh_mgr(dev, &buf_mgr);
+		ModelManager model_mgr(&mesh_mgr, &tex_mgr, &bindless_mgr, &workers);
 
 		struct PerFrameResource
 		{
@@ -301,6 +313,15 @@ int main()
 		bool profile_buf_alloc = false;
 		bool is_sub_alloc = true;
 		int alloc_work = 25;
+		double buf_alloc_avg_us = 0.0;		// avg. time of a single create/destroy pair in the allocation profiling loop
+		bool profile_desc_slabs = false;
+		int desc_threads = 4;
+		double desc_slab_allocs_per_us = 0.0;		// transient descriptor throughput over all threads (per-thread slabs)
+		double desc_locked_allocs_per_us = 0.0;		// transient descriptor throughput over all threads (shared locked heap)
+		uptr<DXDescriptorHeapGPU> desc_bench_heap;		// created on first use
+		uptr<ThreadPool> desc_bench_workers;
+		bool texture_streaming = false;
+		int streaming_budget_mb = 64;
 		g_gui_ctx->add_persistent_ui("test", [&]()
 			{
 				ImGui::Begin("Settings");
@@ -317,6 +338,14 @@ int main()
 				ImGui::Checkbox("Profile Buffer Allocation", &profile_buf_alloc);
 				ImGui::Checkbox("[X] Sub-alloc // [ ] Committed ", &is_sub_alloc);
 				ImGui::SliderInt("Alloc Work", &alloc_work, 1, 500);
+				if (profile_buf_alloc)
+					ImGui::Text(fmt::format("Create/Destroy avg: {:.3f} us", buf_alloc_avg_us).c_str());
+				ImGui::Checkbox("Profile Descriptor Slabs", &profile_desc_slabs);
+				ImGui::SliderInt("Recording Threads", &desc_threads, 1, 8);
+				if (profile_desc_slabs)
+					ImGui::Text(fmt::format("Descriptors/us: {:.1f} slabs // {:.1f} locked heap", desc_slab_allocs_per_us, desc_locked_allocs_per_us).c_str());
+				ImGui::Checkbox("Texture Streaming", &texture_streaming);
+				ImGui::SliderInt("Streaming Budget (MB)", &streaming_budget_mb, 1, 512);
 
 				ImGui::End();
 			});
@@ -359,6 +388,51 @@ int main()
 				ImGui::End();
 			});
 
+		// setup allocator telemetry (dumped to file on exit)
+		AllocatorTelemetry mem_telemetry;
+		mem_telemetry.add_source("Buffers", [&]() { return buf_mgr.get_allocator_stats(); });
+		mem_telemetry.add_source("Descriptors", [&]()
+			{
+				return std::vector<NamedAllocatorStats>
+				{
+					{ "GPU Static", gpu_dheap.get_static_stats() },
+					{ "GPU Dynamic", gpu_dheap.get_dynamic_stats() },
+					{ "Bindless Views", view_cache.get_allocator_stats() },
+				};
+			});
+		g_gui_ctx->add_persistent_ui("Memory", [&]()
+			{
+				ImGui::Begin("Memory");
+				const auto& view_stats = view_cache.get_stats();
+				ImGui::Text(fmt::format("View cache: {} views (hits: {}, misses: {})", view_stats.views_in_use, view_stats.hits, view_stats.misses).c_str());
+				ImGui::Text(fmt::format("Textures loading: {}", tex_mgr.num_pending()).c_str());
+				const auto dedup_stats = tex_mgr.get_dedup_stats();
+				ImGui::Text(fmt::format("Texture dedup: {} hits, {:.2f} MB VRAM and {:.1f} ms decode avoided", dedup_stats.hits, dedup_stats.vram_bytes_avoided / (1024.0 * 1024.0), dedup_stats.decode_ms_avoided).c_str());
+				for (const auto& load : model_mgr.get_load_stats())
+				{
+					if (load.from_cache)
+						ImGui::Text(fmt::format("Model {}: {:.1f} ms (mesh cache)", load.rel_path.stem().string(), load.total_ms).c_str());
+					else
+						ImGui::Text(fmt::format("Model {}: {:.1f} ms (import {:.1f} ms serial, extraction {:.1f} ms on {} threads)", load.rel_path.stem().string(), load.total_ms, load.import_ms, load.extract_ms, load.extract_threads).c_str());
+				}
+				const auto& streaming_stats = tex_mgr.get_streaming_stats();
+				ImGui::Text(fmt::format("Texture streaming: {:.2f} / {:.2f} MB requested ({} of {} textures over budget)", streaming_stats.bytes_resident / (1024.0 * 1024.0), streaming_stats.bytes_requested / (1024.0 * 1024.0), streaming_stats.num_over_budget, streaming_stats.num_textures).c_str());
+				for (const auto& entry : mem_telemetry.get_entries())
+				{
+					const auto& stats = entry.stats;
+					if (!ImGui::CollapsingHeader(entry.name.c_str()))
+						continue;
+
+					ImGui::Text(fmt::format("In use: {:.2f} / {:.2f} MB (high: {:.2f} MB)", stats.bytes_in_use / (1024.0 * 1024.0), stats.capacity_bytes / (1024.0 * 1024.0), stats.bytes_high_water / (1024.0 * 1024.0)).c_str());
+					ImGui::Text(fmt::format("Elements: {} (high: {})", stats.elements_in_use, stats.elements_high_water).c_str());
+					ImGui::Text(fmt::format("Fragmentation: {:.2f} (largest free: {:.2f} MB)", stats.fragmentation(), stats.largest_free_bytes / (1024.0 * 1024.0)).c_str());
+					ImGui::Text(fmt::format("Allocs/frame: {} (avg: {:.1f}, peak: {})", entry.allocs_last_frame, entry.allocs_avg_frame, entry.allocs_peak_frame).c_str());
+					if (stats.allocation_failures > 0)
+						ImGui::TextColored(ImVec4(1.f, 0.f, 0.f, 1.f), fmt::format("Failures: {}", stats.allocation_failures).c_str());
+				}
+				ImGui::End();
+			});
+
 
 
 
@@ -416,6 +490,7 @@ int main()
 				.push_srv(4, 5, D3D12_SHADER_VISIBILITY_VERTEX, &params["my_bitangent"])
 
 				.push_srv(3, 0, D3D12_SHADER_VISIBILITY_PIXEL, &params["rt_structure"])
+				.push_srv(0, 8, D3D12_SHADER_VISIBILITY_PIXEL, &params["material_table"])
 
 				.push_cbv(7, 7, D3D12_SHADER_VISIBILITY_ALL, &params["camera_data"])		// we want access in VS and PS
 
@@ -484,13 +559,13 @@ int main()
 		cdb.usage_gpu = UsageIntentGPU::eReadOncePerFrame;
 		auto cam_buf = buf_mgr.create_buffer(cdb);
 
-		// object cbuf (ring buffered dynamic)
+		// object cbuf (streamed, new version per draw)
 		DXBufferDesc dyn_cbd{};
 		dyn_cbd.element_count = 1;
 		dyn_cbd.element_size = (uint32_t)sizeof(DirectX::XMFLOAT4X4);
 		dyn_cbd.flag = BufferFlag::eConstant;
-		dyn_cbd.usage_cpu = UsageIntentCPU::eUpdateOnce;
-		dyn_cbd.usage_gpu = UsageIntentGPU::eReadOncePerFrame;
+		dyn_cbd.usage_cpu = UsageIntentCPU::eUpdateMultipleTimesPerFrame;
+		dyn_cbd.usage_gpu = UsageIntentGPU::eReadMultipleTimesPerFrame;
 		auto dyn_cb = buf_mgr.create_buffer(dyn_cbd);
 
 		/*
@@ -626,6 +701,8 @@ int main()
 			if (profile_buf_alloc)
 			{
 				cpu_pf.profile_begin("buf allocation");
+				Stopwatch buf_alloc_sw;
+				buf_alloc_sw.start();
 
 				if (is_sub_alloc)
 				{
@@ -660,6 +737,11 @@ int main()
 					}
 				}
 
+				buf_alloc_sw.stop();
+				// smooth over frames to get a readable number
+				const double curr_avg_us = buf_alloc_sw.elapsed(Stopwatch::Unit::eMillisecond) * 1000.0 / alloc_work;
+				buf_alloc_avg_us = buf_alloc_avg_us == 0.0 ? curr_avg_us : buf_alloc_avg_us * 0.95 + curr_avg_us * 0.05;
+
 				cpu_pf.profile_end("buf allocation");
 			}
 
@@ -788,8 +870,92 @@ int main()
 			buf_mgr.frame_begin((uint32_t)frame_idx);
 			mesh_mgr.frame_begin((uint32_t)frame_idx);
 
+			view_cache.frame_begin();
 			bindless_mgr.frame_begin((uint32_t)frame_idx);
 
+			// texture residency from the distance to every part of the (single instance) sponza
+			{
+				const auto active_cam = cam_ctrl->get_active_camera();
+				tex_mgr.set_streaming(texture_streaming, (uint64_t)streaming_budget_mb * 1024 * 1024);
+				tex_mgr.set_streaming_view({ active_cam->get_proj_mat()._22, (float)CLIENT_HEIGHT });
+
+				const auto& cam_pos = active_cam->get_position();
+				const auto& model = model_mgr.get_model(sponza_model);
+				for (size_t i = 0; i < model->part_bounds.size(); ++i)
+				{
+					const auto& bounds = model->part_bounds[i];
+					const auto center = DirectX::SimpleMath::Vector3(bounds.Center) * scale;
+					const float distance = DirectX::SimpleMath::Vector3::Distance(DirectX::SimpleMath::Vector3(cam_pos.x, cam_pos.y, cam_pos.z), center);
+
+					const auto& textures = model->mats[i].textures;
+					for (const auto& tex : { textures.diffuse_tex, textures.normal_tex, textures.specular_tex, textures.opacity_tex })
+						tex_mgr.request_residency(tex, distance, bounds.Radius * scale);
+				}
+			}
+			bindless_mgr.on_textures_resident(tex_mgr.frame_begin());
+			view_stager.flush();		// views registered since last frame land in the bindless range
+
+			// transient descriptor allocation from multiple threads: per-thread slabs vs. going through the shared heap
+			// runs on its own heap and threads, so the frame's dynamic descriptors aren't touched
+			if (profile_desc_slabs)
+			{
+				cpu_pf.profile_begin("descriptor slabs");
+				constexpr int max_desc_threads = 8;
+				constexpr int allocs_per_thread = 256;
+				if (!desc_bench_heap)
+				{
+					// both runs of a frame fit, for every frame in flight (slabs waste at most a slab per thread and run)
+					const uint32_t per_frame = 2 * max_desc_threads * (allocs_per_thread + 64);
+					desc_bench_heap = std::make_unique<DXDescriptorHeapGPU>(dev, D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, 2 * per_frame * max_FIF, max_FIF);
+					desc_bench_workers = std::make_unique<ThreadPool>(max_desc_threads);
+				}
+				desc_bench_heap->frame_begin((uint32_t)frame_idx);
+
+				// one cache line per thread
+				struct alignas(64) ThreadResult
+				{
+					double elapsed_us = 0.0;
+					uint64_t sink = 0;
+				};
+				std::array<ThreadResult, max_desc_threads> results{};
+
+				auto run = [&](bool use_slabs)
+				{
+					const int num_threads = (std::min)(desc_threads, max_desc_threads);
+					for (int t = 0; t < num_threads; ++t)
+					{
+						desc_bench_workers->submit([&, t, use_slabs]()
+							{
+								DXDescriptorSlab slab(desc_bench_heap.get(), DXDescriptorSlab::Source::eDynamic, 64);
+								uint64_t sink = 0;
+								Stopwatch sw;
+								sw.start();
+								for (int i = 0; i < allocs_per_thread; ++i)
+								{
+									auto alloc = use_slabs ? slab.allocate(1) : desc_bench_heap->allocate_dynamic(1);
+									sink += alloc.offset_from_base();
+								}
+								sw.stop();
+								results[t].elapsed_us = sw.elapsed(Stopwatch::Unit::eMillisecond) * 1000.0;
+								results[t].sink = sink;
+							});
+					}
+					desc_bench_workers->wait_idle();
+
+					// limited by the slowest thread
+					double slowest_us = 0.0;
+					for (int t = 0; t < num_threads; ++t)
+						slowest_us = (std::max)(slowest_us, results[t].elapsed_us);
+					return slowest_us > 0.0 ? (double)(num_threads * allocs_per_thread) / slowest_us : 0.0;
+				};
+
+				const auto slab_rate = run(true);
+				const auto locked_rate = run(false);
+				desc_slab_allocs_per_us = desc_slab_allocs_per_us == 0.0 ? slab_rate : desc_slab_allocs_per_us * 0.95 + slab_rate * 0.05;
+				desc_locked_allocs_per_us = desc_locked_allocs_per_us == 0.0 ? locked_rate : desc_locked_allocs_per_us * 0.95 + locked_rate * 0.05;
+				cpu_pf.profile_end("descriptor slabs");
+			}
+
 
 			cptr<ID3D12GraphicsCommandList5> dxr_cmdl;
 			auto hr = dq_cmdl->QueryInterface(IID_PPV_ARGS(dxr_cmdl.GetAddressOf()));
@@ -947,6 +1113,7 @@ int main()
 			// per frame
 			dq_cmdl->SetGraphicsRootDescriptorTable(params["my_samp"], samp_desc.gpu_handle());
 			dq_cmdl->SetGraphicsRootDescriptorTable(params["bindless_views"], bindless_mgr.get_views_start());
+			buf_mgr.bind_as_direct_arg(dq_cmdl, bindless_mgr.get_material_table(), params["material_table"], RootArgDest::eGraphics);
 			buf_mgr.bind_as_direct_arg(dq_cmdl, cam_buf, params["camera_data"], RootArgDest::eGraphics);
 			buf_mgr.bind_as_direct_arg(dq_cmdl, settings_cb, params["settings"], RootArgDest::eGraphics);
 
@@ -982,8 +1149,7 @@ int main()
 						{
 							// per object
 							auto wm = DirectX::SimpleMath::Matrix::CreateScale(scale) * DirectX::SimpleMath::Matrix::CreateTranslation(x * 350.f, 0.f, i * 200.f);
-							up_ctx.upload_data(&wm, sizeof(wm), dyn_cb);
-							buf_mgr.bind_as_direct_arg(dq_cmdl, dyn_cb, params["per_object"], RootArgDest::eGraphics);
+							dq_cmdl->SetGraphicsRootConstantBufferView(params["per_object"], buf_mgr.stream_constant(dyn_cb, &wm, sizeof(wm)));
 							for (int i = 0; i < sponza_mesh->parts.size(); ++i)
 							{
 								const auto& part = sponza_mesh->parts[i];
@@ -1007,8 +1173,7 @@ int main()
 				{
 					// per object
 					auto wm = DirectX::SimpleMath::Matrix::CreateScale(scale);
-					up_ctx.upload_data(&wm, sizeof(wm), dyn_cb);
-					buf_mgr.bind_as_direct_arg(dq_cmdl, dyn_cb, params["per_object"], RootArgDest::eGraphics);
+					dq_cmdl->SetGraphicsRootConstantBufferView(params["per_object"], buf_mgr.stream_constant(dyn_cb, &wm, sizeof(wm)));
 					for (int i = 0; i < sponza_mesh->parts.size(); ++i)
 					{
 						const auto& part = sponza_mesh->parts[i];
@@ -1050,8 +1215,7 @@ int main()
 				for (int i = -40; i < 40; i += 8)
 				{
 					auto wm = DirectX::SimpleMath::Matrix::CreateScale(0.7f) * DirectX::SimpleMath::Matrix::CreateTranslation({(float)i, 0.f, 0.f});
-					up_ctx.upload_data(&wm, sizeof(wm), dyn_cb);
-					buf_mgr.bind_as_direct_arg(dq_cmdl, dyn_cb, params["per_object"], RootArgDest::eGraphics);
+					dq_cmdl->SetGraphicsRootConstantBufferView(params["per_object"], buf_mgr.stream_constant(dyn_cb, &wm, sizeof(wm)));
 					for (int i = 0; i < mesh->parts.size(); ++i)
 					{
 						const auto& part = mesh->parts[i];
@@ -1117,6 +1281,7 @@ int main()
 
 			// signal when this frame is no longer in flight
 			frame_res.sync.signal(dq, (UINT)gfx_ctx->get_next_fence_value());
+			retirement.frame_end(dq);
 
 			frame_res.prev_surface_idx = surface_idx;
 
@@ -1128,6 +1293,8 @@ int main()
 			cpu_pf.profile_end("cpu frame");
 			cpu_pf.frame_end();
 
+			mem_telemetry.frame_end();
+
 			++frame_count;
 
 
@@ -1137,6 +1304,8 @@ int main()
 		for (const auto& frame_res : per_frame_res)
 			frame_res.sync.wait();
 
+		mem_telemetry.dump_json("allocator_stats.json");
+
 
 		delete s_mems;
 		delete g_input;
@@ -0,0 +1,3 @@
+#pragma once
+// Stand-in for the engine's DXCommon.h, DXDescriptorPool only needs the D3D12 types
+#include <d3d12.h>
@@ -0,0 +1,71 @@
+#pragma once
+#include <stdint.h>
+#include <atomic>
+/*
+	Stand-in for the few D3D12 types DXDescriptorPool touches, so that the shipped pool builds and runs without a device.
+	Must come first on the include path (before src/ and any SDK) so that <d3d12.h> resolves here.
+
+	The "device" creates heaps at fixed fake addresses, descriptors are never written.
+*/
+
+typedef long HRESULT;
+#define FAILED(hr) (((HRESULT)(hr)) < 0)
+#define IID_PPV_ARGS(pp) 0, (void**)(pp)
+
+struct D3D12_CPU_DESCRIPTOR_HANDLE { size_t ptr; };
+struct D3D12_GPU_DESCRIPTOR_HANDLE { uint64_t ptr; };
+
+enum D3D12_DESCRIPTOR_HEAP_TYPE
+{
+	D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV,
+	D3D12_DESCRIPTOR_HEAP_TYPE_SAMPLER,
+	D3D12_DESCRIPTOR_HEAP_TYPE_RTV,
+	D3D12_DESCRIPTOR_HEAP_TYPE_DSV,
+	D3D12_DESCRIPTOR_HEAP_TYPE_NUM_TYPES
+};
+
+enum D3D12_DESCRIPTOR_HEAP_FLAGS
+{
+	D3D12_DESCRIPTOR_HEAP_FLAG_NONE = 0,
+	D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE = 1
+};
+
+struct D3D12_DESCRIPTOR_HEAP_DESC
+{
+	D3D12_DESCRIPTOR_HEAP_TYPE Type;
+	uint32_t NumDescriptors;
+	D3D12_DESCRIPTOR_HEAP_FLAGS Flags;
+	uint32_t NodeMask;
+};
+
+struct FakeUnknown
+{
+	virtual ~FakeUnknown() = default;
+	unsigned long AddRef() { return ++refs; }
+	unsigned long Release() { const auto left = --refs; if (left == 0) delete this; return left; }
+	std::atomic<unsigned long> refs{ 1 };
+};
+
+struct ID3D12DescriptorHeap : FakeUnknown
+{
+	static constexpr size_t CPU_START = 0x10000;
+	static constexpr uint64_t GPU_START = 0x100000000;
+
+	D3D12_DESCRIPTOR_HEAP_DESC desc{};
+
+	D3D12_CPU_DESCRIPTOR_HANDLE GetCPUDescriptorHandleForHeapStart() { return { CPU_START }; }
+	D3D12_GPU_DESCRIPTOR_HANDLE GetGPUDescriptorHandleForHeapStart() { return { desc.Flags & D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE ? GPU_START : 0 }; }
+};
+
+struct ID3D12Device : FakeUnknown
+{
+	uint32_t GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE type) { return type == D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV ? 32 : 16; }
+
+	HRESULT CreateDescriptorHeap(const D3D12_DESCRIPTOR_HEAP_DESC* desc, int, void** heap)
+	{
+		auto created = new ID3D12DescriptorHeap();
+		created->desc = *desc;
+		*heap = created;
+		return 0;
+	}
+};
@@ -0,0 +1,489 @@
+#include "pch.h"
+#include "Graphics/DX/Descriptor/DXDescriptorPool.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iterator>
+#include <map>
+#include <random>
+
+/*
+	Fuzz test and benchmark of DXDescriptorPool (std-only, runs anywhere).
+
+	The shipped pool is built against a D3D12 stand-in (d3d12.h in this directory: fake heap addresses, no descriptors written).
+
+	Fuzz: random allocate/free sequences on a full heap pool and on a pool suballocating a range of a heap, checked after every
+	operation against a reference model of the occupied descriptor ranges:
+		- handles, offsets from the heap base and counts match the range, ranges never overlap or leave the pool
+		- the free ranges are exactly the gaps of the model (full coalescing), the stats match the live descriptors
+		- a failed allocation only happens when no gap could be found by a good fit
+		- freeing everything leaves a single free range
+
+	Benchmark: one descriptor allocate/free trace replayed on the pool and on the first-fit free chunk list it replaced
+	(the previous DXDescriptorPool::allocate/deallocate, kept below as they were).
+
+	Build (Linux/macOS, from DX12/DX12):
+		g++ -std=c++17 -O2 -Itools/DescriptorPoolCheck -Isrc tools/DescriptorPoolCheck/main.cpp
+			src/Graphics/DX/Descriptor/DXDescriptorPool.cpp src/Utilities/TLSFAllocator.cpp -o descpoolcheck && ./descpoolcheck [trace ops, default 1000000]
+*/
+
+namespace
+{
+	uint32_t g_failures = 0;
+
+#define CHECK(cond) do { if (!(cond)) { std::printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); ++g_failures; } } while (0)
+
+	constexpr uint32_t HANDLE_SIZE = 32;		// CBV_SRV_UAV on the stand-in device
+
+	cptr<ID3D12Device> make_device()
+	{
+		cptr<ID3D12Device> dev;
+		*dev.GetAddressOf() = new ID3D12Device();
+		return dev;
+	}
+
+	// A range of the shader visible heap, as handed to a suballocating pool (e.g the bindless range of the view cache)
+	DXDescriptorAllocation make_heap_range(uint32_t offset_from_base, uint32_t count)
+	{
+		D3D12_CPU_DESCRIPTOR_HANDLE cpu{ ID3D12DescriptorHeap::CPU_START + (size_t)offset_from_base * HANDLE_SIZE };
+		D3D12_GPU_DESCRIPTOR_HANDLE gpu{ ID3D12DescriptorHeap::GPU_START + (uint64_t)offset_from_base * HANDLE_SIZE };
+		return DXDescriptorAllocation(cpu, gpu, HANDLE_SIZE, count, offset_from_base);
+	}
+
+	// Smallest free range which TLSF's good fit search is guaranteed to find
+	uint64_t good_fit_size(uint64_t count)
+	{
+		if (count < 16)
+			return count;
+		uint32_t msb = 63;
+		while (!(count >> msb))
+			--msb;
+		const uint64_t round = ((uint64_t)1 << (msb - 4)) - 1;
+		return (count + round) & ~round;
+	}
+
+	// Occupied descriptor ranges (offsets within the pool)
+	class ReferenceModel
+	{
+	public:
+		ReferenceModel(uint64_t capacity) : m_capacity(capacity) {}
+
+		bool insert(uint64_t offset, uint64_t count)
+		{
+			if (offset + count > m_capacity)
+				return false;
+			auto next = m_used.lower_bound(offset);
+			if (next != m_used.end() && next->first < offset + count)
+				return false;
+			if (next != m_used.begin() && std::prev(next)->first + std::prev(next)->second > offset)
+				return false;
+			m_used.insert({ offset, count });
+			m_used_count += count;
+			return true;
+		}
+
+		void erase(uint64_t offset)
+		{
+			auto it = m_used.find(offset);
+			m_used_count -= it->second;
+			m_used.erase(it);
+		}
+
+		void gaps(uint32_t& count, uint64_t& largest) const
+		{
+			count = 0;
+			largest = 0;
+			uint64_t end = 0;
+			for (const auto& [offset, size] : m_used)
+			{
+				if (offset > end)
+				{
+					++count;
+					largest = (std::max)(largest, offset - end);
+				}
+				end = offset + size;
+			}
+			if (end < m_capacity)
+			{
+				++count;
+				largest = (std::max)(largest, m_capacity - end);
+			}
+		}
+
+		uint64_t used() const { return m_used_count; }
+
+	private:
+		uint64_t m_capacity = 0;
+		uint64_t m_used_count = 0;
+		std::map<uint64_t, uint64_t> m_used;
+	};
+
+	/*
+		The previous DXDescriptorPool (suballocating constructor, allocate and deallocate as they were): a first-fit vector of
+		free chunks, freed ranges are only merged with the first two chunks.
+	*/
+	class FirstFitDescriptorPool
+	{
+	public:
+		FirstFitDescriptorPool(cptr<ID3D12Device> dev, DXDescriptorAllocation&& alloc, D3D12_DESCRIPTOR_HEAP_TYPE type) :
+			m_handle_size(dev->GetDescriptorHandleIncrementSize(type))
+		{
+			m_free_chunks.reserve(alloc.num_descriptors());
+
+			DescriptorChunk new_chunk{};
+			new_chunk.cpu_start = alloc.cpu_handle();
+			new_chunk.gpu_start = alloc.gpu_handle();
+			new_chunk.num_descriptors = alloc.num_descriptors();
+			m_free_chunks.push_back(new_chunk);
+
+			m_base_gpu_start.ptr = alloc.gpu_handle().ptr - dev->GetDescriptorHandleIncrementSize(type) * alloc.offset_from_base();
+		}
+
+		DXDescriptorAllocation allocate(uint32_t num_requested_descriptors)
+		{
+			for (auto it = m_free_chunks.begin(); it != m_free_chunks.end(); ++it)
+			{
+				auto& chunk = *it;
+				if (chunk.num_descriptors == num_requested_descriptors)
+				{
+					auto offset = (chunk.gpu_start.ptr - m_base_gpu_start.ptr) / m_handle_size;
+					auto to_ret = DXDescriptorAllocation(chunk.cpu_start, chunk.gpu_start, m_handle_size, num_requested_descriptors, (uint32_t)offset);
+					m_free_chunks.erase(it);
+					return to_ret;
+				}
+				else if (chunk.num_descriptors > num_requested_descriptors)
+				{
+					auto offset = (chunk.gpu_start.ptr - m_base_gpu_start.ptr) / m_handle_size;
+					auto to_ret = DXDescriptorAllocation(chunk.cpu_start, chunk.gpu_start, m_handle_size, num_requested_descriptors, (uint32_t)offset);
+					chunk.cpu_start.ptr += num_requested_descriptors * m_handle_size;
+					chunk.gpu_start.ptr += num_requested_descriptors * m_handle_size;
+					chunk.num_descriptors -= num_requested_descriptors;
+					return to_ret;
+				}
+			}
+			return {};
+		}
+
+		void deallocate(DXDescriptorAllocation&& alloc)
+		{
+			const auto alloc_gpu_start = alloc.gpu_handle().ptr;
+			const auto alloc_gpu_end = alloc.gpu_handle().ptr + alloc.num_descriptors() * m_handle_size;
+			if (m_free_chunks.size() > 1)
+			{
+				for (auto it = m_free_chunks.begin() + 1; it != m_free_chunks.end(); ++it)
+				{
+					const auto left_chunk_it = std::next(it, -1);
+					const auto right_chunk_it = it;
+					auto& left_chunk = *left_chunk_it;
+					auto& right_chunk = *right_chunk_it;
+
+					const auto left_chunk_end = left_chunk.gpu_start.ptr + left_chunk.num_descriptors * m_handle_size;
+					const auto right_chunk_start = right_chunk.gpu_start.ptr;
+
+					const bool merge_left = alloc_gpu_start == left_chunk_end;
+					const bool merge_right = alloc_gpu_end == right_chunk_start;
+
+					if (merge_left && merge_right)
+					{
+						left_chunk.num_descriptors += alloc.num_descriptors() + right_chunk.num_descriptors;
+						m_free_chunks.erase(right_chunk_it);
+						break;
+					}
+					else if (merge_left)
+					{
+						left_chunk.num_descriptors += alloc.num_descriptors();
+						break;
+					}
+					else if (merge_right)
+					{
+						right_chunk.cpu_start = alloc.cpu_handle();
+						right_chunk.gpu_start = alloc.gpu_handle();
+						right_chunk.num_descriptors += alloc.num_descriptors();
+						break;
+					}
+					else
+					{
+						DescriptorChunk chunk{};
+						chunk.cpu_start = alloc.cpu_handle();
+						chunk.gpu_start = alloc.gpu_handle();
+						chunk.num_descriptors = alloc.num_descriptors();
+						m_free_chunks.push_back(chunk);
+						break;
+					}
+				}
+			}
+			else if (m_free_chunks.size() == 1)
+			{
+				auto& chunk = m_free_chunks[0];
+				bool merge_left = alloc_gpu_start == chunk.gpu_start.ptr + chunk.num_descriptors * m_handle_size;
+				bool merge_right = alloc_gpu_end == chunk.gpu_start.ptr;
+				bool adr_before = alloc.gpu_handle().ptr < chunk.gpu_start.ptr;
+
+				if (merge_left)
+					chunk.num_descriptors += alloc.num_descriptors();
+				else if (merge_right)
+				{
+					chunk.num_descriptors += alloc.num_descriptors();
+					chunk.cpu_start = alloc.cpu_handle();
+					chunk.gpu_start = alloc.gpu_handle();
+				}
+				else
+				{
+					DescriptorChunk disjoint_chunk{};
+					disjoint_chunk.cpu_start = alloc.cpu_handle();
+					disjoint_chunk.gpu_start = alloc.gpu_handle();
+					disjoint_chunk.num_descriptors = alloc.num_descriptors();
+
+					if (adr_before)
+					{
+						m_free_chunks.push_back(std::move(m_free_chunks[0]));
+						m_free_chunks[0] = std::move(disjoint_chunk);
+					}
+					else
+						m_free_chunks.push_back(disjoint_chunk);
+				}
+			}
+			else
+			{
+				DescriptorChunk chunk{};
+				chunk.cpu_start = alloc.cpu_handle();
+				chunk.gpu_start = alloc.gpu_handle();
+				chunk.num_descriptors = alloc.num_descriptors();
+				m_free_chunks.push_back(chunk);
+			}
+		}
+
+		uint32_t free_chunks() const { return (uint32_t)m_free_chunks.size(); }
+		uint64_t largest_free() const
+		{
+			uint64_t largest = 0;
+			for (const auto& chunk : m_free_chunks)
+				largest = (std::max)(largest, (uint64_t)chunk.num_descriptors);
+			return largest;
+		}
+
+	private:
+		struct DescriptorChunk
+		{
+			D3D12_CPU_DESCRIPTOR_HANDLE cpu_start;
+			D3D12_GPU_DESCRIPTOR_HANDLE gpu_start;
+			uint32_t num_descriptors = 0;
+		};
+
+		uint32_t m_handle_size = 0;
+		D3D12_GPU_DESCRIPTOR_HANDLE m_base_gpu_start{};
+		std::vector<DescriptorChunk> m_free_chunks;
+	};
+
+	// Mostly single views (bindless textures, view cache) with the odd table
+	uint32_t random_count(std::mt19937& rng)
+	{
+		const uint32_t kind = rng() % 16;
+		if (kind < 12)
+			return 1;
+		if (kind < 15)
+			return 2 + rng() % 7;
+		return 16 + rng() % 49;
+	}
+
+	// pool_start: offset of the pool's first descriptor from the heap start
+	void fuzz(DXDescriptorPool& pool, uint32_t capacity, uint32_t pool_start, bool gpu_visible, uint32_t seed, uint32_t ops)
+	{
+		std::mt19937 rng(seed);
+		ReferenceModel model(capacity);
+		std::vector<DXDescriptorAllocation> live;
+
+		const auto cpu_start = ID3D12DescriptorHeap::CPU_START + (size_t)pool_start * HANDLE_SIZE;
+		const auto gpu_start = ID3D12DescriptorHeap::GPU_START + (uint64_t)pool_start * HANDLE_SIZE;
+
+		for (uint32_t op = 0; op < ops; ++op)
+		{
+			// swing between filling the pool up and draining it
+			const bool fill = (op / 3000) % 2 == 0;
+			if (live.empty() || rng() % 100 < (fill ? 70u : 30u))
+			{
+				const uint32_t count = random_count(rng);
+				auto alloc = pool.allocate(count);
+				if (alloc.num_descriptors() == 0)
+				{
+					uint32_t num_gaps = 0;
+					uint64_t largest = 0;
+					model.gaps(num_gaps, largest);
+					CHECK(largest < good_fit_size(count));
+					continue;
+				}
+
+				CHECK(alloc.num_descriptors() == count && alloc.descriptor_size() == HANDLE_SIZE);
+				CHECK(alloc.offset_from_base() >= pool_start);
+				const uint64_t offset = alloc.offset_from_base() - pool_start;
+				CHECK(alloc.cpu_handle().ptr == cpu_start + offset * HANDLE_SIZE);
+				CHECK(alloc.gpu_visible() == gpu_visible);
+				if (gpu_visible)
+					CHECK(alloc.gpu_handle().ptr == gpu_start + offset * HANDLE_SIZE);
+				CHECK(model.insert(offset, count));
+				live.push_back(std::move(alloc));
+			}
+			else
+			{
+				const size_t idx = rng() % live.size();
+				model.erase(live[idx].offset_from_base() - pool_start);
+				pool.deallocate(std::move(live[idx]));
+				live[idx] = live.back();
+				live.pop_back();
+			}
+
+			uint32_t num_gaps = 0;
+			uint64_t largest = 0;
+			model.gaps(num_gaps, largest);
+			const auto report = pool.get_report();
+			const auto stats = pool.get_stats();
+			CHECK(report.free_blocks == num_gaps && report.largest_free == largest);
+			CHECK(report.used == model.used() && report.allocations == live.size());
+			CHECK(stats.elements_in_use == model.used() && stats.bytes_in_use == model.used() * HANDLE_SIZE);
+			CHECK(stats.largest_free_bytes == largest * HANDLE_SIZE);
+			if (g_failures > 0)
+			{
+				std::printf("fuzz failed (seed %u, op %u)\n", seed, op);
+				return;
+			}
+		}
+
+		for (auto& alloc : live)
+			pool.deallocate(std::move(alloc));
+		const auto report = pool.get_report();
+		CHECK(report.free_blocks == 1 && report.largest_free == capacity && report.used == 0);
+		CHECK(pool.get_stats().elements_in_use == 0);
+	}
+
+	struct TraceOp
+	{
+		bool allocate = false;
+		uint32_t value = 0;			// descriptor count, or which live allocation to free
+	};
+
+	std::vector<TraceOp> make_trace(uint32_t num_ops, uint32_t capacity)
+	{
+		std::mt19937 rng(7);
+		std::vector<TraceOp> trace;
+		trace.reserve(num_ops);
+
+		// hovers around 70% of the pool in use
+		uint64_t live_count = 0;
+		std::vector<uint32_t> live;
+		for (uint32_t i = 0; i < num_ops; ++i)
+		{
+			const bool allocate = live.empty() || (live_count < (uint64_t)capacity * 7 / 10 ? rng() % 100 < 60 : rng() % 100 < 40);
+			if (allocate)
+			{
+				const uint32_t count = random_count(rng);
+				trace.push_back({ true, count });
+				live.push_back(count);
+				live_count += count;
+			}
+			else
+			{
+				const uint32_t idx = rng();
+				trace.push_back({ false, idx });
+				const size_t at = idx % live.size();
+				live_count -= live[at];
+				live[at] = live.back();
+				live.pop_back();
+			}
+		}
+		return trace;
+	}
+
+	struct TraceResult
+	{
+		double ns_per_op = 0.0;
+		uint32_t failures = 0;
+		uint32_t free_chunks = 0;		// before freeing the remaining live set
+		uint64_t largest_free = 0;		// in descriptors
+	};
+
+	template <typename Pool, typename Report>
+	TraceResult replay(Pool& pool, const std::vector<TraceOp>& trace, Report&& report)
+	{
+		using Clock = std::chrono::steady_clock;
+		TraceResult result{};
+		std::vector<DXDescriptorAllocation> live;
+		live.reserve(trace.size());
+
+		const auto start = Clock::now();
+		for (const auto& op : trace)
+		{
+			if (op.allocate)
+			{
+				auto alloc = pool.allocate(op.value);
+				if (alloc.num_descriptors() > 0)
+					live.push_back(std::move(alloc));
+				else
+					++result.failures;
+			}
+			else if (!live.empty())
+			{
+				const size_t at = op.value % live.size();
+				pool.deallocate(std::move(live[at]));
+				live[at] = live.back();
+				live.pop_back();
+			}
+		}
+		result.ns_per_op = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / (double)trace.size();
+
+		report(result);
+		for (auto& alloc : live)
+			pool.deallocate(std::move(alloc));
+		return result;
+	}
+
+	void bench(cptr<ID3D12Device> dev, uint32_t num_ops)
+	{
+		constexpr uint32_t CAPACITY = 16384;
+		constexpr uint32_t POOL_START = 1024;
+		const auto trace = make_trace(num_ops, CAPACITY);
+
+		DXDescriptorPool pool(dev, make_heap_range(POOL_START, CAPACITY), D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+		const auto tlsf_result = replay(pool, trace, [&](TraceResult& result)
+			{
+				const auto report = pool.get_report();
+				result.free_chunks = report.free_blocks;
+				result.largest_free = report.largest_free;
+			});
+		CHECK(pool.get_report().free_blocks == 1 && pool.get_report().used == 0);
+
+		FirstFitDescriptorPool first_fit(dev, make_heap_range(POOL_START, CAPACITY), D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+		const auto first_fit_result = replay(first_fit, trace, [&](TraceResult& result)
+			{
+				result.free_chunks = first_fit.free_chunks();
+				result.largest_free = first_fit.largest_free();
+			});
+
+		std::printf("\n%u op trace, %u descriptor pool, ~70%% in use (mostly single views, some tables up to 64)\n", num_ops, CAPACITY);
+		std::printf("%-12s %14s %12s %14s %16s\n", "", "ns/op", "failures", "free chunks", "largest free");
+		std::printf("%-12s %14.1f %12u %14u %16llu\n", "TLSF pool", tlsf_result.ns_per_op, tlsf_result.failures, tlsf_result.free_chunks, (unsigned long long)tlsf_result.largest_free);
+		std::printf("%-12s %14.1f %12u %14u %16llu\n", "first-fit", first_fit_result.ns_per_op, first_fit_result.failures, first_fit_result.free_chunks, (unsigned long long)first_fit_result.largest_free);
+		std::printf("(first-fit after freeing everything: %u free chunks, largest %llu of %u)\n", first_fit.free_chunks(), (unsigned long long)first_fit.largest_free(), CAPACITY);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	const uint32_t num_ops = argc > 1 ? (uint32_t)std::strtoul(argv[1], nullptr, 10) : 1000000;
+	auto dev = make_device();
+
+	for (uint32_t seed = 1; seed <= 4 && g_failures == 0; ++seed)
+	{
+		// whole heap, CPU only
+		DXDescriptorPool cpu_pool(dev, D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, 4096, false);
+		fuzz(cpu_pool, 4096, 0, false, seed, 30000);
+
+		// shader visible range suballocated from a heap
+		DXDescriptorPool range_pool(dev, make_heap_range(1000 * seed, 2048), D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+		fuzz(range_pool, 2048, 1000 * seed, true, seed + 100, 30000);
+	}
+	std::printf("fuzz: %s\n", g_failures == 0 ? "passed" : "FAILED");
+
+	bench(dev, num_ops);
+	return g_failures == 0 ? 0 : 1;
+}
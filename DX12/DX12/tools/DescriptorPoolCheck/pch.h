@@ -0,0 +1,36 @@
+#pragma once
+/*
+	Portable stand-in for the engine's precompiled header, the check builds DXDescriptorPool against the D3D12 stand-in (d3d12.h).
+	Must come first on the include path (before src/) so that "pch.h" resolves here.
+*/
+#include <assert.h>
+#include <stdint.h>
+#include <memory>
+#include <utility>
+#include <vector>
+#include <d3d12.h>
+
+// Just enough of Microsoft::WRL::ComPtr for the pool
+namespace Microsoft::WRL
+{
+	template <typename T>
+	class ComPtr
+	{
+	public:
+		ComPtr() = default;
+		ComPtr(T* p) : m_p(p) { if (m_p) m_p->AddRef(); }
+		ComPtr(const ComPtr& other) : ComPtr(other.m_p) {}
+		ComPtr& operator=(ComPtr other) { std::swap(m_p, other.m_p); return *this; }
+		~ComPtr() { if (m_p) m_p->Release(); }
+
+		T* Get() const { return m_p; }
+		T** GetAddressOf() { return &m_p; }
+		T* operator->() const { return m_p; }
+
+	private:
+		T* m_p = nullptr;
+	};
+}
+
+template <typename T>
+using cptr = Microsoft::WRL::ComPtr<T>;
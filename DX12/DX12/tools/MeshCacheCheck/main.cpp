@@ -0,0 +1,354 @@
+#include "pch.h"
+#include "Utilities/MeshCache.h"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+/*
+	Checks MeshCache (std-only apart from fmt, runs anywhere) in a scratch directory under the system temp directory.
+
+		- write/open round trip: streams, meshes and material paths come back as written, sections are aligned in the mapping
+		- files with a wrong magic, version or source hash, truncated files and corrupt section tables are rejected
+		- meshes out of range of the streams and streams of different lengths are rejected
+		- remove_superseded only removes other versions of the same source (prefix match on the source path hash)
+		- source hashes follow the files the model references and nothing else
+
+	Build (Linux/macOS, from DX12/DX12):
+		g++ -std=c++17 -O2 -Itools/MeshCacheCheck -Isrc -Ivendor/fmt-8.1.1/inc tools/MeshCacheCheck/main.cpp src/Utilities/MeshCache.cpp
+			src/Utilities/MappedFile.cpp src/Utilities/Hash.cpp -o meshcachecheck && ./meshcachecheck
+*/
+
+namespace
+{
+	uint32_t g_failures = 0;
+
+#define CHECK(cond) do { if (!(cond)) { std::printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); ++g_failures; } } while (0)
+
+	namespace fs = std::filesystem;
+
+	constexpr uint64_t SOURCE_HASH = 0x1234'5678'9abc'def0;
+
+	struct Model
+	{
+		std::vector<float> positions, uvs, normals;
+		std::vector<uint32_t> indices;
+		MeshCacheContents contents;
+	};
+
+	// Two meshes (a quad and a triangle) and two materials
+	void make_model(Model& model)
+	{
+		model.positions = { 0, 0, 0, 1, 0, 0, 1, 1, 0, 0, 1, 0, 2, 0, 0, 3, 0, 0, 2, 1, 0 };
+		model.uvs = { 0, 0, 1, 0, 1, 1, 0, 1, 0, 0, 1, 0, 0, 1 };
+		model.normals.assign(model.positions.size(), 1.f);
+		model.indices = { 0, 1, 2, 0, 2, 3, 0, 1, 2 };
+
+		auto& contents = model.contents;
+		contents.positions = utils::MemBlob(model.positions.data(), 7, 3 * sizeof(float));
+		contents.uvs = utils::MemBlob(model.uvs.data(), 7, 2 * sizeof(float));
+		contents.normals = utils::MemBlob(model.normals.data(), 7, 3 * sizeof(float));
+		contents.indices = utils::MemBlob(model.indices.data(), 9, sizeof(uint32_t));
+		contents.meshes = { { 0, 6, 0 }, { 6, 3, 4 } };
+
+		AssimpMaterialData::PhongPaths paths;
+		paths.diffuse = "textures/brick_diff.png";
+		paths.normal = "textures/brick_norm.png";
+		contents.materials.push_back({ paths });
+		paths.diffuse = fs::u8path(u8"textures/mårmor.png");
+		paths.normal.clear();
+		paths.specular = "textures/marble_spec.png";
+		paths.opacity = "textures/marble_alpha.png";
+		contents.materials.push_back({ paths });
+	}
+
+	std::vector<uint8_t> read_bytes(const fs::path& path)
+	{
+		std::ifstream file(path, std::ios::binary);
+		return std::vector<uint8_t>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+	}
+
+	void write_bytes(const fs::path& path, const std::vector<uint8_t>& bytes)
+	{
+		std::ofstream file(path, std::ios::binary | std::ios::trunc);
+		file.write((const char*)bytes.data(), bytes.size());
+	}
+
+	void touch(const fs::path& path, const std::string& text)
+	{
+		std::ofstream file(path, std::ios::binary | std::ios::trunc);
+		file << text;
+	}
+
+	bool same_blob(const utils::MemBlob& a, const utils::MemBlob& b)
+	{
+		if (a.count != b.count || a.stride != b.stride)
+			return false;
+		return a.count == 0 || std::memcmp(a.data, b.data, (size_t)a.count * a.stride) == 0;
+	}
+
+	// Writes the model, lets edit change the raw file and checks that it is rejected
+	bool opens_edited(const fs::path& path, const MeshCacheContents& contents, void (*edit)(std::vector<uint8_t>&, MeshCacheHeader&))
+	{
+		if (!MeshCache::write(path, SOURCE_HASH, contents))
+			return true;		// reported as a failure by the caller
+
+		auto bytes = read_bytes(path);
+		MeshCacheHeader header{};
+		std::memcpy(&header, bytes.data(), sizeof(header));
+		edit(bytes, header);
+		std::memcpy(bytes.data(), &header, sizeof(header));
+		write_bytes(path, bytes);
+
+		MeshCache cache;
+		const bool opened = cache.open(path, SOURCE_HASH);
+		CHECK(opened || cache.get_contents().meshes.empty());
+		return opened;
+	}
+
+	MeshCacheHeader::Section& section(MeshCacheHeader& header, MeshCacheSection type)
+	{
+		return header.sections[(uint32_t)type];
+	}
+
+	void check_round_trip(const fs::path& dir)
+	{
+		Model model;
+		make_model(model);
+		const auto path = dir / "round_trip.mcache";
+		CHECK(MeshCache::write(path, SOURCE_HASH, model.contents));
+		CHECK(!fs::exists(fs::path(path) += ".tmp"));
+
+		MeshCache cache;
+		CHECK(cache.open(path, SOURCE_HASH));
+		const auto& contents = cache.get_contents();
+		CHECK(same_blob(contents.positions, model.contents.positions));
+		CHECK(same_blob(contents.uvs, model.contents.uvs));
+		CHECK(same_blob(contents.normals, model.contents.normals));
+		CHECK(contents.tangents.empty() && contents.bitangents.empty());
+		CHECK(same_blob(contents.indices, model.contents.indices));
+
+		// streams point into the mapping, 16 byte aligned
+		CHECK(contents.positions.data != model.contents.positions.data);
+		for (const auto* stream : { &contents.positions, &contents.uvs, &contents.normals, &contents.indices })
+			CHECK((uintptr_t)stream->data % 16 == 0);
+
+		CHECK(contents.meshes.size() == 2);
+		for (size_t i = 0; i < contents.meshes.size() && i < model.contents.meshes.size(); ++i)
+		{
+			CHECK(contents.meshes[i].index_start == model.contents.meshes[i].index_start);
+			CHECK(contents.meshes[i].index_count == model.contents.meshes[i].index_count);
+			CHECK(contents.meshes[i].vertex_start == model.contents.meshes[i].vertex_start);
+		}
+
+		CHECK(contents.materials.size() == 2);
+		for (size_t i = 0; i < contents.materials.size() && i < model.contents.materials.size(); ++i)
+		{
+			const auto& read = std::get<AssimpMaterialData::PhongPaths>(contents.materials[i].file_paths);
+			const auto& written = std::get<AssimpMaterialData::PhongPaths>(model.contents.materials[i].file_paths);
+			CHECK(read.diffuse == written.diffuse && read.normal == written.normal);
+			CHECK(read.specular == written.specular && read.opacity == written.opacity);
+		}
+
+		// reopening replaces the contents, a failed open leaves none
+		CHECK(cache.open(path, SOURCE_HASH) && cache.get_contents().meshes.size() == 2);
+		CHECK(!cache.open(path, SOURCE_HASH + 1) && cache.get_contents().meshes.empty() && cache.get_contents().positions.empty());
+		CHECK(!cache.open(dir / "missing.mcache", SOURCE_HASH));
+
+		// an empty model round trips too
+		CHECK(MeshCache::write(path, SOURCE_HASH, MeshCacheContents{}));
+		CHECK(cache.open(path, SOURCE_HASH) && cache.get_contents().meshes.empty() && cache.get_contents().materials.empty());
+	}
+
+	void check_corrupt_headers(const fs::path& dir)
+	{
+		Model model;
+		make_model(model);
+		const auto path = dir / "corrupt.mcache";
+
+		// wrong magic / version
+		CHECK(!opens_edited(path, model.contents, [](std::vector<uint8_t>&, MeshCacheHeader& header) { header.magic = 0x4D534843; }));
+		CHECK(!opens_edited(path, model.contents, [](std::vector<uint8_t>&, MeshCacheHeader& header) { ++header.version; }));
+
+		// truncated anywhere (the last section ends at the end of the file)
+		CHECK(MeshCache::write(path, SOURCE_HASH, model.contents));
+		const auto bytes = read_bytes(path);
+		for (size_t size : { (size_t)0, (size_t)7, sizeof(MeshCacheHeader) - 1, sizeof(MeshCacheHeader), sizeof(MeshCacheHeader) + 20, bytes.size() / 2, bytes.size() - 1 })
+		{
+			write_bytes(path, std::vector<uint8_t>(bytes.begin(), bytes.begin() + size));
+			MeshCache cache;
+			CHECK(!cache.open(path, SOURCE_HASH));
+		}
+
+		// sections overlapping the header, past the end or wrapping around
+		CHECK(!opens_edited(path, model.contents, [](std::vector<uint8_t>&, MeshCacheHeader& header)
+			{ section(header, MeshCacheSection::eUVs).offset = 8; }));
+		CHECK(!opens_edited(path, model.contents, [](std::vector<uint8_t>& bytes, MeshCacheHeader& header)
+			{ section(header, MeshCacheSection::ePositions).offset = bytes.size() + 16; }));
+		CHECK(!opens_edited(path, model.contents, [](std::vector<uint8_t>&, MeshCacheHeader& header)
+			{ section(header, MeshCacheSection::eMaterials).size = ~0ull - section(header, MeshCacheSection::eMaterials).offset + 16; }));
+		CHECK(!opens_edited(path, model.contents, [](std::vector<uint8_t>&, MeshCacheHeader& header)
+			{ section(header, MeshCacheSection::eIndices).size = ~0ull; }));
+
+		// element counts which don't match the section size
+		CHECK(!opens_edited(path, model.contents, [](std::vector<uint8_t>&, MeshCacheHeader& header)
+			{ ++section(header, MeshCacheSection::eNormals).count; }));
+		CHECK(!opens_edited(path, model.contents, [](std::vector<uint8_t>&, MeshCacheHeader& header)
+			{ section(header, MeshCacheSection::eIndices).stride = 2; }));
+		CHECK(!opens_edited(path, model.contents, [](std::vector<uint8_t>&, MeshCacheHeader& header)
+			{
+				auto& meshes = section(header, MeshCacheSection::eMeshes);
+				meshes.stride = 4;
+				meshes.count *= 3;
+			}));
+		CHECK(!opens_edited(path, model.contents, [](std::vector<uint8_t>&, MeshCacheHeader& header)
+			{ section(header, MeshCacheSection::eMaterials).count = ~0u; }));
+
+		// material paths running past their section
+		CHECK(!opens_edited(path, model.contents, [](std::vector<uint8_t>& bytes, MeshCacheHeader& header)
+			{
+				const uint32_t len = 1000;
+				std::memcpy(bytes.data() + section(header, MeshCacheSection::eMaterials).offset, &len, sizeof(len));
+			}));
+		CHECK(!opens_edited(path, model.contents, [](std::vector<uint8_t>&, MeshCacheHeader& header)
+			{ section(header, MeshCacheSection::eMaterials).size -= 1; }));
+
+		// and an untouched file still opens
+		CHECK(opens_edited(path, model.contents, [](std::vector<uint8_t>&, MeshCacheHeader&) {}));
+	}
+
+	void check_mesh_ranges(const fs::path& dir)
+	{
+		const auto path = dir / "ranges.mcache";
+		auto opens = [&](const MeshCacheContents& contents)
+		{
+			MeshCache cache;
+			return MeshCache::write(path, SOURCE_HASH, contents) && cache.open(path, SOURCE_HASH);
+		};
+
+		Model model;
+		make_model(model);
+		CHECK(opens(model.contents));
+
+		// indices past the index stream
+		auto contents = model.contents;
+		contents.meshes[1].index_count = 4;
+		CHECK(!opens(contents));
+		contents = model.contents;
+		contents.meshes[0].index_start = ~0u;
+		CHECK(!opens(contents));
+
+		// vertices past the vertex streams, or ranges which go backwards
+		contents = model.contents;
+		contents.meshes[1].vertex_start = 8;
+		CHECK(!opens(contents));
+		contents = model.contents;
+		contents.meshes[0].vertex_start = 5;
+		CHECK(!opens(contents));
+
+		// the last mesh may be empty, up to the end of the streams
+		contents = model.contents;
+		contents.meshes[1].vertex_start = 7;
+		contents.meshes[1].index_count = 0;
+		CHECK(opens(contents));
+
+		// streams of a different length than the positions
+		contents = model.contents;
+		contents.uvs.count = 6;
+		CHECK(!opens(contents));
+		contents = model.contents;
+		contents.normals = utils::MemBlob(model.normals.data(), 6, 3 * sizeof(float));
+		CHECK(!opens(contents));
+
+		// meshes without any vertices
+		contents = model.contents;
+		contents.positions = {};
+		contents.uvs = {};
+		contents.normals = {};
+		CHECK(!opens(contents));
+	}
+
+	void check_remove_superseded(const fs::path& dir)
+	{
+		const auto models = dir / "models";
+		fs::create_directories(models / "a");
+		fs::create_directories(models / "b");
+		const auto cache_dir = dir / "cache";
+		fs::create_directories(cache_dir);
+
+		// same model name in two directories, and a model whose name starts with the other's
+		const auto source = models / "a" / "ship.gltf";
+		const auto other_dir = models / "b" / "ship.gltf";
+		const auto longer_name = models / "a" / "ship2.gltf";
+
+		auto cache_path = [&](const fs::path& model_path, uint64_t hash) { return cache_dir / MeshCache::get_cache_path(model_path, hash).filename(); };
+
+		// cache files are named <stem>.<path hash>.<source hash>.mcache
+		const auto name = MeshCache::get_cache_path(source, 0xabc).filename().string();
+		CHECK(MeshCache::get_cache_path(source, 0xabc).parent_path() == "cache");
+		CHECK(name.compare(0, 5, "ship.") == 0 && name.size() == 5 + 9 + 16 + 7);
+		CHECK(MeshCache::get_cache_path(source, 0xabc) != MeshCache::get_cache_path(other_dir, 0xabc));
+
+		const auto old_a = cache_path(source, 1);
+		const auto older_a = cache_path(source, 2);
+		const auto current_a = cache_path(source, 3);
+		const auto current_b = cache_path(other_dir, 1);
+		const auto current_longer = cache_path(longer_name, 1);
+		const auto tmp_a = fs::path(cache_path(source, 4)) += ".tmp";
+		const auto unrelated = cache_dir / "ship.txt";
+		for (const auto& path : { old_a, older_a, current_a, current_b, current_longer, tmp_a, unrelated })
+			touch(path, "x");
+
+		MeshCache::remove_superseded(source, current_a);
+		CHECK(!fs::exists(old_a) && !fs::exists(older_a));
+		CHECK(fs::exists(current_a) && fs::exists(current_b) && fs::exists(current_longer));
+		CHECK(fs::exists(tmp_a) && fs::exists(unrelated));
+
+		// a missing cache directory is fine
+		MeshCache::remove_superseded(source, dir / "none" / "x.mcache");
+	}
+
+	void check_source_hash(const fs::path& dir)
+	{
+		const auto models = dir / "hash";
+		fs::create_directories(models);
+
+		touch(models / "x.gltf", "{ \"buffers\": [ { \"uri\": \"x.bin\" } ], \"images\": [ { \"uri\": \"x.png\" } ] }");
+		touch(models / "x.bin", "buffer");
+		touch(models / "x.png", "image");
+		touch(models / "y.obj", "# comment\nmtllib y.mtl \r\nv 0 0 0\n");
+		touch(models / "y.mtl", "newmtl a\n");
+
+		const uint64_t gltf = MeshCache::hash_source(models / "x.gltf");
+		const uint64_t obj = MeshCache::hash_source(models / "y.obj");
+		CHECK(gltf != 0 && obj != 0 && gltf != obj);
+		CHECK(MeshCache::hash_source(models / "missing.gltf") == 0);
+
+		// textures aren't part of the model
+		touch(models / "x.png", "other image");
+		CHECK(MeshCache::hash_source(models / "x.gltf") == gltf);
+		touch(models / "x.bin", "other buffer");
+		CHECK(MeshCache::hash_source(models / "x.gltf") != gltf);
+
+		touch(models / "y.mtl", "newmtl b\n");
+		CHECK(MeshCache::hash_source(models / "y.obj") != obj);
+	}
+}
+
+int main()
+{
+	const auto dir = fs::temp_directory_path() / "meshcachecheck";
+	std::error_code ec;
+	fs::remove_all(dir, ec);
+	fs::create_directories(dir);
+
+	check_round_trip(dir);
+	check_corrupt_headers(dir);
+	check_mesh_ranges(dir);
+	check_remove_superseded(dir);
+	check_source_hash(dir);
+
+	fs::remove_all(dir, ec);
+	std::printf("checks: %s\n", g_failures == 0 ? "passed" : "FAILED");
+	return g_failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,36 @@
+#pragma once
+/*
+	Portable stand-in for the engine's precompiled header, the check only builds std-only sources from src/Utilities
+	(plus fmt, header-only from vendor/). Must come first on the include path (before src/) so that "pch.h" resolves here.
+*/
+#include <assert.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <memory>
+#include <filesystem>
+
+#define FMT_HEADER_ONLY
+#include "fmt/core.h"
+
+namespace utils
+{
+	// as in src/pch.h
+	struct MemBlob
+	{
+		MemBlob() = default;
+		MemBlob(void* data_, size_t count_, size_t stride_) :
+			data(data_),
+			count((uint32_t)count_),
+			stride((uint32_t)stride_) {
+			total_size = count * stride;
+		}
+
+		bool empty() const { return data == nullptr || count == 0 || stride == 0; }
+
+		void* data = nullptr;
+		uint32_t count = 0;
+		uint32_t stride = 0;
+		uint32_t total_size = 0;
+	};
+}
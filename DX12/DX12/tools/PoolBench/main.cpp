@@ -0,0 +1,229 @@
+#include "Utilities/IndexFreeList.h"
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <queue>
+#include <vector>
+
+/*
+	Microbenchmark of the DXBufferMemPool free list: the previous queue of prebuilt allocations against the current index free list.
+
+	Runs without a device, on the default pool configuration of DXBufferManager before growth
+	(256/512/1024 byte elements, 5000/5000/30000 elements, 3 frames in flight + the upload ring = 4 allocators).
+		- QueuePool: the previous pool, one 48 byte allocation per free element in a std::queue, each holding a ref to the pool buffer
+		  (ComPtr AddRef/Release are an interlocked add behind a virtual call, modelled by RefCounted)
+		- IndexPool: DXBufferMemPool::allocate/deallocate over the shipped IndexFreeList, only the D3D resource is left out
+
+	Build (Linux/macOS, from DX12/DX12):
+		g++ -std=c++17 -O2 -Isrc tools/PoolBench/main.cpp -o poolbench && ./poolbench [alloc/free rounds, default 2000]
+*/
+
+namespace
+{
+	// Stand-in for the ID3D12Resource refcount
+	struct RefCounted
+	{
+		virtual ~RefCounted() = default;
+		virtual unsigned long add_ref() { return ++refs; }
+		virtual unsigned long release() { return --refs; }
+		std::atomic<unsigned long> refs{ 1 };
+	};
+
+	struct RefPtr
+	{
+		RefPtr() = default;
+		RefPtr(RefCounted* p_) : p(p_) { if (p) p->add_ref(); }
+		RefPtr(const RefPtr& other) : RefPtr(other.p) {}
+		RefPtr(RefPtr&& other) noexcept : p(other.p) { other.p = nullptr; }
+		RefPtr& operator=(RefPtr other) { std::swap(p, other.p); return *this; }
+		~RefPtr() { if (p) p->release(); }
+		RefCounted* p = nullptr;
+	};
+
+	// Layout of DXBufferAllocation as it was, with the owning ComPtr
+	struct OwningAllocation
+	{
+		RefPtr base_buffer;
+		uint32_t offset_from_base = 0;
+		uint32_t total_size = 0;
+		uint32_t element_size = 0;
+		uint32_t element_count = 0;
+		uint8_t* mapped_memory = nullptr;
+		uint64_t gpu_adr = 0;
+		bool is_submanaged = false;
+	};
+
+	// Layout of DXBufferAllocation as built by the pool now (no ref held)
+	struct Allocation
+	{
+		RefCounted* base_buffer = nullptr;
+		uint32_t offset_from_base = 0;
+		uint32_t total_size = 0;
+		uint32_t element_size = 0;
+		uint32_t element_count = 0;
+		uint8_t* mapped_memory = nullptr;
+		uint64_t gpu_adr = 0;
+		bool is_submanaged = false;
+	};
+
+	constexpr uint64_t BASE_GPU_ADR = 0x100000000;
+
+	class QueuePool
+	{
+	public:
+		QueuePool(RefCounted* buffer, uint16_t element_size, uint32_t num_elements) :
+			m_element_size(element_size)
+		{
+			for (uint32_t i = 0; i < num_elements; ++i)
+			{
+				OwningAllocation alloc;
+				alloc.base_buffer = RefPtr(buffer);
+				alloc.offset_from_base = i * element_size;
+				alloc.total_size = element_size;
+				alloc.element_size = element_size;
+				alloc.element_count = 1;
+				alloc.gpu_adr = BASE_GPU_ADR + (uint64_t)i * element_size;
+				alloc.is_submanaged = true;
+				m_free.push(std::move(alloc));
+			}
+		}
+
+		OwningAllocation allocate()
+		{
+			if (m_free.empty())
+				return {};
+			auto alloc = std::move(m_free.front());
+			m_free.pop();
+			return alloc;
+		}
+
+		void deallocate(OwningAllocation&& alloc) { m_free.push(alloc); }		// copied, as the pool did
+
+		size_t bookkeeping_bytes() const { return m_free.size() * sizeof(OwningAllocation); }
+
+	private:
+		std::queue<OwningAllocation> m_free;
+		uint16_t m_element_size = 0;
+	};
+
+	// DXBufferMemPool without the resource
+	class IndexPool
+	{
+	public:
+		IndexPool(RefCounted* buffer, uint16_t element_size, uint32_t num_elements) :
+			m_buffer(buffer),
+			m_free_list(num_elements),
+			m_element_size(element_size)
+		{
+		}
+
+		Allocation allocate()
+		{
+			const uint32_t id = m_free_list.allocate();
+			if (id == IndexFreeList::INVALID_INDEX)
+				return {};
+
+			const uint64_t offset = (uint64_t)id * m_element_size;
+			return { m_buffer, (uint32_t)offset, m_element_size, m_element_size, 1, nullptr, BASE_GPU_ADR + offset, true };
+		}
+
+		void deallocate(Allocation&& alloc)
+		{
+			m_free_list.deallocate((uint32_t)((alloc.gpu_adr - BASE_GPU_ADR) / m_element_size));
+		}
+
+		size_t bookkeeping_bytes() const { return m_free_list.bookkeeping_bytes(); }
+
+	private:
+		RefCounted* m_buffer = nullptr;
+		IndexFreeList m_free_list;
+		uint16_t m_element_size = 0;
+	};
+
+	struct PoolConfig
+	{
+		uint16_t element_size = 0;
+		uint32_t num_elements = 0;
+	};
+
+	constexpr PoolConfig POOL_CONFIGS[] = { { 256, 5000 }, { 512, 5000 }, { 1024, 30000 } };
+	constexpr uint32_t NUM_ALLOCATORS = 4;
+	constexpr uint32_t ALLOCS_PER_ROUND = 1000;		// live at once, then freed
+
+	using Clock = std::chrono::steady_clock;
+	volatile uint64_t g_sink = 0;		// keeps the timed loops
+
+	double ms_since(Clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+
+	struct Result
+	{
+		double construct_ms = 0.0;
+		double alloc_free_ns = 0.0;		// per allocate + deallocate pair
+		size_t bookkeeping_bytes = 0;
+		uint64_t checksum = 0;			// of the handed out addresses (the orders differ: FIFO vs LIFO)
+	};
+
+	template <typename Pool, typename Alloc>
+	Result run(uint32_t rounds)
+	{
+		Result result;
+		RefCounted buffers[std::size(POOL_CONFIGS)];
+
+		auto start = Clock::now();
+		std::vector<Pool> pools;
+		pools.reserve(NUM_ALLOCATORS * std::size(POOL_CONFIGS));
+		for (uint32_t i = 0; i < NUM_ALLOCATORS; ++i)
+			for (size_t c = 0; c < std::size(POOL_CONFIGS); ++c)
+				pools.emplace_back(&buffers[c], POOL_CONFIGS[c].element_size, POOL_CONFIGS[c].num_elements);
+		result.construct_ms = ms_since(start);
+
+		for (const auto& pool : pools)
+			result.bookkeeping_bytes += pool.bookkeeping_bytes();
+
+		// the per frame constant pattern: a batch of allocations across the size classes, freed together
+		std::vector<Alloc> live;
+		live.reserve(ALLOCS_PER_ROUND);
+		start = Clock::now();
+		for (uint32_t round = 0; round < rounds; ++round)
+		{
+			auto& pool = pools[round % pools.size()];
+			for (uint32_t i = 0; i < ALLOCS_PER_ROUND; ++i)
+				live.push_back(pool.allocate());
+			for (auto& alloc : live)
+			{
+				result.checksum += alloc.gpu_adr;
+				pool.deallocate(std::move(alloc));
+			}
+			live.clear();
+		}
+		result.alloc_free_ns = ms_since(start) * 1e6 / ((double)rounds * ALLOCS_PER_ROUND);
+		return result;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	const uint32_t rounds = argc > 1 ? (uint32_t)std::strtoul(argv[1], nullptr, 10) : 2000;
+
+	uint32_t num_elements = 0;
+	for (const auto& config : POOL_CONFIGS)
+		num_elements += config.num_elements * NUM_ALLOCATORS;
+
+	// warm up the allocator and caches before timing either
+	run<IndexPool, Allocation>(rounds / 10 + 1);
+
+	const auto queue = run<QueuePool, OwningAllocation>(rounds);
+	const auto index = run<IndexPool, Allocation>(rounds);
+	g_sink = queue.checksum + index.checksum;
+
+	std::printf("%u elements (256/512/1024 B pools x %u allocators), %u rounds of %u allocations\n", num_elements, NUM_ALLOCATORS, rounds, ALLOCS_PER_ROUND);
+	std::printf("%-12s %14s %18s %16s %16s\n", "", "construct ms", "alloc+free ns", "bookkeeping KiB", "bytes/element");
+	std::printf("%-12s %14.2f %18.2f %16.1f %16.1f\n", "queue", queue.construct_ms, queue.alloc_free_ns, queue.bookkeeping_bytes / 1024.0, (double)queue.bookkeeping_bytes / num_elements);
+	std::printf("%-12s %14.2f %18.2f %16.1f %16.1f\n", "index list", index.construct_ms, index.alloc_free_ns, index.bookkeeping_bytes / 1024.0, (double)index.bookkeeping_bytes / num_elements);
+	return 0;
+}
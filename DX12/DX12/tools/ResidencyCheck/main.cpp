@@ -0,0 +1,264 @@
+#include "pch.h"
+#include "Utilities/ResidencyPlanner.h"
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+/*
+	Checks ResidencyPlanner (std-only, runs anywhere).
+
+		- targets meet the requests with enough budget, unrequested textures stay at their tail
+		- the budget is never exceeded (beyond the tails), the texture furthest from its request is served first
+		- holds count frames, also when plan() is skipped for a few frames (e.g while a batch is in flight)
+		- reported changes match the targets, ids are reused after removal
+
+	Build (Linux/macOS, from DX12/DX12):
+		g++ -std=c++17 -O2 -Itools/ResidencyCheck -Isrc tools/ResidencyCheck/main.cpp src/Utilities/ResidencyPlanner.cpp -o residencycheck && ./residencycheck
+*/
+
+namespace
+{
+	uint32_t g_failures = 0;
+
+#define CHECK(cond) do { if (!(cond)) { std::printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); ++g_failures; } } while (0)
+
+	constexpr uint64_t UNLIMITED = ~0ull;
+
+	// Square BC7-like chain (16 bytes per 4x4 block), mips below 4x4 cost a block
+	ResidencyTextureDesc make_desc(uint32_t size, uint32_t tail_mip, uint32_t resident_mip)
+	{
+		ResidencyTextureDesc desc{};
+		for (uint32_t s = size;; s /= 2)
+		{
+			const uint64_t blocks = (std::max)(s / 4, 1u);
+			desc.mip_bytes.push_back(blocks * blocks * 16);
+			if (s == 1)
+				break;
+		}
+		desc.tail_mip = tail_mip;
+		desc.resident_mip = resident_mip;
+		return desc;
+	}
+
+	uint64_t bytes_from(const ResidencyTextureDesc& desc, uint32_t mip)
+	{
+		uint64_t bytes = 0;
+		for (size_t i = mip; i < desc.mip_bytes.size(); ++i)
+			bytes += desc.mip_bytes[i];
+		return bytes;
+	}
+
+	void check_requests()
+	{
+		ResidencyPlanner planner(2);
+		const auto desc = make_desc(1024, 6, 6);
+		const uint32_t a = planner.add_texture(desc);
+		const uint32_t b = planner.add_texture(desc);
+		const uint32_t c = planner.add_texture(desc);
+
+		planner.request(a, 0);
+		planner.request(b, 3);
+		planner.request(b, 2);			// most detailed wins
+		planner.request(c, 9);			// clamped to the tail
+		const auto changes = planner.plan(UNLIMITED, 1);
+
+		CHECK(planner.get_target_mip(a) == 0 && planner.get_target_mip(b) == 2 && planner.get_target_mip(c) == 6);
+		CHECK(changes.size() == 2);
+		for (const auto& change : changes)
+			CHECK(change.from_mip == 6 && change.to_mip == planner.get_target_mip(change.id));
+
+		const auto& stats = planner.get_stats();
+		CHECK(stats.num_textures == 3 && stats.num_over_budget == 0);
+		CHECK(stats.bytes_resident == bytes_from(desc, 0) + bytes_from(desc, 2) + bytes_from(desc, 6));
+		CHECK(stats.bytes_requested == stats.bytes_resident);
+
+		// unchanged requests report nothing
+		planner.request(a, 0);
+		planner.request(b, 2);
+		CHECK(planner.plan(UNLIMITED, 2).empty());
+	}
+
+	void check_budget()
+	{
+		ResidencyPlanner planner(0);
+		const auto desc = make_desc(1024, 6, 6);
+		const uint32_t a = planner.add_texture(desc);
+		const uint32_t b = planner.add_texture(desc);
+
+		// room for both at mip 1 but not for either at mip 0: both get the same mips rather than one getting everything
+		const uint64_t budget = 2 * bytes_from(desc, 1) + desc.mip_bytes[0] / 2;
+		planner.request(a, 0);
+		planner.request(b, 0);
+		planner.plan(budget, 1);
+
+		const auto& stats = planner.get_stats();
+		CHECK(planner.get_target_mip(a) == 1 && planner.get_target_mip(b) == 1);
+		CHECK(stats.bytes_resident <= budget && stats.num_over_budget == 2);
+		CHECK(stats.bytes_requested == 2 * bytes_from(desc, 0));
+
+		// a cheaper texture still fits where a big mip doesn't
+		const auto small_desc = make_desc(64, 4, 4);
+		const uint32_t c = planner.add_texture(small_desc);
+		planner.request(a, 0);
+		planner.request(b, 0);
+		planner.request(c, 0);
+		planner.plan(budget + bytes_from(small_desc, 0), 2);
+		CHECK(planner.get_target_mip(c) == 0);
+		CHECK(planner.get_stats().bytes_resident <= budget + bytes_from(small_desc, 0));
+
+		// the tails are always resident, even over budget
+		planner.plan(0, 3);
+		CHECK(planner.get_target_mip(a) == 6 && planner.get_target_mip(b) == 6 && planner.get_target_mip(c) == 4);
+		CHECK(planner.get_stats().bytes_resident == 2 * bytes_from(desc, 6) + bytes_from(small_desc, 4));
+	}
+
+	void check_hold()
+	{
+		const uint32_t hold_frames = 5;
+		ResidencyPlanner planner(hold_frames);
+		const uint32_t id = planner.add_texture(make_desc(256, 4, 4));
+
+		planner.request(id, 0);
+		planner.plan(UNLIMITED, 1);
+		CHECK(planner.get_target_mip(id) == 0);
+
+		// planned every frame: held for hold_frames after the last request
+		for (uint64_t frame = 2; frame <= 1 + hold_frames; ++frame)
+		{
+			planner.request(id, 3);
+			CHECK(planner.plan(UNLIMITED, frame).empty() && planner.get_target_mip(id) == 0);
+		}
+		planner.request(id, 3);
+		planner.plan(UNLIMITED, 2 + hold_frames);
+		CHECK(planner.get_target_mip(id) == 3);
+
+		// a more detailed request is served right away and held again
+		planner.request(id, 1);
+		planner.plan(UNLIMITED, 10);
+		CHECK(planner.get_target_mip(id) == 1);
+
+		// planning skipped for a few frames: the hold still ends hold_frames later
+		planner.plan(UNLIMITED, 10 + hold_frames);
+		CHECK(planner.get_target_mip(id) == 1);
+		planner.plan(UNLIMITED, 11 + hold_frames);
+		CHECK(planner.get_target_mip(id) == 4);
+
+		// ... and not earlier either, however often plan() runs
+		planner.request(id, 0);
+		planner.plan(UNLIMITED, 20);
+		planner.plan(UNLIMITED, 20);
+		planner.plan(UNLIMITED, 20 + hold_frames);
+		CHECK(planner.get_target_mip(id) == 0);
+
+		// textures added later hold from the frame they were added at
+		const uint32_t late = planner.add_texture(make_desc(256, 4, 0));
+		planner.plan(UNLIMITED, 20 + hold_frames);
+		CHECK(planner.get_target_mip(late) == 0);
+		planner.plan(UNLIMITED, 21 + hold_frames * 2);
+		CHECK(planner.get_target_mip(late) == 4);
+	}
+
+	void check_reuse()
+	{
+		ResidencyPlanner planner(0);
+		const uint32_t a = planner.add_texture(make_desc(256, 4, 0));
+		const uint32_t b = planner.add_texture(make_desc(256, 4, 0));
+		planner.remove_texture(a);
+
+		const uint32_t c = planner.add_texture(make_desc(64, 2, 2));
+		CHECK(c == a);
+		planner.request(c, 0);
+		planner.plan(UNLIMITED, 1);
+		CHECK(planner.get_target_mip(c) == 0 && planner.get_target_mip(b) == 4);
+		CHECK(planner.get_stats().num_textures == 2);
+	}
+
+	void check_random(uint32_t seed)
+	{
+		std::mt19937 rng(seed);
+		ResidencyPlanner planner(4);
+
+		std::vector<ResidencyTextureDesc> descs;
+		std::vector<uint32_t> ids;
+		std::vector<uint32_t> targets;
+		for (uint32_t i = 0; i < 64; ++i)
+		{
+			const uint32_t size = 16u << (rng() % 7);
+			descs.push_back(make_desc(size, rng() % 3 + 2, 0));
+			descs.back().resident_mip = descs.back().tail_mip;
+			ids.push_back(planner.add_texture(descs.back()));
+			targets.push_back(descs.back().tail_mip);
+		}
+
+		uint64_t frame = 0;
+		for (uint32_t step = 0; step < 2000; ++step)
+		{
+			frame += 1 + rng() % 3;			// some frames are skipped
+			for (uint32_t i = 0; i < ids.size(); ++i)
+				if (rng() % 3 != 0)
+					planner.request(ids[i], rng() % 8);
+
+			const uint64_t budget = (uint64_t)(rng() % 4096) * 1024;
+			const auto& changes = planner.plan(budget, frame);
+
+			uint64_t bytes = 0;
+			uint64_t tails = 0;
+			for (uint32_t i = 0; i < ids.size(); ++i)
+			{
+				const uint32_t target = planner.get_target_mip(ids[i]);
+				CHECK(target <= descs[i].tail_mip);
+				bytes += bytes_from(descs[i], target);
+				tails += bytes_from(descs[i], descs[i].tail_mip);
+
+				// every change is reported once with the previous target
+				const auto it = std::find_if(changes.begin(), changes.end(), [&](const ResidencyPlanner::Change& change) { return change.id == ids[i]; });
+				CHECK((it != changes.end()) == (target != targets[i]));
+				if (it != changes.end())
+					CHECK(it->from_mip == targets[i] && it->to_mip == target);
+				targets[i] = target;
+			}
+			CHECK(bytes == planner.get_stats().bytes_resident);
+			CHECK(bytes <= (std::max)(budget, tails));
+
+			if (g_failures > 0)
+			{
+				std::printf("random check failed (seed %u, step %u)\n", seed, step);
+				return;
+			}
+		}
+	}
+
+	void check_screen_size()
+	{
+		const ResidencyView view{ 1.f, 1080.f };
+		CHECK(ResidencyPlanner::mip_for_screen_size(view, 1.f, 2.f, 1024) == 0.f);		// inside the bounds
+
+		float prev = 0.f;
+		for (float distance = 4.f; distance < 4096.f; distance *= 2.f)
+		{
+			const float mip = ResidencyPlanner::mip_for_screen_size(view, distance, 2.f, 1024);
+			CHECK(mip >= prev);
+			prev = mip;
+		}
+
+		// twice the distance, one mip less detailed
+		const float near_mip = ResidencyPlanner::mip_for_screen_size(view, 1000.f, 2.f, 1024);
+		const float far_mip = ResidencyPlanner::mip_for_screen_size(view, 2000.f, 2.f, 1024);
+		CHECK(near_mip > 0.f && far_mip - near_mip > 0.99f && far_mip - near_mip < 1.01f);
+	}
+}
+
+int main()
+{
+	check_requests();
+	check_budget();
+	check_hold();
+	check_reuse();
+	check_screen_size();
+	for (uint32_t seed = 1; seed <= 8 && g_failures == 0; ++seed)
+		check_random(seed);
+
+	std::printf("checks: %s\n", g_failures == 0 ? "passed" : "FAILED");
+	return g_failures == 0 ? 0 : 1;
+}
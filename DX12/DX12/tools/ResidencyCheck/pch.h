@@ -0,0 +1,8 @@
+#pragma once
+/*
+	Portable stand-in for the engine's precompiled header, the check only builds std-only sources from src/Utilities.
+	Must come first on the include path (before src/) so that "pch.h" resolves here.
+*/
+#include <assert.h>
+#include <stdint.h>
+#include <vector>
@@ -0,0 +1,182 @@
+#include "Utilities/RetirementQueue.h"
+#include <algorithm>
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <vector>
+
+/*
+	Checks RetirementQueue against a simulated fence (std-only, runs anywhere).
+
+		- records retired out of order and on fence values that don't increase are released in fence order
+		- nothing is released before the completed value reaches its fence value, everything is released once it does
+		- records retired from within a release (resources freeing other resources) are picked up
+		- release_all flushes every record on shutdown, move-only records are released exactly once
+
+	Build (Linux/macOS, from DX12/DX12):
+		g++ -std=c++17 -O2 -Isrc tools/RetirementCheck/main.cpp -o retirecheck && ./retirecheck
+*/
+
+namespace
+{
+	uint32_t g_failures = 0;
+
+#define CHECK(cond) do { if (!(cond)) { std::printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); ++g_failures; } } while (0)
+
+	struct Record
+	{
+		uint64_t fence_value = 0;
+		uint32_t id = 0;
+	};
+
+	void check_ordering()
+	{
+		RetirementQueue<Record> queue;
+		const uint64_t values[] = { 5, 3, 3, 7, 1, 5, 2 };
+		uint32_t id = 0;
+		for (auto value : values)
+			queue.retire(value, { value, id++ });
+		CHECK(queue.size() == std::size(values));
+
+		std::vector<Record> released;
+		auto release = [&](const Record& record) { released.push_back(record); };
+
+		CHECK(queue.release_completed(0, release) == 0);
+		CHECK(queue.release_completed(2, release) == 2);
+		CHECK(released.size() == 2 && released[0].fence_value == 1 && released[1].fence_value == 2);
+
+		// equal values keep their retirement order
+		CHECK(queue.release_completed(3, release) == 2);
+		CHECK(released.size() == 4 && released[2].id == 1 && released[3].id == 2);
+
+		// the completed value may skip ahead
+		CHECK(queue.release_completed(6, release) == 2);
+		CHECK(released.size() == 6 && released[4].id == 0 && released[5].id == 5);
+		CHECK(queue.size() == 1 && queue.release_completed(6, release) == 0);
+
+		CHECK(queue.release_completed(7, release) == 1 && queue.empty());
+		for (size_t i = 1; i < released.size(); ++i)
+			CHECK(released[i - 1].fence_value <= released[i].fence_value);
+	}
+
+	void check_retire_on_release()
+	{
+		RetirementQueue<Record> queue;
+		queue.retire(1, { 1, 0 });
+
+		// releasing record 0 retires record 1 on a value that has already completed, and record 2 on a later one
+		std::vector<uint32_t> released;
+		uint32_t num = queue.release_completed(4, [&](const Record& record)
+			{
+				released.push_back(record.id);
+				if (record.id == 0)
+				{
+					queue.retire(2, { 2, 1 });
+					queue.retire(9, { 9, 2 });
+				}
+			});
+		CHECK(num == 2 && released.size() == 2 && released[1] == 1);
+		CHECK(queue.size() == 1);
+	}
+
+	// A GPU completing frames at its own pace while the CPU retires records against the current and earlier values
+	void check_simulated(uint32_t seed)
+	{
+		std::mt19937 rng(seed);
+		RetirementQueue<Record> queue;
+
+		uint64_t current = 1;			// value signaled at the end of the frame being recorded
+		uint64_t completed = 0;
+		uint32_t num_retired = 0;
+		uint32_t num_released = 0;
+		std::vector<bool> released(20000, false);
+		std::vector<uint64_t> retired_on(released.size(), 0);
+
+		auto release = [&](const Record& record)
+		{
+			CHECK(record.fence_value <= completed);
+			CHECK(!released[record.id]);
+			released[record.id] = true;
+			++num_released;
+		};
+
+		while (num_retired < released.size())
+		{
+			// records retired this frame, mostly on the current value, some on values that are not increasing
+			// (e.g resources only used by an earlier frame) or on a later one
+			const uint32_t count = rng() % 8;
+			for (uint32_t i = 0; i < count && num_retired < released.size(); ++i)
+			{
+				uint64_t value = current;
+				const uint32_t kind = rng() % 10;
+				if (kind < 2 && current > 3)
+					value = current - 1 - rng() % 3;
+				else if (kind == 2)
+					value = current + 1;
+				retired_on[num_retired] = value;
+				queue.retire(value, { value, num_retired++ });
+			}
+
+			// up to three frames in flight, the GPU catches up unevenly
+			++current;
+			if (current - completed > 3 || rng() % 2)
+				completed = (std::min)(current - 1, completed + 1 + rng() % 2);
+
+			queue.release_completed(completed, release);
+
+			// everything that completed is out, nothing else is
+			for (uint32_t id = 0; id < num_retired; ++id)
+				CHECK(released[id] == (retired_on[id] <= completed));
+			if (g_failures > 0)
+			{
+				std::printf("simulated check failed (seed %u, frame %llu)\n", seed, (unsigned long long)current);
+				return;
+			}
+		}
+
+		// shutdown: the device is idle, flush
+		completed = ~0ull;
+		queue.release_all(release);
+		CHECK(queue.empty() && num_released == num_retired);
+	}
+
+	void check_move_only()
+	{
+		uint32_t destroyed = 0;
+		struct Tracked
+		{
+			uint32_t* destroyed = nullptr;
+			~Tracked() { if (destroyed) ++*destroyed; }
+		};
+
+		RetirementQueue<std::unique_ptr<Tracked>> queue;
+		for (uint64_t value = 4; value > 0; --value)
+		{
+			auto record = std::make_unique<Tracked>();
+			record->destroyed = &destroyed;
+			queue.retire(value, std::move(record));
+		}
+
+		// release takes ownership of some records and lets the queue drop the others
+		std::vector<std::unique_ptr<Tracked>> kept;
+		queue.release_completed(2, [&](std::unique_ptr<Tracked>& record) { kept.push_back(std::move(record)); });
+		CHECK(kept.size() == 2 && destroyed == 0 && queue.size() == 2);
+
+		queue.release_all([](std::unique_ptr<Tracked>&) {});
+		CHECK(destroyed == 2 && queue.empty());
+		kept.clear();
+		CHECK(destroyed == 4);
+	}
+}
+
+int main()
+{
+	check_ordering();
+	check_retire_on_release();
+	check_move_only();
+	for (uint32_t seed = 1; seed <= 8 && g_failures == 0; ++seed)
+		check_simulated(seed);
+
+	std::printf("checks: %s\n", g_failures == 0 ? "passed" : "FAILED");
+	return g_failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,507 @@
+#include "pch.h"
+#include "Utilities/TLSFAllocator.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iterator>
+#include <map>
+#include <random>
+
+/*
+	Checks and a synthetic trace benchmark of TLSFAllocator (std-only, runs anywhere).
+
+	Checks:
+		- block splitting and merging with both physical neighbours
+		- alignment: padding given back as a free block and reused, alignment of one granule, alignment larger than the range
+		- largest free block and fragmentation after frees
+		- randomized allocate/free sequences against a reference model of the occupied ranges: no overlap, in range, aligned,
+		  free blocks exactly the gaps of the model (full coalescing), failures only when no gap could be found by a good fit
+
+	Benchmark: one allocate/free trace replayed on TLSFAllocator and on the first-fit free list it replaced
+	(the previous DXDescriptorPool, ported onto plain offsets, the buffer path used one committed resource per buffer before).
+	The trace models placed buffers in a 64 MB heap of 64 KB granules at ~60% occupancy.
+
+	Build (Linux/macOS, from DX12/DX12):
+		g++ -std=c++17 -O2 -Itools/TLSFCheck -Isrc tools/TLSFCheck/main.cpp src/Utilities/TLSFAllocator.cpp -o tlsfcheck && ./tlsfcheck [trace ops, default 1000000]
+*/
+
+namespace
+{
+	uint32_t g_failures = 0;
+
+#define CHECK(cond) do { if (!(cond)) { std::printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); ++g_failures; } } while (0)
+
+	// Smallest block size which mapping_search is guaranteed to find (the search rounds up to the next second level bin)
+	uint64_t good_fit_size(uint64_t units)
+	{
+		if (units < 16)
+			return units;
+		uint32_t msb = 63;
+		while (!(units >> msb))
+			--msb;
+		const uint64_t round = ((uint64_t)1 << (msb - 4)) - 1;
+		return (units + round) & ~round;
+	}
+
+	// Occupied ranges in granules, checked against the allocator after every operation
+	class ReferenceModel
+	{
+	public:
+		ReferenceModel(uint64_t capacity) : m_capacity(capacity) {}
+
+		bool insert(uint64_t offset, uint64_t size)
+		{
+			if (offset + size > m_capacity)
+				return false;
+			auto next = m_used.lower_bound(offset);
+			if (next != m_used.end() && next->first < offset + size)
+				return false;
+			if (next != m_used.begin() && std::prev(next)->first + std::prev(next)->second > offset)
+				return false;
+			m_used.insert({ offset, size });
+			m_used_size += size;
+			return true;
+		}
+
+		void erase(uint64_t offset)
+		{
+			auto it = m_used.find(offset);
+			m_used_size -= it->second;
+			m_used.erase(it);
+		}
+
+		// Free ranges are exactly the gaps between occupied ranges once everything is coalesced
+		void gaps(uint32_t& count, uint64_t& largest) const
+		{
+			count = 0;
+			largest = 0;
+			uint64_t end = 0;
+			for (const auto& [offset, size] : m_used)
+			{
+				if (offset > end)
+				{
+					++count;
+					largest = (std::max)(largest, offset - end);
+				}
+				end = offset + size;
+			}
+			if (end < m_capacity)
+			{
+				++count;
+				largest = (std::max)(largest, m_capacity - end);
+			}
+		}
+
+		uint64_t used() const { return m_used_size; }
+
+	private:
+		uint64_t m_capacity = 0;
+		uint64_t m_used_size = 0;
+		std::map<uint64_t, uint64_t> m_used;
+	};
+
+	// The first-fit free chunk list of the previous DXDescriptorPool on plain offsets (chunks in units, behaviour kept as is)
+	class FirstFitRanges
+	{
+	public:
+		FirstFitRanges(uint64_t capacity)
+		{
+			m_free_chunks.reserve(capacity);
+			m_free_chunks.push_back({ 0, capacity });
+		}
+
+		// ~0 if there is no chunk large enough
+		uint64_t allocate(uint64_t size)
+		{
+			for (auto it = m_free_chunks.begin(); it != m_free_chunks.end(); ++it)
+			{
+				auto& chunk = *it;
+				if (chunk.size == size)
+				{
+					const uint64_t offset = chunk.start;
+					m_free_chunks.erase(it);
+					return offset;
+				}
+				else if (chunk.size > size)
+				{
+					const uint64_t offset = chunk.start;
+					chunk.start += size;
+					chunk.size -= size;
+					return offset;
+				}
+			}
+			return ~0ull;
+		}
+
+		void deallocate(uint64_t offset, uint64_t size)
+		{
+			const uint64_t end = offset + size;
+			if (m_free_chunks.size() > 1)
+			{
+				// only the first pair of chunks is ever looked at
+				auto& left = m_free_chunks[0];
+				auto& right = m_free_chunks[1];
+				const bool merge_left = offset == left.start + left.size;
+				const bool merge_right = end == right.start;
+				if (merge_left && merge_right)
+				{
+					left.size += size + right.size;
+					m_free_chunks.erase(m_free_chunks.begin() + 1);
+				}
+				else if (merge_left)
+					left.size += size;
+				else if (merge_right)
+				{
+					right.start = offset;
+					right.size += size;
+				}
+				else
+					m_free_chunks.push_back({ offset, size });
+			}
+			else if (m_free_chunks.size() == 1)
+			{
+				auto& chunk = m_free_chunks[0];
+				if (offset == chunk.start + chunk.size)
+					chunk.size += size;
+				else if (end == chunk.start)
+				{
+					chunk.start = offset;
+					chunk.size += size;
+				}
+				else if (offset < chunk.start)
+				{
+					m_free_chunks.push_back(m_free_chunks[0]);
+					m_free_chunks[0] = { offset, size };
+				}
+				else
+					m_free_chunks.push_back({ offset, size });
+			}
+			else
+				m_free_chunks.push_back({ offset, size });
+		}
+
+		uint32_t free_chunks() const { return (uint32_t)m_free_chunks.size(); }
+		uint64_t largest_free() const
+		{
+			uint64_t largest = 0;
+			for (const auto& chunk : m_free_chunks)
+				largest = (std::max)(largest, chunk.size);
+			return largest;
+		}
+
+	private:
+		struct Chunk
+		{
+			uint64_t start = 0;
+			uint64_t size = 0;
+		};
+
+		std::vector<Chunk> m_free_chunks;
+	};
+
+	void check_split_merge()
+	{
+		TLSFAllocator ator(1024);
+		const auto a = ator.allocate(100);
+		const auto b = ator.allocate(200);
+		const auto c = ator.allocate(300);
+		CHECK(a.valid() && b.valid() && c.valid());
+		CHECK(a.offset == 0 && b.offset == 100 && c.offset == 300);
+		CHECK(ator.get_report().free_blocks == 1 && ator.get_report().largest_free == 424);
+
+		// split blocks keep their size
+		CHECK(ator.get_block_size(a.block) == 100 && ator.get_block_size(b.block) == 200 && ator.get_block_size(c.block) == 300);
+
+		// no free neighbour
+		ator.deallocate(b.block);
+		CHECK(ator.get_report().free_blocks == 2 && ator.get_used() == 400);
+
+		// merges with the next block
+		ator.deallocate(a.block);
+		auto report = ator.get_report();
+		CHECK(report.free_blocks == 2 && report.largest_free == 424 && report.free == 724);
+
+		// the merged block is reusable as a whole
+		const auto d = ator.allocate(290);
+		CHECK(d.valid() && (d.offset + d.size <= 300 || d.offset >= 600));
+
+		// merges with both neighbours, back to a single block
+		ator.deallocate(d.block);
+		ator.deallocate(c.block);
+		report = ator.get_report();
+		CHECK(report.free_blocks == 1 && report.largest_free == 1024 && report.used == 0 && ator.empty());
+	}
+
+	void check_alignment()
+	{
+		// leading padding is given back and can be reused
+		{
+			TLSFAllocator ator(1024);
+			const auto a = ator.allocate(3);
+			const auto b = ator.allocate(10, 256);
+			CHECK(b.valid() && b.offset == 256);
+			CHECK(ator.get_report().free_blocks == 2 && ator.get_used() == 13);
+
+			const auto c = ator.allocate(200);
+			CHECK(c.valid() && c.offset == 3);
+
+			ator.deallocate(a.block);
+			ator.deallocate(b.block);
+			ator.deallocate(c.block);
+			CHECK(ator.get_report().free_blocks == 1 && ator.empty());
+		}
+
+		// sizes round up to the granularity, alignment of one granule adds nothing
+		{
+			TLSFAllocator ator(64 * 1024, 64);
+			const auto a = ator.allocate(1);
+			const auto b = ator.allocate(65, 64);
+			const auto c = ator.allocate(0);
+			CHECK(a.valid() && a.size == 64 && a.offset == 0);
+			CHECK(b.valid() && b.size == 128 && b.offset == 64);
+			CHECK(c.valid() && c.size == 64 && c.offset == 192);
+			CHECK(ator.get_report().free_blocks == 1);
+		}
+
+		// placed resource alignment (64 KB granules, 4 MB MSAA alignment)
+		{
+			const uint64_t KB = 1024, MB = 1024 * KB;
+			TLSFAllocator ator(64 * MB, 64 * KB);
+			const auto a = ator.allocate(64 * KB);
+			const auto b = ator.allocate(1 * MB, 4 * MB);
+			CHECK(b.valid() && b.offset == 4 * MB && b.offset % (4 * MB) == 0);
+			const auto c = ator.allocate(3 * MB + 512 * KB);
+			CHECK(c.valid() && (c.offset + c.size <= 4 * MB || c.offset >= 5 * MB));
+			ator.deallocate(a.block);
+			ator.deallocate(b.block);
+			ator.deallocate(c.block);
+			CHECK(ator.get_report().free_blocks == 1 && ator.get_report().largest_free == 64 * MB);
+		}
+
+		// alignment and size beyond the range fail cleanly
+		{
+			TLSFAllocator ator(1024);
+			CHECK(!ator.allocate(1, 2048).valid());
+			CHECK(!ator.allocate(1025).valid());
+			const auto whole = ator.allocate(1024);
+			CHECK(whole.valid() && whole.offset == 0 && !ator.allocate(1).valid());
+			ator.deallocate(whole.block);
+			CHECK(ator.get_report().free_blocks == 1);
+		}
+	}
+
+	void check_largest_free()
+	{
+		TLSFAllocator ator(1000);
+		std::vector<TLSFAllocator::Allocation> allocs;
+		for (uint32_t i = 0; i < 10; ++i)
+			allocs.push_back(ator.allocate(100));
+		CHECK(ator.get_report().largest_free == 0 && ator.get_report().free_blocks == 0 && !ator.allocate(1).valid());
+
+		// every other block: five separate holes
+		for (uint32_t i = 0; i < 10; i += 2)
+			ator.deallocate(allocs[i].block);
+		auto report = ator.get_report();
+		CHECK(report.free_blocks == 5 && report.largest_free == 100 && report.free == 500);
+		CHECK(report.fragmentation() > 0.79f && report.fragmentation() < 0.81f);
+		CHECK(!ator.allocate(101).valid());
+
+		// 3 and 5 join holes 2..6 into one
+		ator.deallocate(allocs[3].block);
+		ator.deallocate(allocs[5].block);
+		report = ator.get_report();
+		CHECK(report.free_blocks == 3 && report.largest_free == 500);
+
+		for (uint32_t i : { 1u, 7u, 9u })
+			ator.deallocate(allocs[i].block);
+		report = ator.get_report();
+		CHECK(report.free_blocks == 1 && report.largest_free == 1000 && report.fragmentation() == 0.f);
+	}
+
+	void check_random(uint32_t seed, uint64_t capacity, uint64_t granularity, uint32_t ops)
+	{
+		std::mt19937 rng(seed);
+		TLSFAllocator ator(capacity, granularity);
+		ReferenceModel model(capacity / granularity);
+		std::vector<TLSFAllocator::Allocation> live;
+
+		const uint64_t units = capacity / granularity;
+		for (uint32_t op = 0; op < ops; ++op)
+		{
+			// drift the live set up and down so that the range fills up and empties
+			const bool fill = (op / 2000) % 2 == 0;
+			if (live.empty() || rng() % 100 < (fill ? 65u : 35u))
+			{
+				const uint64_t size = (1 + rng() % (rng() % 8 == 0 ? units / 8 : units / 128)) * granularity - rng() % granularity;
+				const uint64_t alignments[] = { 0, granularity, granularity * 4, granularity * 64 };
+				const uint64_t alignment = alignments[rng() % 4];
+
+				const auto alloc = ator.allocate(size, alignment);
+				if (!alloc.valid())
+				{
+					// a good fit only fails if no free range holds the size plus the worst case padding
+					uint32_t num_gaps = 0;
+					uint64_t largest = 0;
+					model.gaps(num_gaps, largest);
+					const uint64_t align_units = alignment > granularity ? alignment / granularity : 1;
+					CHECK(largest < good_fit_size((size + granularity - 1) / granularity + align_units - 1));
+					continue;
+				}
+
+				CHECK(alloc.size >= size && alloc.size % granularity == 0);
+				CHECK(alignment == 0 || alloc.offset % alignment == 0);
+				CHECK(model.insert(alloc.offset / granularity, alloc.size / granularity));
+				live.push_back(alloc);
+			}
+			else
+			{
+				const size_t idx = rng() % live.size();
+				model.erase(live[idx].offset / granularity);
+				ator.deallocate(live[idx].block);
+				live[idx] = live.back();
+				live.pop_back();
+			}
+
+			uint32_t num_gaps = 0;
+			uint64_t largest = 0;
+			model.gaps(num_gaps, largest);
+			const auto report = ator.get_report();
+			CHECK(report.used == model.used() * granularity && report.allocations == live.size());
+			CHECK(report.free_blocks == num_gaps && report.largest_free == largest * granularity);
+			if (g_failures > 0)
+			{
+				std::printf("random check failed (seed %u, op %u)\n", seed, op);
+				return;
+			}
+		}
+
+		for (const auto& alloc : live)
+			ator.deallocate(alloc.block);
+		const auto report = ator.get_report();
+		CHECK(report.free_blocks == 1 && report.largest_free == capacity && ator.empty());
+	}
+
+	// Allocate size (in units) or free the live allocation at (index % live count)
+	struct TraceOp
+	{
+		bool allocate = false;
+		uint32_t value = 0;
+	};
+
+	std::vector<TraceOp> make_trace(uint32_t num_ops, uint64_t capacity_units)
+	{
+		std::mt19937 rng(7);
+		std::vector<TraceOp> trace;
+		trace.reserve(num_ops);
+
+		// mostly small buffers with the odd large one, the live set hovers around 60% of the heap
+		uint64_t live_units = 0;
+		std::vector<uint32_t> live_sizes;
+		for (uint32_t i = 0; i < num_ops; ++i)
+		{
+			const bool allocate = live_sizes.empty() || (live_units < capacity_units * 6 / 10 ? rng() % 100 < 60 : rng() % 100 < 40);
+			if (allocate)
+			{
+				const uint32_t size = rng() % 16 == 0 ? 16 + rng() % 48 : 1 + rng() % 4;
+				trace.push_back({ true, size });
+				live_sizes.push_back(size);
+				live_units += size;
+			}
+			else
+			{
+				const uint32_t idx = rng();
+				trace.push_back({ false, idx });
+				const size_t at = idx % live_sizes.size();
+				live_units -= live_sizes[at];
+				live_sizes[at] = live_sizes.back();
+				live_sizes.pop_back();
+			}
+		}
+		return trace;
+	}
+
+	struct TraceResult
+	{
+		double ns_per_op = 0.0;
+		uint32_t failures = 0;
+		uint32_t free_chunks = 0;		// before freeing the remaining live set
+		uint64_t largest_free = 0;		// in units
+	};
+
+	// Failed allocations are skipped, the following frees pick among the allocations that succeeded
+	template <typename Allocate, typename Deallocate, typename Report>
+	TraceResult replay(const std::vector<TraceOp>& trace, Allocate&& allocate, Deallocate&& deallocate, Report&& report)
+	{
+		using Clock = std::chrono::steady_clock;
+		TraceResult result{};
+		std::vector<std::pair<uint64_t, uint64_t>> live;		// allocation id, size
+		live.reserve(trace.size());
+
+		const auto start = Clock::now();
+		for (const auto& op : trace)
+		{
+			if (op.allocate)
+			{
+				uint64_t id = 0;
+				if (allocate(op.value, id))
+					live.push_back({ id, op.value });
+				else
+					++result.failures;
+			}
+			else if (!live.empty())
+			{
+				const size_t at = op.value % live.size();
+				deallocate(live[at].first, live[at].second);
+				live[at] = live.back();
+				live.pop_back();
+			}
+		}
+		result.ns_per_op = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / (double)trace.size();
+
+		report(result);
+		for (const auto& [id, size] : live)
+			deallocate(id, size);
+		return result;
+	}
+
+	void bench(uint32_t num_ops)
+	{
+		constexpr uint64_t CAPACITY_UNITS = 1024;		// 64 MB heap of 64 KB placement granules
+		const auto trace = make_trace(num_ops, CAPACITY_UNITS);
+
+		TLSFAllocator tlsf(CAPACITY_UNITS);
+		const auto tlsf_result = replay(trace,
+			[&](uint64_t size, uint64_t& id) { const auto alloc = tlsf.allocate(size); id = alloc.block; return alloc.valid(); },
+			[&](uint64_t id, uint64_t) { tlsf.deallocate((uint32_t)id); },
+			[&](TraceResult& result) { const auto report = tlsf.get_report(); result.free_chunks = report.free_blocks; result.largest_free = report.largest_free; });
+		CHECK(tlsf.get_report().free_blocks == 1 && tlsf.empty());
+
+		FirstFitRanges first_fit(CAPACITY_UNITS);
+		const auto first_fit_result = replay(trace,
+			[&](uint64_t size, uint64_t& id) { id = first_fit.allocate(size); return id != ~0ull; },
+			[&](uint64_t id, uint64_t size) { first_fit.deallocate(id, size); },
+			[&](TraceResult& result) { result.free_chunks = first_fit.free_chunks(); result.largest_free = first_fit.largest_free(); });
+
+		std::printf("\n%u op trace, %llu unit range (64 MB of 64 KB granules), ~60%% occupied\n", num_ops, (unsigned long long)CAPACITY_UNITS);
+		std::printf("%-12s %14s %12s %14s %16s\n", "", "ns/op", "failures", "free chunks", "largest free");
+		std::printf("%-12s %14.1f %12u %14u %16llu\n", "TLSF", tlsf_result.ns_per_op, tlsf_result.failures, tlsf_result.free_chunks, (unsigned long long)tlsf_result.largest_free);
+		std::printf("%-12s %14.1f %12u %14u %16llu\n", "first-fit", first_fit_result.ns_per_op, first_fit_result.failures, first_fit_result.free_chunks, (unsigned long long)first_fit_result.largest_free);
+		std::printf("(first-fit after teardown: %u free chunks, largest %llu of %llu units)\n", first_fit.free_chunks(), (unsigned long long)first_fit.largest_free(), (unsigned long long)CAPACITY_UNITS);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	const uint32_t num_ops = argc > 1 ? (uint32_t)std::strtoul(argv[1], nullptr, 10) : 1000000;
+
+	check_split_merge();
+	check_alignment();
+	check_largest_free();
+	for (uint32_t seed = 1; seed <= 8 && g_failures == 0; ++seed)
+		check_random(seed, seed % 2 ? 1024 * 1024 : 64 * 1024 * 1024, seed % 2 ? 1 : 64 * 1024, 20000);
+	std::printf("checks: %s\n", g_failures == 0 ? "passed" : "FAILED");
+
+	bench(num_ops);
+	return g_failures == 0 ? 0 : 1;
+}
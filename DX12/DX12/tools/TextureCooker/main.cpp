@@ -0,0 +1,242 @@
+#include "pch.h"
+#include "Utilities/TextureCooker.h"
+#include "Utilities/MappedFile.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+
+/*
+	Offline texture cooker, writes a .ctex container next to the input (DXTextureManager picks it up instead of the source image).
+
+	Input is binary netpbm (P5 / P6 / P7 with maxval 255), convert sources first, e.g:
+		convert textures/foo.png textures/foo.pam && texcook textures/foo.pam --role color --srgb
+
+	--bench-mips <n> times the SIMD mip generator against the scalar reference instead of cooking (n runs per path after
+	an untimed warmup run), e.g over a texture set:
+		find models/Sponza_gltf -name "*.pam" -exec texcook {} --srgb --bench-mips 10 \;
+
+	Build (Linux/macOS, from DX12/DX12):
+		g++ -std=c++17 -O2 -mavx2 -Itools/TextureCooker -Isrc tools/TextureCooker/main.cpp src/Utilities/BCEncoder.cpp src/Utilities/MipGenerator.cpp
+			src/Utilities/TextureCooker.cpp src/Utilities/TextureContainer.cpp src/Utilities/MappedFile.cpp -o texcook
+*/
+
+namespace
+{
+	struct RGBAImage
+	{
+		uint32_t width = 0;
+		uint32_t height = 0;
+		std::vector<uint8_t> rgba;
+	};
+
+	// Reads a whitespace separated header token, skipping comments
+	std::string next_token(const uint8_t* data, size_t size, size_t& pos)
+	{
+		std::string token;
+		while (pos < size)
+		{
+			const char c = (char)data[pos];
+			if (c == '#')
+			{
+				while (pos < size && data[pos] != '\n')
+					++pos;
+				continue;
+			}
+			if (std::isspace((unsigned char)c))
+			{
+				++pos;
+				if (!token.empty())
+					break;
+				continue;
+			}
+			token += c;
+			++pos;
+		}
+		return token;
+	}
+
+	bool load_netpbm(const std::filesystem::path& path, RGBAImage& img)
+	{
+		MappedFile file;
+		if (!file.open(path))
+			return false;
+
+		const auto data = file.data();
+		const auto size = file.size();
+		size_t pos = 0;
+
+		const auto magic = next_token(data, size, pos);
+		uint32_t channels = 0, maxval = 0;
+		if (magic == "P5" || magic == "P6")
+		{
+			channels = magic == "P5" ? 1 : 3;
+			img.width = (uint32_t)std::stoul(next_token(data, size, pos));
+			img.height = (uint32_t)std::stoul(next_token(data, size, pos));
+			maxval = (uint32_t)std::stoul(next_token(data, size, pos));		// single whitespace consumed before the raster
+		}
+		else if (magic == "P7")
+		{
+			for (auto token = next_token(data, size, pos); token != "ENDHDR" && !token.empty(); token = next_token(data, size, pos))
+			{
+				if (token == "WIDTH")
+					img.width = (uint32_t)std::stoul(next_token(data, size, pos));
+				else if (token == "HEIGHT")
+					img.height = (uint32_t)std::stoul(next_token(data, size, pos));
+				else if (token == "DEPTH")
+					channels = (uint32_t)std::stoul(next_token(data, size, pos));
+				else if (token == "MAXVAL")
+					maxval = (uint32_t)std::stoul(next_token(data, size, pos));
+				else if (token == "TUPLTYPE")
+					next_token(data, size, pos);
+			}
+		}
+		else
+			return false;
+
+		if (maxval != 255 || channels == 0 || channels > 4 || img.width == 0 || img.height == 0)
+			return false;
+
+		const size_t num_texels = (size_t)img.width * img.height;
+		if (pos + num_texels * channels > size)
+			return false;
+
+		img.rgba.resize(num_texels * 4);
+		for (size_t i = 0; i < num_texels; ++i)
+		{
+			const uint8_t* src = data + pos + i * channels;
+			uint8_t* dst = &img.rgba[i * 4];
+			switch (channels)
+			{
+			case 1: dst[0] = dst[1] = dst[2] = src[0]; dst[3] = 255; break;
+			case 2: dst[0] = dst[1] = dst[2] = src[0]; dst[3] = src[1]; break;
+			case 3: dst[0] = src[0]; dst[1] = src[1]; dst[2] = src[2]; dst[3] = 255; break;
+			default: std::memcpy(dst, src, 4); break;
+			}
+		}
+		return true;
+	}
+
+	void print_usage()
+	{
+		std::cout << "usage: texcook <input.pam|ppm|pgm> [--role color|normal|mask] [--srgb] [--fast] [--filter box|kaiser] [-o output.ctex] [--bench-mips <iterations>]\n";
+	}
+
+	double time_mip_chain(const RGBAImage& img, const MipGenDesc& desc, uint32_t iterations, std::vector<MipLevel>& levels)
+	{
+		// untimed warmup: first touch of the output allocations and caches would otherwise count against whichever path runs first
+		levels = generate_mip_chain(img.rgba.data(), img.width, img.height, desc);
+
+		const auto start = std::chrono::high_resolution_clock::now();
+		for (uint32_t i = 0; i < iterations; ++i)
+			levels = generate_mip_chain(img.rgba.data(), img.width, img.height, desc);
+		const auto end = std::chrono::high_resolution_clock::now();
+		return std::chrono::duration<double, std::milli>(end - start).count() / iterations;
+	}
+
+	void bench_mips(const std::filesystem::path& input, const RGBAImage& img, const TextureCookDesc& cook_desc, uint32_t iterations)
+	{
+		MipGenDesc desc{};
+		desc.filter = cook_desc.mip_filter;
+		desc.srgb = cook_desc.srgb && cook_desc.role == TextureRole::eColor;
+		desc.normal_map = cook_desc.role == TextureRole::eNormal;
+
+		std::vector<MipLevel> scalar_levels, simd_levels;
+		desc.kernel = MipKernel::eScalar;
+		const double scalar_ms = time_mip_chain(img, desc, iterations, scalar_levels);
+		desc.kernel = MipKernel::eSIMD;
+		const double simd_ms = time_mip_chain(img, desc, iterations, simd_levels);
+
+		// largest per-channel difference over the whole chain
+		int32_t max_diff = 0;
+		for (size_t level = 0; level < scalar_levels.size(); ++level)
+			for (size_t i = 0; i < scalar_levels[level].rgba.size(); ++i)
+				max_diff = (std::max)(max_diff, std::abs((int32_t)scalar_levels[level].rgba[i] - (int32_t)simd_levels[level].rgba[i]));
+
+		std::cout << input.string() << ": " << img.width << "x" << img.height << ", " << scalar_levels.size() << " mips, "
+			<< "scalar " << scalar_ms << " ms, " << mip_simd_isa() << " " << simd_ms << " ms (" << scalar_ms / simd_ms << "x), max diff " << max_diff << "\n";
+	}
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		print_usage();
+		return 1;
+	}
+
+	std::filesystem::path input = argv[1];
+	std::filesystem::path output = std::filesystem::path(input).replace_extension(".ctex");
+	TextureCookDesc desc{};
+	uint32_t bench_iterations = 0;
+
+	for (int i = 2; i < argc; ++i)
+	{
+		const std::string arg = argv[i];
+		if (arg == "--srgb")
+			desc.srgb = true;
+		else if (arg == "--fast")
+			desc.fast = true;
+		else if (arg == "--role" && i + 1 < argc)
+		{
+			const std::string role = argv[++i];
+			if (role == "color")
+				desc.role = TextureRole::eColor;
+			else if (role == "normal")
+				desc.role = TextureRole::eNormal;
+			else if (role == "mask")
+				desc.role = TextureRole::eMask;
+			else
+			{
+				print_usage();
+				return 1;
+			}
+		}
+		else if (arg == "--filter" && i + 1 < argc)
+		{
+			const std::string filter = argv[++i];
+			if (filter == "box")
+				desc.mip_filter = MipFilter::eBox;
+			else if (filter == "kaiser")
+				desc.mip_filter = MipFilter::eKaiser;
+			else
+			{
+				print_usage();
+				return 1;
+			}
+		}
+		else if (arg == "--bench-mips" && i + 1 < argc)
+			bench_iterations = (std::max)((uint32_t)std::stoul(argv[++i]), 1u);
+		else if (arg == "-o" && i + 1 < argc)
+			output = argv[++i];
+		else
+		{
+			print_usage();
+			return 1;
+		}
+	}
+
+	RGBAImage img;
+	if (!load_netpbm(input, img))
+	{
+		std::cerr << "failed to load " << input << "\n";
+		return 1;
+	}
+
+	if (bench_iterations > 0)
+	{
+		bench_mips(input, img, desc, bench_iterations);
+		return 0;
+	}
+
+	const auto cooked = cook_texture(img.rgba.data(), img.width, img.height, desc);
+	if (!write_texture_container(output, cooked))
+	{
+		std::cerr << "failed to write " << output << "\n";
+		return 1;
+	}
+
+	std::cout << output.string() << ": " << img.width << "x" << img.height << ", " << cooked.mips.size() << " mips\n";
+	return 0;
+}
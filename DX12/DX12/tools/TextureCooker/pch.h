@@ -0,0 +1,12 @@
+#pragma once
+/*
+	Portable stand-in for the engine's precompiled header, the cooker only builds std-only sources from src/Utilities.
+	Must come first on the include path (before src/) so that "pch.h" resolves here.
+*/
+#include <assert.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <memory>
+#include <filesystem>
+#include <iostream>
@@ -0,0 +1,169 @@
+#include "pch.h"
+#include "Utilities/HandlePool.h"
+#include "Utilities/TextureSlotState.h"
+#include <algorithm>
+#include <cstdio>
+
+/*
+	Checks the texture lifetime bookkeeping of DXTextureManager headless (std-only, runs anywhere):
+	TextureSlotState in a HandlePool, driven the way the manager drives it.
+
+		- a texture destroyed with an upload in flight is freed by its last upload, the slot is reused by the next load
+		  and the new texture is neither destroyed nor holding uploads of the previous one
+		- references are counted per path, paths are dropped once unreferenced, references without a path go first
+
+	Build (Linux/macOS, from DX12/DX12):
+		g++ -std=c++17 -O2 -Itools/TextureSlotCheck -Isrc tools/TextureSlotCheck/main.cpp src/Utilities/TextureSlotState.cpp -o slotcheck && ./slotcheck
+*/
+
+namespace
+{
+	uint32_t g_failures = 0;
+
+#define CHECK(cond) do { if (!(cond)) { std::printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); ++g_failures; } } while (0)
+
+	struct Slot : TextureSlotState
+	{
+		uint64_t handle = 0;
+		void destroy() {}			// like DXTextureManager, the state itself isn't reset on free
+	};
+
+	constexpr uint64_t SLOT_MASK = 0xFFFFFFFF;
+
+	// The manager's flow for an async load (create_texture_async) and for destroy_texture
+	struct Manager
+	{
+		HandlePool<Slot> slots;
+		std::vector<uint64_t> freed;
+
+		uint64_t create_async(const std::string& path)
+		{
+			auto [handle, slot] = slots.get_next_free_handle();
+			slot->acquire(path, 0);
+			slot->begin_upload();
+			return handle;
+		}
+
+		void end_upload(uint64_t handle)
+		{
+			if (slots.get_resource(handle)->end_upload())
+				free(handle);
+		}
+
+		void destroy(uint64_t handle)
+		{
+			std::vector<std::string> unreferenced;
+			auto slot = slots.get_resource(handle);
+			if (slot->release(unreferenced) && slot->retire())
+				free(handle);
+		}
+
+		void free(uint64_t handle)
+		{
+			freed.push_back(handle);
+			slots.free_handle(handle);
+		}
+	};
+
+	void check_reuse_after_destroy()
+	{
+		Manager mgr;
+
+		// destroyed while decoding, freed once the decode is dropped
+		const uint64_t first = mgr.create_async("a.png");
+		mgr.destroy(first);
+		CHECK(mgr.freed.empty() && mgr.slots.get_resource(first)->destroyed);
+		mgr.end_upload(first);
+		CHECK(mgr.freed.size() == 1 && !mgr.slots.is_valid(first));
+
+		// same slot, new texture
+		const uint64_t second = mgr.create_async("b.png");
+		CHECK((second & SLOT_MASK) == (first & SLOT_MASK) && second != first);
+		auto slot = mgr.slots.get_resource(second);
+		CHECK(!slot->destroyed && slot->uploads_in_flight == 1 && slot->refs == 1);
+		CHECK(slot->paths.size() == 1 && slot->paths[0].path == "b.png" && slot->paths[0].refs == 1);
+
+		// its upload lands and swaps in the resource instead of freeing the slot
+		mgr.end_upload(second);
+		CHECK(mgr.freed.size() == 1 && mgr.slots.is_valid(second));
+		CHECK(slot->uploads_in_flight == 0 && !slot->destroyed);
+
+		// and it is destroyed like any other texture
+		mgr.destroy(second);
+		CHECK(mgr.freed.size() == 2 && !mgr.slots.is_valid(second));
+	}
+
+	void check_reuse_with_uploads_left()
+	{
+		Manager mgr;
+
+		// a streaming re-upload is still in flight when the texture is destroyed
+		const uint64_t first = mgr.create_async("a.png");
+		mgr.end_upload(first);
+		mgr.slots.get_resource(first)->begin_upload();
+		mgr.destroy(first);
+		CHECK(mgr.freed.empty());
+		mgr.end_upload(first);
+		CHECK(mgr.freed.size() == 1);
+
+		// a blocking load into the same slot holds no uploads, destroying it frees it right away
+		auto [second, slot] = mgr.slots.get_next_free_handle();
+		slot->acquire("b.png", 0);
+		CHECK((second & SLOT_MASK) == (first & SLOT_MASK));
+		CHECK(slot->uploads_in_flight == 0 && !slot->destroyed);
+		mgr.destroy(second);
+		CHECK(mgr.freed.size() == 2 && !mgr.slots.is_valid(second));
+	}
+
+	void check_path_refs()
+	{
+		TextureSlotState slot{};
+		slot.acquire("a.png", 7);
+		slot.add_ref("a.png");
+		slot.add_path("b.png");				// same contents
+		slot.add_path("c.png");
+		slot.add_ref("b.png");
+		slot.add_ref("");					// handed out without a path (e.g as the default texture)
+		CHECK(slot.refs == 6 && slot.paths.size() == 3);
+
+		std::vector<std::string> unreferenced;
+		auto release = [&]()
+		{
+			unreferenced.clear();
+			return slot.release(unreferenced);
+		};
+
+		// the reference without a path goes first
+		CHECK(!release() && unreferenced.empty() && slot.paths.size() == 3);
+
+		// then the most recently added path
+		CHECK(!release() && unreferenced.size() == 1 && unreferenced[0] == "c.png");
+		CHECK(!release() && unreferenced.empty() && slot.paths.back().refs == 1);
+		CHECK(!release() && unreferenced.size() == 1 && unreferenced[0] == "b.png");
+		CHECK(slot.paths.size() == 1 && slot.paths[0].refs == 2);
+
+		// a path which comes back is counted again
+		slot.add_path("b.png");
+		CHECK(slot.paths.size() == 2);
+
+		// the last reference drops every path
+		CHECK(!release() && !release());
+		CHECK(release() && slot.refs == 0 && slot.paths.empty());
+		std::sort(unreferenced.begin(), unreferenced.end());
+		CHECK(unreferenced.size() == 1 && unreferenced[0] == "a.png");
+
+		// a reused slot starts over
+		slot.acquire("d.png", 0);
+		CHECK(slot.refs == 1 && slot.paths.size() == 1 && slot.content_hash == 0);
+	}
+}
+
+int main()
+{
+	check_reuse_after_destroy();
+	check_reuse_with_uploads_left();
+	check_path_refs();
+
+	std::printf("checks: %s\n", g_failures == 0 ? "passed" : "FAILED");
+	return g_failures == 0 ? 0 : 1;
+}